@@ -14,6 +14,16 @@ uniform highp sampler2D height_map;
 
 uniform lowp bool lines = false;
 
+// Area of the mesh on the terrain (x, z, size, quads along an edge)
+uniform highp vec4 patch_area = vec4(0.0, 0.0, 1.0, 1.0);
+
+// Distances the vertices morph into the next level over (start, end), none
+// if end is not past start
+uniform highp vec2 morph = vec2(0.0, 0.0);
+
+// Camera position in terrain space (0 to 1)
+uniform highp vec3 lod_camera;
+
 // Outputs for the fragment shader pipeline
 out highp vec3 frag_pos;
 out highp vec2 frag_uv;
@@ -33,12 +43,22 @@ void main(void) {
   }
   // Get the uv position, (since the vertices are between 0 and 1 in the x and z
   // directions, the uv is generatable from the x and z components)
-  vec2 uv = vec2(vertex.x, vertex.z);
+  vec2 uv = patch_area.xy + vec2(vertex.x, vertex.z) * patch_area.z;
+
+  // Slide the odd vertices onto the even ones as the distance reaches the
+  // end of the level's range, so the patch matches the next level
+  if (morph.y > morph.x) {
+    float dist = distance(vec3(uv.x, texture2D(height_map, uv).r, uv.y),
+                          lod_camera);
+    float k = clamp((dist - morph.x) / (morph.y - morph.x), 0.0, 1.0);
+    vec2 grid = floor(vec2(vertex.x, vertex.z) * patch_area.w + 0.5);
+    uv -= fract(grid * 0.5) * 2.0 * (patch_area.z / patch_area.w) * k;
+  }
 
-  // Get the height value from the height map
-  vec4 height = texture2D(height_map, uv);
-  vec4 vert = vec4(vertex.x, height.z + offset, vertex.z, 1.0);
-  height_value = height.z;
+  // Get the height value from the height map (single channel)
+  float height = texture2D(height_map, uv).r;
+  vec4 vert = vec4(uv.x, height + offset, uv.y, 1.0);
+  height_value = height;
 
   // Apply the transformations to the vertex
   gl_Position = camera * model * vert;
@@ -0,0 +1,375 @@
+#include "exportjob.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include "Globals/parallel.h"
+
+/**
+ * ExportJob
+ *
+ * Creates an empty job.
+ *
+ * @param QObject* parent : The owner of the job.
+ */
+ExportJob::ExportJob(QObject *parent) : QObject(parent) {}
+
+/**
+ * ~ExportJob
+ *
+ * Cancels the job and waits for the running tasks to stop, the pool can not
+ * outlive the tasks. A job deleted once it has finished only waits for the
+ * last task to return from emitting finished, delete a running job only
+ * where blocking is fine (not the interface thread).
+ */
+ExportJob::~ExportJob()
+{
+    this->cancel();
+    this->_pool.waitForDone();
+}
+
+/**
+ * add
+ *
+ * Adds a file to write. The writer is given a device to write to and a
+ * progress function, it should stop when the progress function returns
+ * false.
+ *
+ * @param QString path : The file to write.
+ * @param double weight : The share of the progress (the size of the work).
+ * @param Writer writer : Writes the file to the device.
+ */
+void ExportJob::add(QString path, double weight, Writer writer)
+{
+    Q_ASSERT(!this->_running);
+    Q_ASSERT(weight > 0.00);
+    this->_tasks.push_back(Task{path, weight, writer});
+}
+
+/**
+ * addImage
+ *
+ * Adds an image to encode, the format is found from the extension of the
+ * path. Encoding can not be interrupted, a cancelled image is discarded once
+ * encoded.
+ *
+ * @param QString path : The file to write.
+ * @param QImage image : The image.
+ */
+void ExportJob::addImage(QString path, QImage image)
+{
+    QByteArray format = QFileInfo(path).suffix().toLower().toLatin1();
+    double weight = qMax(1.00, (double)image.width() * image.height());
+
+    this->add(path,
+              weight,
+              [image, format](QIODevice *device, Progress const &progress) {
+                  QImageWriter writer(device, format);
+                  return writer.write(image) && progress(1.00);
+              });
+}
+
+/**
+ * addHeights
+ *
+ * Adds heights to write straight from the map (see HeightExport).
+ *
+ * @param QString path : The file to write.
+ * @param HeightExport::Format format : The file format.
+ * @param std::shared_ptr<IntensityMap const> heights : The height map.
+ * @param int compression : The zlib level, 0 for none.
+ */
+void ExportJob::addHeights(QString path,
+                           HeightExport::Format format,
+                           std::shared_ptr<IntensityMap const> heights,
+                           int compression)
+{
+    Q_CHECK_PTR(heights);
+    double weight = qMax(1.00, (double)heights->width * heights->height);
+    QRect region(0, 0, heights->width, heights->height);
+
+    this->add(path,
+              weight,
+              [heights, region, format, compression](
+                  QIODevice *device,
+                  Progress const &progress) {
+                  HeightExport writer(heights, region, compression);
+                  return writer.write(device, format, progress);
+              });
+}
+
+/**
+ * addHeightTiles
+ *
+ * Adds the heights cut into square tiles, named by their column and row from
+ * the top left. Neighbouring tiles share their edge samples and tiles past
+ * the map repeat its edge, so every tile has the same size. The tiles share
+ * the map, each is encoded and written a band at a time by its own task.
+ *
+ * @param QString directory : The directory to write the tiles to.
+ * @param QString name : The start of the tile file names.
+ * @param HeightExport::Format format : The file format.
+ * @param std::shared_ptr<IntensityMap const> heights : The height map.
+ * @param int compression : The zlib level, 0 for none.
+ * @param int tile : The samples along an edge of a tile.
+ */
+void ExportJob::addHeightTiles(QString directory,
+                               QString name,
+                               HeightExport::Format format,
+                               std::shared_ptr<IntensityMap const> heights,
+                               int compression,
+                               int tile)
+{
+    Q_CHECK_PTR(heights);
+    QSize grid = HeightExport::tileGrid(heights->width, heights->height, tile);
+    QString extension = HeightExport::extension(format, compression);
+
+    for (int row = 0; row < grid.height(); row++)
+    {
+        for (int column = 0; column < grid.width(); column++)
+        {
+            QRect region = HeightExport::tileRegion(column, row, tile);
+            QString file = QString("%1_x%2_y%3.%4")
+                               .arg(name)
+                               .arg(column)
+                               .arg(row)
+                               .arg(extension);
+
+            this->add(QDir(directory).filePath(file),
+                      (double)tile * tile,
+                      [heights, region, format, compression](
+                          QIODevice *device,
+                          Progress const &progress) {
+                          HeightExport writer(heights, region, compression);
+                          return writer.write(device, format, progress);
+                      });
+        }
+    }
+}
+
+/**
+ * addMesh
+ *
+ * Adds a simplified mesh of the heights to write. The mesh is built in the
+ * task, building it is the first half of the progress and stops when the job
+ * is cancelled.
+ *
+ * @param QString path : The file to write.
+ * @param MeshExport::Format format : The file format.
+ * @param std::shared_ptr<IntensityMap const> heights : The height map.
+ * @param double tolerance : The tolerance of the mesh (see MeshExport).
+ */
+void ExportJob::addMesh(QString path,
+                        MeshExport::Format format,
+                        std::shared_ptr<IntensityMap const> heights,
+                        double tolerance)
+{
+    Q_CHECK_PTR(heights);
+    double weight = qMax(1.00, (double)heights->width * heights->height);
+
+    this->add(path,
+              weight,
+              [heights, format, tolerance](QIODevice *device,
+                                           Progress const &progress) {
+                  MeshExport mesh(*heights, tolerance, [&](double fraction) {
+                      return progress(0.50 * fraction);
+                  });
+                  if (!mesh.built() || !progress(0.50))
+                      return false;
+
+                  return mesh.write(device, format, [&](double fraction) {
+                      return progress(0.50 + 0.50 * fraction);
+                  });
+              });
+}
+
+/**
+ * start
+ *
+ * Starts the tasks in the job's pool, up to a task per core at once. A job
+ * without tasks finishes straight away.
+ *
+ * @signals progress
+ * @signals finished
+ */
+void ExportJob::start()
+{
+    Q_ASSERT(!this->_running);
+    int count = (int)this->_tasks.size();
+
+    this->_done.assign(count, 0.00);
+    this->_total_weight = 0.00;
+    for (Task const &task : this->_tasks)
+        this->_total_weight += task.weight;
+    this->_last_perc = -1;
+    this->_failed.clear();
+
+    this->_running = true;
+    this->_remaining = count;
+    emit this->progress(0);
+
+    if (count == 0)
+    {
+        this->_running = false;
+        emit this->finished(!this->_cancel);
+        return;
+    }
+
+    this->_pool.setMaxThreadCount(qMin(count, parallelThreads()));
+    for (int i = 0; i < count; i++)
+        QtConcurrent::run(&this->_pool, [this, i]() { this->_run(i); });
+}
+
+/**
+ * cancel
+ *
+ * Stops the job, writers stop at their next progress report and tasks that
+ * have not started do not run. Nothing is written for the stopped files.
+ */
+void ExportJob::cancel()
+{
+    this->_cancel = true;
+}
+
+/**
+ * wait
+ *
+ * Blocks until every task is done.
+ *
+ * @returns bool : Whether every file was written.
+ */
+bool ExportJob::wait()
+{
+    this->_pool.waitForDone();
+    QMutexLocker lock(&this->_mutex);
+    return !this->_cancel && this->_failed.isEmpty();
+}
+
+/**
+ * running
+ *
+ * Whether the job was started and has tasks left.
+ *
+ * @returns bool : Whether the job is running.
+ */
+bool ExportJob::running() const
+{
+    return this->_running;
+}
+
+/**
+ * cancelled
+ *
+ * Whether the job was cancelled.
+ *
+ * @returns bool : Whether the job was cancelled.
+ */
+bool ExportJob::cancelled() const
+{
+    return this->_cancel;
+}
+
+/**
+ * failed
+ *
+ * The files that could not be written, files skipped by a cancel are not
+ * included.
+ *
+ * @returns QStringList : The paths of the files.
+ */
+QStringList ExportJob::failed()
+{
+    QMutexLocker lock(&this->_mutex);
+    return this->_failed;
+}
+
+/**
+ * _run
+ *
+ * Writes the file of a task to a temporary file, which replaces the file
+ * once the writer succeeded. The last task to finish reports the end of the
+ * job.
+ *
+ * @param int task : The index of the task.
+ *
+ * @signals progress
+ * @signals finished
+ */
+void ExportJob::_run(int task)
+{
+    Task const &info = this->_tasks[task];
+
+    if (!this->_cancel)
+    {
+        QSaveFile file(info.path);
+        bool written = false;
+        if (file.open(QIODevice::WriteOnly))
+        {
+            written = info.writer(&file, [this, task](double fraction) {
+                return this->_progress(task, fraction);
+            });
+
+            if (written && !this->_cancel)
+                written = file.commit();
+            else
+                file.cancelWriting();
+        }
+
+        if (!written && !this->_cancel)
+        {
+            qWarning("Unable to export '%s'", qPrintable(info.path));
+            QMutexLocker lock(&this->_mutex);
+            this->_failed.append(info.path);
+        }
+    }
+
+    if (--this->_remaining == 0)
+    {
+        bool success;
+        {
+            QMutexLocker lock(&this->_mutex);
+            success = !this->_cancel && this->_failed.isEmpty();
+        }
+        this->_running = false;
+        emit this->finished(success);
+    }
+}
+
+/**
+ * _progress
+ *
+ * Records how much of a task is written and reports the weighted progress of
+ * the job when it reaches the next percent.
+ *
+ * @param int task : The index of the task.
+ * @param double fraction : The fraction of the file written.
+ *
+ * @signals progress
+ *
+ * @returns bool : Whether to keep writing (false once cancelled).
+ */
+bool ExportJob::_progress(int task, double fraction)
+{
+    if (this->_cancel)
+        return false;
+
+    // Reported under the lock so the percentages arrive in order
+    QMutexLocker lock(&this->_mutex);
+    this->_done[task] = qBound(0.00, fraction, 1.00);
+
+    double done = 0.00;
+    for (size_t i = 0; i < this->_tasks.size(); i++)
+        done += this->_done[i] * this->_tasks[i].weight;
+
+    int perc = (int)(100.00 * done / this->_total_weight);
+    if (perc > this->_last_perc)
+    {
+        this->_last_perc = perc;
+        emit this->progress(perc);
+    }
+    return true;
+}
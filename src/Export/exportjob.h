@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QIODevice>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "Nodeeditor/Datatypes/intensitymap.h"
+#include "heightexport.h"
+#include "meshexport.h"
+
+/**
+ * ExportJob
+ *
+ * Writes the files of a render in the background. Every file is a task run
+ * in the job's own thread pool, so the images are encoded at the same time
+ * and the interface stays responsive. Tasks report how much of their file is
+ * written and the job reports the progress of all of them, weighted by their
+ * size. There are as many threads as cores, so a job of many files (such as
+ * tiles) holds only a few of them at once. A file is written to a temporary
+ * file that replaces the target only when it is complete, so a cancelled or
+ * failed job never leaves a partial file behind.
+ */
+class ExportJob : public QObject
+{
+    Q_OBJECT
+public:
+    // Told the fraction of the file written (0 to 1), returns false once the
+    // job is cancelled
+    typedef std::function<bool(double)> Progress;
+
+    // Writes a file to the device (bool whether successful)
+    typedef std::function<bool(QIODevice *, Progress const &)> Writer;
+
+    ExportJob(QObject *parent = nullptr);
+    // Cancels the job and waits for the running tasks, delete a job once
+    // finished to not block
+    ~ExportJob();
+
+    // Add a file to write, the weight is its share of the progress
+    void add(QString path, double weight, Writer writer);
+
+    // Add an image (the format from the extension), heights or a simplified
+    // mesh, the heights are shared by the tasks rather than copied
+    void addImage(QString path, QImage image);
+    void addHeights(QString path,
+                    HeightExport::Format format,
+                    std::shared_ptr<IntensityMap const> heights,
+                    int compression);
+
+    // Add the heights as tiles of tile x tile samples with one sample of
+    // overlap, written to <name>_x<column>_y<row>.<extension> in directory
+    void addHeightTiles(QString directory,
+                        QString name,
+                        HeightExport::Format format,
+                        std::shared_ptr<IntensityMap const> heights,
+                        int compression,
+                        int tile);
+    void addMesh(QString path,
+                 MeshExport::Format format,
+                 std::shared_ptr<IntensityMap const> heights,
+                 double tolerance);
+
+    // Start writing the files
+    void start();
+
+    // Stop as soon as possible, files not yet complete are not written
+    void cancel();
+
+    // Block until every task is done (bool whether every file was written)
+    bool wait();
+
+    // Whether the job was started and has not finished
+    bool running() const;
+
+    // Whether the job was cancelled
+    bool cancelled() const;
+
+    // Files that could not be written
+    QStringList failed();
+
+signals:
+    // Progress of all of the files (0 to 100)
+    void progress(int perc);
+
+    // Every task is done, success if every file was written
+    void finished(bool success);
+
+private:
+    struct Task
+    {
+        QString path;
+        double weight;
+        Writer writer;
+    };
+
+    // Write the file of a task, run in the pool
+    void _run(int task);
+
+    // Record the progress of a task and report the total
+    bool _progress(int task, double fraction);
+
+    std::vector<Task> _tasks;
+    QThreadPool _pool;
+
+    QMutex _mutex;
+    std::vector<double> _done; // Fraction written of every task
+    double _total_weight = 0.00;
+    int _last_perc = -1;
+    QStringList _failed;
+
+    std::atomic<bool> _cancel{false};
+    std::atomic<bool> _running{false};
+    std::atomic<int> _remaining{0};
+};
@@ -0,0 +1,483 @@
+#include "heightexport.h"
+
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+
+#include <QSaveFile>
+#include <QtEndian>
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+/**
+ * appendBig
+ *
+ * Appends an unsigned 32 bit integer in big endian (PNG byte order).
+ *
+ * @param QByteArray* buffer : The buffer to append to.
+ * @param quint32 value : The value.
+ */
+static void appendBig(QByteArray *buffer, quint32 value)
+{
+    value = qToBigEndian(value);
+    buffer->append((char const *)&value, sizeof(value));
+}
+
+/**
+ * appendLittle
+ *
+ * Appends an unsigned 32 bit integer in little endian (gzip byte order).
+ *
+ * @param QByteArray* buffer : The buffer to append to.
+ * @param quint32 value : The value.
+ */
+static void appendLittle(QByteArray *buffer, quint32 value)
+{
+    value = qToLittleEndian(value);
+    buffer->append((char const *)&value, sizeof(value));
+}
+
+/**
+ * deflateBand
+ *
+ * Compresses a band on its own into raw deflate blocks. Bands other than the
+ * last end with a sync flush, on a byte boundary without the final block
+ * flag, so the next band's blocks can follow them in the same stream.
+ *
+ * @param QByteArray const& data : The encoded rows.
+ * @param int level : The zlib compression level.
+ * @param bool last : Whether this is the last band of the stream.
+ *
+ * @returns QByteArray : The deflate blocks, empty if zlib failed.
+ */
+static QByteArray deflateBand(QByteArray const &data, int level, bool last)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)
+        != Z_OK)
+        return QByteArray();
+
+    // The bound does not count the sync flush marker (5 bytes)
+    QByteArray out;
+    out.resize((int)deflateBound(&stream, data.size()) + 16);
+    stream.next_in = (Bytef *)data.constData();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)out.data();
+    stream.avail_out = out.size();
+
+    int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool done = last ? status == Z_STREAM_END
+                     : status == Z_OK && stream.avail_in == 0
+                           && stream.avail_out > 0;
+    out.resize(done ? (int)stream.total_out : 0);
+    deflateEnd(&stream);
+
+    return out;
+}
+
+/**
+ * HeightExport
+ *
+ * Creates an exporter for a height map.
+ *
+ * @param IntensityMap map : The heights.
+ * @param int compression : The zlib level, 0 for none up to 9.
+ */
+HeightExport::HeightExport(IntensityMap map, int compression)
+    : _map(std::make_shared<IntensityMap>(std::move(map))),
+      _compression(qBound(0, compression, 9))
+{
+    this->_region = QRect(0, 0, this->_map->width, this->_map->height);
+}
+
+/**
+ * HeightExport
+ *
+ * Creates an exporter for a region of a height map, the map is shared rather
+ * than copied. Samples of the region past the right or bottom of the map
+ * repeat the edge of the map.
+ *
+ * @param std::shared_ptr<IntensityMap const> map : The heights.
+ * @param QRect region : The samples to write.
+ * @param int compression : The zlib level, 0 for none up to 9.
+ */
+HeightExport::HeightExport(std::shared_ptr<IntensityMap const> map,
+                           QRect region,
+                           int compression)
+    : _map(map), _region(region), _compression(qBound(0, compression, 9))
+{
+    Q_CHECK_PTR(this->_map);
+    Q_ASSERT(region.left() >= 0 && region.top() >= 0 && !region.isEmpty());
+}
+
+/**
+ * write
+ *
+ * Writes the heights to an open device. Groups of bands, one per thread, are
+ * encoded and compressed at the same time and then written in order, so only
+ * a group is held at once.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Format format : The file format.
+ * @param Progress const& progress : Told the fraction written (0 to 1) after
+ *                                   each group, returning false stops the
+ *                                   writing. Optional.
+ *
+ * @returns bool : Whether every byte was written.
+ */
+bool HeightExport::write(QIODevice *device,
+                         Format format,
+                         Progress const &progress) const
+{
+    Q_CHECK_PTR(device);
+    Q_ASSERT(device->isWritable());
+
+    // PNG wraps the stream with zlib (adler32), the other formats with gzip
+    // (crc32) when compressed
+    bool png = format == PNG;
+    bool deflated = png || this->_compression > 0;
+    quint32 seed = png ? adler32(0, Z_NULL, 0) : crc32(0, Z_NULL, 0);
+    quint32 check = seed;
+    qint64 size = 0;
+
+    QByteArray start;
+    if (png)
+    {
+        // zlib header, 32k window, level hint, checked to a multiple of 31
+        int hint = this->_compression == 0 ? 0
+                   : this->_compression < 6 ? 1
+                   : this->_compression == 6 ? 2
+                                              : 3;
+        int header = (0x78 << 8) | (hint << 6);
+        header += (31 - header % 31) % 31;
+        start.append((char)(header >> 8));
+        start.append((char)(header & 0xFF));
+    }
+    else if (deflated)
+    {
+        // gzip header, deflate, no name or time, unknown system
+        start.append("\x1F\x8B\x08\x00\x00\x00\x00\x00\x00\xFF", 10);
+    }
+
+    // The PFM header is part of the gzip stream, it goes before the first row
+    QByteArray header = this->_header(format);
+    if (png && device->write(header) != header.size())
+        return false;
+    if (!this->_write(device, format, start))
+        return false;
+
+    int rows = this->_region.height();
+    int bands = (rows + BAND_ROWS - 1) / BAND_ROWS;
+    int group = parallelThreads();
+    for (int first = 0; first < bands; first += group)
+    {
+        int count = qMin(group, bands - first);
+        std::vector<Band> encoded(count);
+
+        parallelFor(count, [&](int i) {
+            int band = first + i;
+            int end = qMin(rows, (band + 1) * BAND_ROWS);
+            Band &out = encoded[i];
+            out.data = this->_encode(format, band * BAND_ROWS, end);
+            if (!png && band == 0)
+                out.data.prepend(header);
+            out.size = out.data.size();
+            if (!deflated)
+                return;
+
+            Bytef const *bytes = (Bytef const *)out.data.constData();
+            out.check = png ? adler32(seed, bytes, out.data.size())
+                            : crc32(seed, bytes, out.data.size());
+            out.data = deflateBand(out.data,
+                                   this->_compression,
+                                   band == bands - 1);
+        });
+
+        for (Band const &band : encoded)
+        {
+            if (deflated)
+            {
+                if (band.data.isEmpty())
+                    return false;
+                check = png ? adler32_combine(check, band.check, band.size)
+                            : crc32_combine(check, band.check, band.size);
+            }
+            size += band.size;
+
+            if (!this->_write(device, format, band.data))
+                return false;
+        }
+
+        if (progress && !progress((double)(first + count) / bands))
+            return false;
+    }
+
+    QByteArray end;
+    if (png)
+    {
+        appendBig(&end, check);
+        if (!this->_write(device, format, end)
+            || !this->_write(device, format, QByteArray(), "IEND"))
+            return false;
+    }
+    else if (deflated)
+    {
+        appendLittle(&end, check);
+        appendLittle(&end, (quint32)size);
+        if (!this->_write(device, format, end))
+            return false;
+    }
+
+    return !progress || progress(1.00);
+}
+
+/**
+ * save
+ *
+ * Saves the heights to a file. The file is replaced only once it is
+ * completely written.
+ *
+ * @param QString path : The file to save to.
+ * @param Format format : The file format.
+ *
+ * @returns bool : Whether the heights were saved.
+ */
+bool HeightExport::save(QString path, Format format) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Unable to save heights '%s'", qPrintable(path));
+        return false;
+    }
+
+    if (!this->write(&file, format))
+    {
+        qWarning("Unable to write heights '%s'", qPrintable(path));
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+/**
+ * extension
+ *
+ * The file extension of a format.
+ *
+ * @param Format format : The file format.
+ * @param int compression : The zlib level the file is written with.
+ *
+ * @returns QString : The extension, without the dot.
+ */
+QString HeightExport::extension(Format format, int compression)
+{
+    QString gzip = compression > 0 ? QString(".gz") : QString();
+    switch (format)
+    {
+    case PNG:
+        return QString("png");
+    case R16:
+        return QString("r16") + gzip;
+    case R32F:
+        return QString("r32") + gzip;
+    case PFM:
+        return QString("pfm") + gzip;
+    }
+    Q_UNREACHABLE();
+    return QString();
+}
+
+/**
+ * tileGrid
+ *
+ * The number of tiles that cover a map. Tiles step by one less than their
+ * size so neighbours share their edge samples, the last tiles may reach past
+ * the map.
+ *
+ * @param int width : The width of the map.
+ * @param int height : The height of the map.
+ * @param int tile : The samples along an edge of a tile.
+ *
+ * @returns QSize : The columns and rows of tiles.
+ */
+QSize HeightExport::tileGrid(int width, int height, int tile)
+{
+    Q_ASSERT(tile > 1);
+    int step = tile - 1;
+    return QSize(qMax(1, (width - 1 + step - 1) / step),
+                 qMax(1, (height - 1 + step - 1) / step));
+}
+
+/**
+ * tileRegion
+ *
+ * The samples of a tile.
+ *
+ * @param int column : The column of the tile.
+ * @param int row : The row of the tile.
+ * @param int tile : The samples along an edge of a tile.
+ *
+ * @returns QRect : The region of the map, may reach past the map.
+ */
+QRect HeightExport::tileRegion(int column, int row, int tile)
+{
+    Q_ASSERT(tile > 1);
+    return QRect(column * (tile - 1), row * (tile - 1), tile, tile);
+}
+
+/**
+ * _encode
+ *
+ * Encodes rows in the order and layout of the file. PNG rows start with a
+ * filter byte and use the sub filter (the difference to the sample on the
+ * left) which suits smooth heights, samples are big endian. PFM rows are
+ * stored from the bottom of the region up.
+ *
+ * @param Format format : The file format.
+ * @param int start : The first file row.
+ * @param int end : The row after the last file row.
+ *
+ * @returns QByteArray : The encoded rows.
+ */
+QByteArray HeightExport::_encode(Format format, int start, int end) const
+{
+    IntensityMap const &map = *this->_map;
+    int width = this->_region.width();
+    bool full = map.values.size() == (size_t)map.width * map.height;
+    int sample = format == PNG || format == R16 ? 2 : 4;
+    int row = width * sample + (format == PNG ? 1 : 0);
+
+    QByteArray data;
+    data.resize(row * (end - start));
+    uchar *bytes = (uchar *)data.data();
+
+    for (int r = start; r < end; r++)
+    {
+        int y = this->_region.top()
+                + (format == PFM ? this->_region.height() - 1 - r : r);
+        y = qMin(y, map.height - 1);
+        uchar *line = bytes + (size_t)(r - start) * row;
+
+        if (format == PNG)
+            *line++ = 1;
+
+        for (int x = 0; x < width; x++)
+        {
+            int map_x = qMin(this->_region.left() + x, map.width - 1);
+            double h = full ? map.values[(size_t)y * map.width + map_x]
+                            : map.at(map_x, y);
+
+            if (sample == 2)
+            {
+                quint16 value =
+                    (quint16)qRound(qBound(0.00, h, 1.00) * 65535.00);
+                if (format == PNG)
+                    qToBigEndian(value, line + x * 2);
+                else
+                    qToLittleEndian(value, line + x * 2);
+            }
+            else
+            {
+                float value = (float)h;
+                quint32 bits;
+                memcpy(&bits, &value, sizeof(bits));
+                qToLittleEndian(bits, line + x * 4);
+            }
+        }
+
+        // Sub filter, from the right so the left samples are still raw
+        if (format == PNG)
+            for (int i = width * 2 - 1; i >= 2; i--)
+                line[i] = (uchar)(line[i] - line[i - 2]);
+    }
+
+    return data;
+}
+
+/**
+ * _header
+ *
+ * The bytes before the rows of a file, the PNG signature and image header
+ * chunk or the PFM text header. Raw files have no header.
+ *
+ * @param Format format : The file format.
+ *
+ * @returns QByteArray : The header.
+ */
+QByteArray HeightExport::_header(Format format) const
+{
+    QByteArray header;
+    if (format == PNG)
+    {
+        header.append("\x89PNG\r\n\x1A\n", 8);
+
+        // Size, 16 bit greyscale, deflate, adaptive filters, no interlace
+        QByteArray info;
+        appendBig(&info, (quint32)this->_region.width());
+        appendBig(&info, (quint32)this->_region.height());
+        info.append("\x10\x00\x00\x00\x00", 5);
+
+        QByteArray chunk;
+        appendBig(&chunk, (quint32)info.size());
+        chunk.append("IHDR");
+        chunk.append(info);
+        appendBig(&chunk,
+                  crc32(0,
+                        (Bytef const *)chunk.constData() + 4,
+                        chunk.size() - 4));
+        header.append(chunk);
+    }
+    else if (format == PFM)
+    {
+        // A negative scale marks little endian samples
+        header.append("Pf\n");
+        header.append(QByteArray::number(this->_region.width()));
+        header.append(' ');
+        header.append(QByteArray::number(this->_region.height()));
+        header.append("\n-1.0\n");
+    }
+
+    return header;
+}
+
+/**
+ * _write
+ *
+ * Writes bytes to the device. PNG data goes in a chunk of its own, with its
+ * length and checksum, empty data is only written for chunks other than
+ * image data.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Format format : The file format.
+ * @param QByteArray const& data : The bytes.
+ * @param char const* chunk : The PNG chunk type.
+ *
+ * @returns bool : Whether the device took every byte.
+ */
+bool HeightExport::_write(QIODevice *device,
+                          Format format,
+                          QByteArray const &data,
+                          char const *chunk) const
+{
+    if (format != PNG)
+        return data.isEmpty() || device->write(data) == data.size();
+
+    if (data.isEmpty() && strcmp(chunk, "IDAT") == 0)
+        return true;
+
+    QByteArray out;
+    out.reserve(data.size() + 12);
+    appendBig(&out, (quint32)data.size());
+    out.append(chunk);
+    out.append(data);
+    appendBig(&out,
+              crc32(0,
+                    (Bytef const *)out.constData() + 4,
+                    out.size() - 4));
+
+    return device->write(out) == out.size();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+#include "Nodeeditor/Datatypes/intensitymap.h"
+
+/**
+ * HeightExport
+ *
+ * Writes a height map straight from its values, a band of rows at a time, to
+ * a 16 bit greyscale PNG, raw 16 bit or 32 bit float samples, or a portable
+ * float map (PFM). No image of the whole map is made, only the bands being
+ * encoded are held. The bands are encoded (and compressed) in parallel and
+ * written in order. Compressed bands are independent deflate blocks ended on
+ * a byte boundary, so they join into a single stream, and their checksums
+ * are combined. PNG data is always a deflate stream (stored blocks without
+ * compression), the raw and PFM files are gzipped when compressed. A region
+ * of a shared map can be written instead of the whole map, which is how large
+ * terrains are cut into tiles without copying them.
+ */
+class HeightExport
+{
+public:
+    // File formats the heights can be written to
+    enum Format
+    {
+        PNG, // 16 bit greyscale PNG
+        R16, // Raw little endian unsigned 16 bit, top row first
+        R32F, // Raw little endian 32 bit float, top row first
+        PFM // Portable float map, greyscale, bottom row first
+    };
+
+    // Told the fraction written (0 to 1), returns false to stop writing
+    typedef std::function<bool(double)> Progress;
+
+    // Heights to write, compression is the zlib level (0 none, 1 fastest
+    // to 9 smallest). 16 bit formats clamp the heights between 0 and 1.
+    HeightExport(IntensityMap map, int compression = 0);
+
+    // Heights of a region of a shared map, samples past the map repeat its
+    // edge
+    HeightExport(std::shared_ptr<IntensityMap const> map,
+                 QRect region,
+                 int compression = 0);
+
+    // Write the heights to a device or a file (bool whether successful)
+    bool write(QIODevice *device,
+               Format format,
+               Progress const &progress = nullptr) const;
+    bool save(QString path, Format format) const;
+
+    // File extension of a format (without the dot), gz is added for
+    // compressed raw and PFM files
+    static QString extension(Format format, int compression = 0);
+
+    // Tiles of tile x tile samples that cover a map, neighbouring tiles
+    // share a row or column of samples (one sample overlap)
+    static QSize tileGrid(int width, int height, int tile);
+    static QRect tileRegion(int column, int row, int tile);
+
+private:
+    // A band of rows ready to write
+    struct Band
+    {
+        QByteArray data; // Encoded rows, then compressed when deflated
+        quint32 check; // Checksum of the encoded rows
+        qint64 size; // Bytes of the encoded rows
+    };
+
+    // Encode the rows of a band as they are in the file
+    QByteArray _encode(Format format, int start, int end) const;
+
+    // The bytes before the first row (signature, header)
+    QByteArray _header(Format format) const;
+
+    // Write bytes as they are or wrapped in a PNG chunk
+    bool _write(QIODevice *device,
+                Format format,
+                QByteArray const &data,
+                char const *chunk = "IDAT") const;
+
+    // Rows in a band
+    static const int BAND_ROWS = 64;
+
+    std::shared_ptr<IntensityMap const> _map;
+    QRect _region; // Samples to write, may reach past the map
+    int _compression;
+};
@@ -0,0 +1,771 @@
+#include "meshexport.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+// Bytes gathered before they are written to the device
+static const int CHUNK = 1 << 20;
+
+/**
+ * flush
+ *
+ * Writes the gathered bytes to the device once there are enough of them.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param QByteArray* buffer : The gathered bytes, emptied when written.
+ * @param bool force : Whether to write however few bytes there are.
+ *
+ * @returns bool : Whether the device took every byte written.
+ */
+static bool flush(QIODevice *device, QByteArray *buffer, bool force = false)
+{
+    if (buffer->size() < CHUNK && !force)
+        return true;
+
+    bool written = device->write(*buffer) == buffer->size();
+    buffer->clear();
+    return written;
+}
+
+/**
+ * appendFloat
+ *
+ * Appends a float in little endian.
+ *
+ * @param QByteArray* buffer : The buffer to append to.
+ * @param float value : The value.
+ */
+static void appendFloat(QByteArray *buffer, float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = qToLittleEndian(bits);
+    buffer->append((char const *)&bits, sizeof(bits));
+}
+
+/**
+ * appendUint
+ *
+ * Appends an unsigned 32 bit integer in little endian.
+ *
+ * @param QByteArray* buffer : The buffer to append to.
+ * @param quint32 value : The value.
+ */
+static void appendUint(QByteArray *buffer, quint32 value)
+{
+    value = qToLittleEndian(value);
+    buffer->append((char const *)&value, sizeof(value));
+}
+
+/**
+ * deviation
+ *
+ * The furthest a grid vertex within a triangle is from the plane through its
+ * corners.
+ *
+ * @param float const* heights : The grid heights.
+ * @param int size : The vertices along an edge of the grid.
+ * @param int a_x, a_y, b_x, b_y, c_x, c_y : The corners of the triangle.
+ *
+ * @returns float : The largest distance, along the height.
+ */
+static float deviation(float const *heights, int size,
+                       int a_x, int a_y,
+                       int b_x, int b_y,
+                       int c_x, int c_y)
+{
+    int area = (b_x - a_x) * (c_y - a_y) - (b_y - a_y) * (c_x - a_x);
+    if (area < 0)
+    {
+        qSwap(b_x, c_x);
+        qSwap(b_y, c_y);
+        area = -area;
+    }
+
+    float h_a = heights[(size_t)a_y * size + a_x];
+    float h_b = heights[(size_t)b_y * size + b_x];
+    float h_c = heights[(size_t)c_y * size + c_x];
+
+    float error = 0.00f;
+    for (int y = qMin(a_y, qMin(b_y, c_y)); y <= qMax(a_y, qMax(b_y, c_y)); y++)
+    {
+        for (int x = qMin(a_x, qMin(b_x, c_x));
+             x <= qMax(a_x, qMax(b_x, c_x));
+             x++)
+        {
+            // Twice the areas opposite each corner, the weights of the corner
+            int w_a = (c_x - b_x) * (y - b_y) - (c_y - b_y) * (x - b_x);
+            int w_b = (a_x - c_x) * (y - c_y) - (a_y - c_y) * (x - c_x);
+            int w_c = area - w_a - w_b;
+            if (w_a < 0 || w_b < 0 || w_c < 0)
+                continue;
+
+            float plane = (h_a * w_a + h_b * w_b + h_c * w_c) / area;
+            error = qMax(error,
+                         fabsf(plane - heights[(size_t)y * size + x]));
+        }
+    }
+
+    return error;
+}
+
+/**
+ * MeshExport
+ *
+ * Samples the map onto the grid, computes the error of every vertex and
+ * numbers the vertices the simplified mesh uses. The progress is checked
+ * between the levels of the errors, when it returns false the mesh is left
+ * unbuilt and can not be written.
+ *
+ * @param IntensityMap const& map : The height map.
+ * @param double tolerance : The furthest a sample may be from the mesh.
+ * @param Progress const& progress : Told the fraction built, may be nullptr.
+ */
+MeshExport::MeshExport(IntensityMap const &map,
+                       double tolerance,
+                       Progress const &progress)
+    : _tolerance(tolerance)
+{
+    while (this->_size < qMax(map.width, map.height))
+        this->_size = (this->_size - 1) * 2 + 1;
+
+    if (progress && !progress(0.00))
+        return;
+
+    this->_sample(map);
+    if (!this->_buildErrors(progress))
+        return;
+
+    this->_index();
+    this->_built = true;
+}
+
+/**
+ * built
+ *
+ * Whether the mesh was built, false when the progress stopped the build.
+ *
+ * @returns bool : Whether the mesh was built.
+ */
+bool MeshExport::built() const
+{
+    return this->_built;
+}
+
+/**
+ * gridSize
+ *
+ * The number of vertices along an edge of the grid.
+ *
+ * @returns int : The grid size, 2^k + 1.
+ */
+int MeshExport::gridSize() const
+{
+    return this->_size;
+}
+
+/**
+ * vertexCount
+ *
+ * The number of vertices of the simplified mesh.
+ *
+ * @returns int : The vertex count.
+ */
+int MeshExport::vertexCount() const
+{
+    return this->_vertex_count;
+}
+
+/**
+ * triangleCount
+ *
+ * The number of triangles of the simplified mesh.
+ *
+ * @returns int : The triangle count.
+ */
+int MeshExport::triangleCount() const
+{
+    return this->_triangle_count;
+}
+
+/**
+ * height
+ *
+ * The height of a grid vertex.
+ *
+ * @param int x : The column of the vertex.
+ * @param int y : The row of the vertex.
+ *
+ * @returns float : The height.
+ */
+float MeshExport::height(int x, int y) const
+{
+    Q_ASSERT(x >= 0 && x < this->_size);
+    Q_ASSERT(y >= 0 && y < this->_size);
+    return this->_heights[(size_t)y * this->_size + x];
+}
+
+/**
+ * triangles
+ *
+ * Visits the triangles of the simplified mesh in the order of the recursive
+ * split. The order follows a space filling curve, every triangle shares an
+ * edge with the one before, so the vertex cache is reused without reordering.
+ *
+ * @param std::function<void(int, int, int)> const& func : Called with the
+ *                                                         grid vertex ids of
+ *                                                         every triangle.
+ */
+void MeshExport::triangles(std::function<void(int, int, int)> const &func) const
+{
+    int last = this->_size - 1;
+    this->_walk(0, 0, last, last, last, 0, func);
+    this->_walk(last, last, 0, 0, 0, last, func);
+}
+
+/**
+ * write
+ *
+ * Writes the mesh to an open device.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Format format : The file format.
+ * @param Progress const& progress : Told the fraction written (0 to 1) as the
+ *                                   mesh is written, returning false stops
+ *                                   the writing. Optional.
+ *
+ * @returns bool : Whether every byte was written, false for a mesh that was
+ *                 not built.
+ */
+bool MeshExport::write(QIODevice *device,
+                       Format format,
+                       Progress const &progress) const
+{
+    Q_CHECK_PTR(device);
+    Q_ASSERT(device->isWritable());
+
+    if (!this->_built)
+        return false;
+
+    switch (format)
+    {
+    case OBJ:
+        return this->_writeObj(device, progress);
+    case PLY:
+        return this->_writePly(device, progress);
+    case GLB:
+        return this->_writeGlb(device, progress);
+    }
+    Q_UNREACHABLE();
+    return false;
+}
+
+/**
+ * save
+ *
+ * Saves the mesh to a file. The file is replaced only once it is completely
+ * written.
+ *
+ * @param QString path : The file to save to.
+ * @param Format format : The file format.
+ *
+ * @returns bool : Whether the mesh was saved.
+ */
+bool MeshExport::save(QString path, Format format) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Unable to save mesh '%s'", qPrintable(path));
+        return false;
+    }
+
+    if (!this->write(&file, format))
+    {
+        qWarning("Unable to write mesh '%s'", qPrintable(path));
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+/**
+ * extension
+ *
+ * The file extension of a format.
+ *
+ * @param Format format : The file format.
+ *
+ * @returns QString : The extension, without the dot.
+ */
+QString MeshExport::extension(Format format)
+{
+    switch (format)
+    {
+    case OBJ:
+        return QString("obj");
+    case PLY:
+        return QString("ply");
+    case GLB:
+        return QString("glb");
+    }
+    Q_UNREACHABLE();
+    return QString();
+}
+
+/**
+ * _sample
+ *
+ * Samples the map onto the grid with bilinear interpolation, the corners of
+ * the grid are the corners of the map. A map of the grid size is read as is.
+ *
+ * @param IntensityMap const& map : The height map.
+ */
+void MeshExport::_sample(IntensityMap const &map)
+{
+    int size = this->_size;
+    this->_heights.resize((size_t)size * size);
+
+    double scale_x = (map.width - 1) / (double)(size - 1);
+    double scale_y = (map.height - 1) / (double)(size - 1);
+
+    parallelRows(size, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            double v = y * scale_y;
+            int y_0 = qMin((int)v, map.height - 1);
+            int y_1 = qMin(y_0 + 1, map.height - 1);
+            double t_y = v - y_0;
+
+            for (int x = 0; x < size; x++)
+            {
+                double u = x * scale_x;
+                int x_0 = qMin((int)u, map.width - 1);
+                int x_1 = qMin(x_0 + 1, map.width - 1);
+                double t_x = u - x_0;
+
+                double top = map.at(x_0, y_0)
+                             + (map.at(x_1, y_0) - map.at(x_0, y_0)) * t_x;
+                double bottom = map.at(x_0, y_1)
+                                + (map.at(x_1, y_1) - map.at(x_0, y_1)) * t_x;
+
+                this->_heights[(size_t)y * size + x] =
+                    (float)(top + (bottom - top) * t_y);
+            }
+        }
+    });
+}
+
+/**
+ * _buildErrors
+ *
+ * Computes the error of every vertex a level at a time, from the finest
+ * triangles up. On a level of half size h a vertex is either the middle of an
+ * axis aligned edge 2h long, or the centre of a 2h square split along the
+ * diagonal that meets the centre of the square around it. The error of a
+ * vertex is the furthest a grid vertex is from the triangles either side of
+ * that edge or diagonal, or the largest error of the vertices that split
+ * those triangles, whichever is larger. Every row of a level is independent.
+ * The levels take about the same time (a quarter of the vertices, each
+ * looking at four times the samples), the progress is told the fraction of
+ * the levels done after each one.
+ *
+ * @param Progress const& progress : Told the fraction built, may be nullptr.
+ *
+ * @returns bool : Whether every level was built, false if the progress
+ *                 stopped the build.
+ */
+bool MeshExport::_buildErrors(Progress const &progress)
+{
+    int size = this->_size;
+    int last = size - 1;
+
+    int levels = 0;
+    for (int h = 1; h < last; h *= 2)
+        levels++;
+    int level = 0;
+    this->_errors.assign((size_t)size * size, 0.00f);
+
+    float const *heights = this->_heights.data();
+    float *errors = this->_errors.data();
+
+    auto at = [size](int x, int y) { return (size_t)y * size + x; };
+
+    for (int h = 1; h < last; h *= 2)
+    {
+        // Middles of the edges, the triangles either side split at the
+        // centres of the h / 2 squares around them
+        parallelRows(last / h + 1, [&](int start, int end) {
+            for (int row = start; row < end; row++)
+            {
+                int y = row * h;
+                bool horizontal = y % (2 * h) == 0;
+                for (int x = horizontal ? h : 0; x <= last; x += 2 * h)
+                {
+                    float error = 0.00f;
+                    for (int side : {-h, h})
+                    {
+                        if (horizontal && y + side >= 0 && y + side <= last)
+                            error = qMax(error,
+                                         deviation(heights, size,
+                                                   x - h, y, x + h, y,
+                                                   x, y + side));
+                        if (!horizontal && x + side >= 0 && x + side <= last)
+                            error = qMax(error,
+                                         deviation(heights, size,
+                                                   x, y - h, x, y + h,
+                                                   x + side, y));
+                    }
+
+                    int q = h / 2;
+                    if (q > 0)
+                    {
+                        for (int c_y : {y - q, y + q})
+                            for (int c_x : {x - q, x + q})
+                                if (c_x >= 0 && c_x <= last
+                                    && c_y >= 0 && c_y <= last)
+                                    error = qMax(error, errors[at(c_x, c_y)]);
+                    }
+
+                    errors[at(x, y)] = error;
+                }
+            }
+        });
+
+        // Centres of the squares, the triangles either side of the diagonal
+        // split at the middles of the square's edges
+        parallelRows(last / (2 * h), [&](int start, int end) {
+            for (int row = start; row < end; row++)
+            {
+                int y = row * 2 * h + h;
+                for (int x = h; x < last; x += 2 * h)
+                {
+                    bool main = (x / (2 * h)) % 2 == (y / (2 * h)) % 2;
+                    int a_y = main ? y - h : y + h;
+                    int b_y = main ? y + h : y - h;
+                    float error = qMax(deviation(heights, size,
+                                                 x - h, a_y, x + h, b_y,
+                                                 x + h, a_y),
+                                       deviation(heights, size,
+                                                 x - h, a_y, x + h, b_y,
+                                                 x - h, b_y));
+
+                    error = qMax(error, errors[at(x - h, y)]);
+                    error = qMax(error, errors[at(x + h, y)]);
+                    error = qMax(error, errors[at(x, y - h)]);
+                    error = qMax(error, errors[at(x, y + h)]);
+
+                    errors[at(x, y)] = error;
+                }
+            }
+        });
+
+        level++;
+        if (progress && !progress((double)level / levels))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * _walk
+ *
+ * Splits the triangle at the middle of its long edge while the vertex there
+ * has more error than the tolerance, or visits it. The two halves have the
+ * new vertex as their right angle corner.
+ *
+ * @param int a_x, a_y : The first corner of the long edge.
+ * @param int b_x, b_y : The second corner of the long edge.
+ * @param int c_x, c_y : The right angle corner.
+ * @param std::function<void(int, int, int)> const& func : Called with the
+ *                                                         grid vertex ids of
+ *                                                         every triangle.
+ */
+void MeshExport::_walk(int a_x, int a_y,
+                       int b_x, int b_y,
+                       int c_x, int c_y,
+                       std::function<void(int, int, int)> const &func) const
+{
+    int m_x = (a_x + b_x) / 2;
+    int m_y = (a_y + b_y) / 2;
+
+    if (abs(a_x - c_x) + abs(a_y - c_y) > 1
+        && this->_errors[(size_t)m_y * this->_size + m_x] > this->_tolerance)
+    {
+        this->_walk(c_x, c_y, a_x, a_y, m_x, m_y, func);
+        this->_walk(b_x, b_y, c_x, c_y, m_x, m_y, func);
+        return;
+    }
+
+    int a = a_y * this->_size + a_x;
+    int b = b_y * this->_size + b_x;
+    int c = c_y * this->_size + c_x;
+
+    // Counter clockwise seen from above (y up, rows along z)
+    if ((b_y - a_y) * (c_x - a_x) - (b_x - a_x) * (c_y - a_y) > 0)
+        func(a, b, c);
+    else
+        func(a, c, b);
+}
+
+/**
+ * _index
+ *
+ * Marks the vertices the triangles use, then numbers them row by row so the
+ * vertices can be written with a single pass over the grid.
+ */
+void MeshExport::_index()
+{
+    this->_indexes.assign((size_t)this->_size * this->_size, -1);
+    this->_triangle_count = 0;
+
+    this->triangles([this](int a, int b, int c) {
+        this->_indexes[a] = 0;
+        this->_indexes[b] = 0;
+        this->_indexes[c] = 0;
+        this->_triangle_count++;
+    });
+
+    this->_vertex_count = 0;
+    this->_min = this->_heights[0];
+    this->_max = this->_heights[0];
+    for (size_t i = 0; i < this->_indexes.size(); i++)
+    {
+        if (this->_indexes[i] < 0)
+            continue;
+
+        this->_indexes[i] = this->_vertex_count++;
+        this->_min = qMin(this->_min, this->_heights[i]);
+        this->_max = qMax(this->_max, this->_heights[i]);
+    }
+}
+
+/**
+ * _writeObj
+ *
+ * Writes the vertices then the faces (1 based) as Wavefront text.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Progress const& progress : Told the fraction written.
+ *
+ * @returns bool : Whether every byte was written.
+ */
+bool MeshExport::_writeObj(QIODevice *device, Progress const &progress) const
+{
+    QByteArray buffer;
+    char line[96];
+
+    buffer.append(QByteArray("# Terrain mesh, ")
+                  + QByteArray::number(this->_vertex_count) + " vertices, "
+                  + QByteArray::number(this->_triangle_count)
+                  + " triangles\n");
+
+    return this->_stream(
+        device,
+        &buffer,
+        [&line](QByteArray *buffer, float x, float y, float z) {
+            int length = qsnprintf(line, sizeof(line), "v %.7g %.7g %.7g\n",
+                                   x, y, z);
+            buffer->append(line, length);
+        },
+        [&line](QByteArray *buffer, quint32 a, quint32 b, quint32 c) {
+            int length = qsnprintf(line, sizeof(line), "f %u %u %u\n",
+                                   a + 1, b + 1, c + 1);
+            buffer->append(line, length);
+        },
+        progress);
+}
+
+/**
+ * _writePly
+ *
+ * Writes a binary little endian PLY, float positions and faces of three 32
+ * bit indexes.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Progress const& progress : Told the fraction written.
+ *
+ * @returns bool : Whether every byte was written.
+ */
+bool MeshExport::_writePly(QIODevice *device, Progress const &progress) const
+{
+    QByteArray buffer;
+
+    buffer.append("ply\n"
+                  "format binary_little_endian 1.0\n"
+                  "comment Terrain mesh\n");
+    buffer.append("element vertex "
+                  + QByteArray::number(this->_vertex_count) + "\n");
+    buffer.append("property float x\n"
+                  "property float y\n"
+                  "property float z\n");
+    buffer.append("element face "
+                  + QByteArray::number(this->_triangle_count) + "\n");
+    buffer.append("property list uchar uint vertex_indices\n"
+                  "end_header\n");
+
+    return this->_stream(
+        device,
+        &buffer,
+        [](QByteArray *buffer, float x, float y, float z) {
+            appendFloat(buffer, x);
+            appendFloat(buffer, y);
+            appendFloat(buffer, z);
+        },
+        [](QByteArray *buffer, quint32 a, quint32 b, quint32 c) {
+            buffer->append((char)3);
+            appendUint(buffer, a);
+            appendUint(buffer, b);
+            appendUint(buffer, c);
+        },
+        progress);
+}
+
+/**
+ * _writeGlb
+ *
+ * Writes a binary glTF 2.0 file, a single mesh with float positions and 32
+ * bit indexes in one buffer (positions first). The sizes are known from the
+ * counts so the header is written before the data is streamed.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param Progress const& progress : Told the fraction written.
+ *
+ * @returns bool : Whether every byte was written.
+ */
+bool MeshExport::_writeGlb(QIODevice *device, Progress const &progress) const
+{
+    quint64 positions = (quint64)this->_vertex_count * 3 * sizeof(float);
+    quint64 indexes = (quint64)this->_triangle_count * 3 * sizeof(quint32);
+    quint64 binary = positions + indexes;
+
+    QByteArray min = QByteArray::number(this->_min, 'g', 9);
+    QByteArray max = QByteArray::number(this->_max, 'g', 9);
+
+    QByteArray json =
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"TerrainGenerator\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        "\"nodes\":[{\"mesh\":0,\"name\":\"Terrain\"}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},"
+        "\"indices\":1,\"mode\":4}]}],"
+        "\"buffers\":[{\"byteLength\":" + QByteArray::number(binary) + "}],"
+        "\"bufferViews\":["
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":"
+        + QByteArray::number(positions) + ",\"target\":34962},"
+        "{\"buffer\":0,\"byteOffset\":" + QByteArray::number(positions)
+        + ",\"byteLength\":" + QByteArray::number(indexes)
+        + ",\"target\":34963}],"
+        "\"accessors\":["
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":"
+        + QByteArray::number(this->_vertex_count) + ",\"type\":\"VEC3\","
+        "\"min\":[0," + min + ",0],\"max\":[1," + max + ",1]},"
+        "{\"bufferView\":1,\"componentType\":5125,\"count\":"
+        + QByteArray::number((quint64)this->_triangle_count * 3)
+        + ",\"type\":\"SCALAR\"}]}";
+
+    // Chunks are padded to 4 bytes, the JSON with spaces
+    while (json.size() % 4 != 0)
+        json.append(' ');
+
+    quint64 length = 12 + 8 + json.size() + 8 + binary;
+    if (length > 0xFFFFFFFFull)
+    {
+        qWarning("Mesh is too large for a binary glTF file");
+        return false;
+    }
+
+    QByteArray buffer;
+    appendUint(&buffer, 0x46546C67); // glTF
+    appendUint(&buffer, 2);
+    appendUint(&buffer, (quint32)length);
+    appendUint(&buffer, json.size());
+    appendUint(&buffer, 0x4E4F534A); // JSON
+    buffer.append(json);
+    appendUint(&buffer, (quint32)binary);
+    appendUint(&buffer, 0x004E4942); // BIN
+
+    return this->_stream(
+        device,
+        &buffer,
+        [](QByteArray *buffer, float x, float y, float z) {
+            appendFloat(buffer, x);
+            appendFloat(buffer, y);
+            appendFloat(buffer, z);
+        },
+        [](QByteArray *buffer, quint32 a, quint32 b, quint32 c) {
+            appendUint(buffer, a);
+            appendUint(buffer, b);
+            appendUint(buffer, c);
+        },
+        progress);
+}
+
+/**
+ * _stream
+ *
+ * Streams the used vertices row by row, then the triangles in the order of
+ * the walk, to the device through the buffer. Every row and every block of
+ * triangles reports the fraction written, the vertices are the first half.
+ *
+ * @param QIODevice* device : The device to write to.
+ * @param QByteArray* buffer : Bytes gathered so far (the header).
+ * @param Vertex const& vertex : Appends a position.
+ * @param Face const& face : Appends the output indexes of a triangle.
+ * @param Progress const& progress : Told the fraction written, stops the
+ *                                   writing when it returns false.
+ *
+ * @returns bool : Whether every byte was written.
+ */
+bool MeshExport::_stream(QIODevice *device,
+                         QByteArray *buffer,
+                         Vertex const &vertex,
+                         Face const &face,
+                         Progress const &progress) const
+{
+    int size = this->_size;
+    float step = 1.00f / (size - 1);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            size_t i = (size_t)y * size + x;
+            if (this->_indexes[i] >= 0)
+                vertex(buffer, x * step, this->_heights[i], y * step);
+        }
+
+        if (!flush(device, buffer))
+            return false;
+        if (progress && !progress(0.50 * (y + 1) / size))
+            return false;
+    }
+
+    bool written = true;
+    int count = 0;
+    this->triangles([&](int a, int b, int c) {
+        if (!written)
+            return;
+
+        face(buffer,
+             this->_indexes[a],
+             this->_indexes[b],
+             this->_indexes[c]);
+        written = flush(device, buffer);
+
+        if (++count % PROGRESS_TRIANGLES == 0 && progress)
+            written = written
+                      && progress(0.50 + 0.50 * count / this->_triangle_count);
+    });
+
+    return written && flush(device, buffer, true)
+           && (!progress || progress(1.00));
+}
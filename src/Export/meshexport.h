@@ -0,0 +1,126 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+#include "Nodeeditor/Datatypes/intensitymap.h"
+
+/**
+ * MeshExport
+ *
+ * Simplifies a height map into a triangle mesh and writes it to OBJ, PLY or
+ * binary glTF. The mesh is a right triangulated irregular network (RTIN), the
+ * height map is sampled on a (2^k + 1)^2 grid that is split recursively into
+ * right triangles. Every grid vertex keeps the error of leaving it out, the
+ * furthest the grid is from the two triangles either side of it or the
+ * largest error below it, and a triangle is split while the vertex at the
+ * middle of its long edge has more error than the tolerance. So every height
+ * map sample is within the tolerance of the mesh, and the mesh has no cracks.
+ * Only the per vertex heights, errors and output indexes are kept, the
+ * triangles are walked twice (count, then write) and streamed to the file.
+ * Positions are in terrain space, x and z from 0 to 1 and the height as is.
+ */
+class MeshExport
+{
+public:
+    // File formats a mesh can be written to
+    enum Format
+    {
+        OBJ, // Wavefront text
+        PLY, // Binary little endian Stanford polygon
+        GLB // Binary glTF 2.0
+    };
+
+    // Told the fraction written (0 to 1), returns false to stop writing
+    typedef std::function<bool(double)> Progress;
+
+    // Simplify a height map, no sample is further than tolerance (in
+    // height) from the mesh. The progress is told the fraction built and
+    // stops the build when it returns false
+    MeshExport(IntensityMap const &map,
+               double tolerance,
+               Progress const &progress = nullptr);
+
+    // Whether the mesh was completely built (false if stopped)
+    bool built() const;
+
+    // Vertices along an edge of the grid (2^k + 1)
+    int gridSize() const;
+
+    // Vertices and triangles of the simplified mesh
+    int vertexCount() const;
+    int triangleCount() const;
+
+    // Height of a grid vertex
+    float height(int x, int y) const;
+
+    // Visit the triangles as grid vertex ids (y * gridSize() + x), counter
+    // clockwise seen from above, neighbouring triangles share an edge
+    void triangles(std::function<void(int, int, int)> const &func) const;
+
+    // Write the mesh to a device or a file (bool whether successful)
+    bool write(QIODevice *device,
+               Format format,
+               Progress const &progress = nullptr) const;
+    bool save(QString path, Format format) const;
+
+    // File extension of a format (without the dot)
+    static QString extension(Format format);
+
+private:
+    // Sample the map onto the grid
+    void _sample(IntensityMap const &map);
+
+    // Errors of every grid vertex, finest level first (bool whether not
+    // stopped)
+    bool _buildErrors(Progress const &progress);
+
+    // Recursive walk over the triangle (a, b, c), a to b is the long edge
+    void _walk(int a_x, int a_y,
+               int b_x, int b_y,
+               int c_x, int c_y,
+               std::function<void(int, int, int)> const &func) const;
+
+    // Number the used vertices row by row
+    void _index();
+
+    // Writers for each format, the device is open
+    bool _writeObj(QIODevice *device, Progress const &progress) const;
+    bool _writePly(QIODevice *device, Progress const &progress) const;
+    bool _writeGlb(QIODevice *device, Progress const &progress) const;
+
+    // Append a position (x, y, z) or a triangle (output indexes)
+    typedef std::function<void(QByteArray *, float, float, float)> Vertex;
+    typedef std::function<void(QByteArray *, quint32, quint32, quint32)> Face;
+
+    // Stream the vertices then the triangles after the header in buffer
+    bool _stream(QIODevice *device,
+                 QByteArray *buffer,
+                 Vertex const &vertex,
+                 Face const &face,
+                 Progress const &progress) const;
+
+    // Triangles written between progress reports
+    static const int PROGRESS_TRIANGLES = 65536;
+
+    int _size = 2;
+    double _tolerance;
+    bool _built = false;
+
+    std::vector<float> _heights;
+    std::vector<float> _errors;
+
+    // Output index of every grid vertex, -1 if not used
+    std::vector<int> _indexes;
+
+    int _vertex_count = 0;
+    int _triangle_count = 0;
+
+    // Height range of the used vertices
+    float _min = 0.00f;
+    float _max = 0.00f;
+};
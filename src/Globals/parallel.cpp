@@ -0,0 +1,90 @@
+#include "parallel.h"
+
+#include <algorithm>
+
+#include <QPair>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+/**
+ * parallelThreads
+ *
+ * Returns the number of threads that the global thread pool will run bands on.
+ *
+ * @returns int : The number of threads (at least 1).
+ */
+int parallelThreads()
+{
+    return std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+}
+
+/**
+ * parallelRows
+ *
+ * Splits the rows of a map into bands and processes the bands concurrently
+ * with QtConcurrent. Each band is handed a contiguous [start, end) range of
+ * rows, bands never overlap so writes into separate rows need no locking.
+ * Small jobs (or a single band) run inline on the calling thread.
+ *
+ * @param int rows : The number of rows to process.
+ * @param std::function<void(int, int)> func : Band function (start, end).
+ * @param int bands : The number of bands to split into, <= 0 uses four bands
+ *                    per available thread for load balancing.
+ */
+void parallelRows(int rows,
+                  std::function<void(int, int)> const &func,
+                  int bands)
+{
+    if (rows <= 0)
+        return;
+
+    if (bands <= 0)
+        bands = parallelThreads() * 4;
+
+    bands = std::min(bands, rows);
+
+    if (bands <= 1)
+    {
+        func(0, rows);
+        return;
+    }
+
+    QVector<QPair<int, int>> ranges;
+    ranges.reserve(bands);
+    for (int b = 0; b < bands; b++)
+        ranges << QPair<int, int>((int)((long long)rows * b / bands),
+                                  (int)((long long)rows * (b + 1) / bands));
+
+    QtConcurrent::blockingMap(ranges, [&func](QPair<int, int> const &range) {
+        func(range.first, range.second);
+    });
+}
+
+/**
+ * parallelFor
+ *
+ * Runs a function for each index of a range concurrently with QtConcurrent.
+ * Used for independent work items such as the tiles of a tiled simulation.
+ *
+ * @param int count : The number of items.
+ * @param std::function<void(int)> func : The item function (index).
+ */
+void parallelFor(int count, std::function<void(int)> const &func)
+{
+    if (count <= 0)
+        return;
+
+    if (count == 1)
+    {
+        func(0);
+        return;
+    }
+
+    QVector<int> items(count);
+    for (int i = 0; i < count; i++)
+        items[i] = i;
+
+    QtConcurrent::blockingMap(items, [&func](int const &i) { func(i); });
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+// Split the rows [0, rows) into contiguous bands and run func(start, end) on
+// each band in the global thread pool, blocks until every band is done. Bands
+// are fixed by the row count and band count so the work split is
+// deterministic. bands <= 0 selects a band count from the ideal thread count.
+void parallelRows(int rows,
+                  std::function<void(int, int)> const &func,
+                  int bands = 0);
+
+// Run func(i) for every i in [0, count) in the global thread pool, blocks
+// until every item is done. Items must not write to shared memory that
+// another item reads or writes.
+void parallelFor(int count, std::function<void(int)> const &func);
+
+// Number of worker threads available to parallelRows
+int parallelThreads();
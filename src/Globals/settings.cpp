@@ -1,11 +1,12 @@
 #include "settings.h"
 
 #include <QDebug>
+#include <QStandardPaths>
 
 #define Q_BETWEEN(low, v, hi) Q_ASSERT(low <= v && v <= hi)
 
 #define MAX_IMAGE 8192
-#define MAX_MESH 256
+#define MAX_MESH 2048
 
 // Setup data for singleton
 bool Settings::_instance = false;
@@ -98,6 +99,26 @@ QDir Settings::tmpDir()
     return QDir(this->_tmp_dir->path());
 }
 
+/**
+ * cacheDir
+ * 
+ * Get the cache directory, used for data that is expensive to regenerate and
+ * should outlive the running application (such as erosion checkpoints). In
+ * development/test mode the temp directory is used instead.
+ * 
+ * @returns QDir : The directory object of the cache directory.
+ */
+QDir Settings::cacheDir()
+{
+#if (defined(DEVELOPMENT_MODE) || defined(TEST_MODE))
+    return this->tmpDir();
+#else
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    dir.mkpath(".");
+    return dir;
+#endif
+}
+
 /**
  * getAssetDirectories
  * 
@@ -179,7 +200,7 @@ int Settings::renderResolution()
  */
 int Settings::meshResolution()
 {
-    Q_BETWEEN(1, this->_mesh_resolution, 256);
+    Q_BETWEEN(1, this->_mesh_resolution, MAX_MESH);
     return this->_mesh_resolution;
 }
 
@@ -292,7 +313,7 @@ void Settings::setRenderResolution(int resolution)
 /**
  * setMeshResolution
  * 
- * Set the mesh resolution. Limited between 1 and MAX_MESH (256).
+ * Set the mesh resolution. Limited between 1 and MAX_MESH (2048).
  * 
  * @param int resolution : The new mesh terrain resolution.
  * 
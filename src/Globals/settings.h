@@ -25,6 +25,7 @@ public:
 
     // Getters
     QDir tmpDir(); // Get only
+    QDir cacheDir(); // Get only
     std::vector<QDir> getAssetDirectories(); // Get only
     QDir getDocsDirectory(); // Get only
 
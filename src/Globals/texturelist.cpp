@@ -1,5 +1,7 @@
 #include "texturelist.h"
 
+#include <algorithm>
+
 #include <QBrush>
 #include <QBuffer>
 #include <QColor>
@@ -7,6 +9,232 @@
 #include <QFileInfo>
 #include <QRect>
 
+#include "Globals/parallel.h"
+
+// A source pixel and its share of an output pixel along an axis
+struct Tap
+{
+    int index;
+    double weight;
+};
+
+/**
+ * taps
+ *
+ * The source pixels of every output pixel along an axis. Shrinking averages
+ * the span of source pixels each output pixel covers (an area filter),
+ * growing interpolates between the two nearest source pixel centres.
+ *
+ * @param int source : The pixels along the axis of the source.
+ * @param int size : The pixels along the axis of the output.
+ *
+ * @returns std::vector<std::vector<Tap>> : The taps of every output pixel,
+ *                                          their weights add up to 1.
+ */
+static std::vector<std::vector<Tap>> taps(int source, int size)
+{
+    std::vector<std::vector<Tap>> out(size);
+    double ratio = (double)source / size;
+
+    for (int i = 0; i < size; i++)
+    {
+        if (ratio >= 1.00)
+        {
+            double start = i * ratio;
+            double end = (i + 1) * ratio;
+            for (int s = (int)start; s < end && s < source; s++)
+            {
+                double weight = (qMin(end, s + 1.00) - qMax(start, (double)s))
+                                / ratio;
+                if (weight > 0.00)
+                    out[i].push_back(Tap{s, weight});
+            }
+        }
+        else
+        {
+            double centre =
+                qBound(0.00, (i + 0.50) * ratio - 0.50, source - 1.00);
+            int s = (int)centre;
+            double t = centre - s;
+            out[i].push_back(Tap{s, 1.00 - t});
+            if (t > 0.00)
+                out[i].push_back(Tap{qMin(s + 1, source - 1), t});
+        }
+    }
+
+    return out;
+}
+
+/**
+ * halve
+ *
+ * Halves a 16 bit RGBA image with a 2x2 box filter, odd sizes round up and
+ * repeat the last row or column.
+ *
+ * @param QImage const& image : The image (RGBA64, premultiplied).
+ *
+ * @returns QImage : The image at half the size.
+ */
+static QImage halve(QImage const &image)
+{
+    int width = (image.width() + 1) / 2;
+    int height = (image.height() + 1) / 2;
+    QImage half(width, height, image.format());
+
+    // Detach once before the rows are written from several threads
+    uchar *bits = half.bits();
+    int stride = half.bytesPerLine();
+
+    parallelRows(height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            quint16 const *top = (quint16 const *)image.constScanLine(2 * y);
+            quint16 const *bottom = (quint16 const *)image.constScanLine(
+                qMin(2 * y + 1, image.height() - 1));
+            quint16 *line = (quint16 *)(bits + (size_t)y * stride);
+
+            for (int x = 0; x < width; x++)
+            {
+                int left = 2 * x * 4;
+                int right = qMin(2 * x + 1, image.width() - 1) * 4;
+                for (int c = 0; c < 4; c++)
+                    line[x * 4 + c] = (quint16)((top[left + c]
+                                                 + top[right + c]
+                                                 + bottom[left + c]
+                                                 + bottom[right + c]
+                                                 + 2)
+                                                / 4);
+            }
+        }
+    });
+
+    return half;
+}
+
+/**
+ * resample
+ *
+ * Converts a 16 bit RGBA image to a vector map of a size, filtered with the
+ * taps of each axis. Colours are filtered premultiplied so transparent
+ * pixels do not bleed into their neighbours.
+ *
+ * @param QImage const& image : The image (RGBA64, premultiplied).
+ * @param int width : The width of the vector map.
+ * @param int height : The height of the vector map.
+ *
+ * @returns VectorMap : The vector map, colours not premultiplied.
+ */
+static VectorMap resample(QImage const &image, int width, int height)
+{
+    std::vector<std::vector<Tap>> columns = taps(image.width(), width);
+    std::vector<std::vector<Tap>> rows = taps(image.height(), height);
+    std::vector<glm::dvec4> values((size_t)width * height);
+
+    parallelRows(height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                glm::dvec4 sum(0.00, 0.00, 0.00, 0.00);
+                for (Tap const &row : rows[y])
+                {
+                    quint16 const *line =
+                        (quint16 const *)image.constScanLine(row.index);
+                    for (Tap const &column : columns[x])
+                    {
+                        quint16 const *pixel = line + column.index * 4;
+                        sum += row.weight * column.weight
+                               * glm::dvec4(pixel[0],
+                                            pixel[1],
+                                            pixel[2],
+                                            pixel[3]);
+                    }
+                }
+
+                sum /= 65535.00;
+                if (sum.a > 0.00)
+                {
+                    sum.r = qMin(1.00, sum.r / sum.a);
+                    sum.g = qMin(1.00, sum.g / sum.a);
+                    sum.b = qMin(1.00, sum.b / sum.a);
+                }
+                values[(size_t)y * width + x] = sum;
+            }
+        }
+    });
+
+    return VectorMap(width, height, values);
+}
+
+/**
+ * lastLevel
+ *
+ * Whether a mip level is the last one to filter a size from, the next level
+ * would be smaller than the size (or there is no next level).
+ *
+ * @param QSize level : The size of the mip level.
+ * @param int width : The width needed.
+ * @param int height : The height needed.
+ *
+ * @returns bool : Whether to use the level.
+ */
+static bool lastLevel(QSize level, int width, int height)
+{
+    return (level.width() + 1) / 2 < width
+           || (level.height() + 1) / 2 < height
+           || (level.width() == 1 && level.height() == 1);
+}
+
+/**
+ * cached
+ *
+ * Finds a map in a most recently used first cache, a found map is moved to
+ * the front.
+ *
+ * @param std::vector<std::pair<Key, Map>>& cache : The cache.
+ * @param Key const& key : The key of the map.
+ *
+ * @returns Map const* : The map, nullptr if not cached.
+ */
+template <typename Key, typename Map>
+static Map const *cached(std::vector<std::pair<Key, Map>> &cache,
+                         Key const &key)
+{
+    for (size_t i = 0; i < cache.size(); i++)
+    {
+        if (cache[i].first == key)
+        {
+            std::rotate(cache.begin(),
+                        cache.begin() + i,
+                        cache.begin() + i + 1);
+            return &cache.front().second;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * cache
+ *
+ * Adds a map to the front of a most recently used first cache, dropping the
+ * least recently used maps past the limit.
+ *
+ * @param std::vector<std::pair<Key, Map>>& cache : The cache.
+ * @param Key const& key : The key of the map.
+ * @param Map const& map : The map.
+ * @param size_t limit : The most maps to keep.
+ */
+template <typename Key, typename Map>
+static void cache(std::vector<std::pair<Key, Map>> &cache,
+                  Key const &key,
+                  Map const &map,
+                  size_t limit)
+{
+    cache.insert(cache.begin(), std::make_pair(key, map));
+    while (cache.size() > limit)
+        cache.pop_back();
+}
+
 /******************************************************************************
  *                                 TEXTURE                                    *
  ******************************************************************************/
@@ -186,15 +414,30 @@ QIcon Texture::icon()
 /**
  * vectorMap
  * 
- * Returns a vector map, which uses higher detail values of the texture.
+ * Returns a vector map, which uses higher detail values of the texture. The
+ * last few maps are cached by scale until the texture changes. Smaller maps
+ * are area filtered from the nearest mip level, larger ones interpolated
+ * linearly.
  * 
  * @param int scale : The scale of the output vector map.
  * 
  * @returns VectorMap : The vector map of the texture.
  */
 VectorMap Texture::vectorMap(int scale)
-{ 
-    return VectorMap(this->pixmap(scale));
+{
+    if (this->_pixmap.isNull())
+        return VectorMap(this->pixmap(scale));
+
+    int key = scale <= 0 ? -1 : scale;
+    if (VectorMap const *found = cached(this->_vector_maps, key))
+        return *found;
+
+    int width = scale <= 0 ? this->_pixmap.width() : scale;
+    int height = scale <= 0 ? this->_pixmap.height() : scale;
+    VectorMap map = resample(this->_mip(width, height), width, height);
+    cache(this->_vector_maps, key, map, CACHED_MAPS);
+
+    return map;
 }
 
 /**
@@ -216,13 +459,15 @@ void Texture::replace(QPixmap pixmap)
     qDebug("Updated texture");
     this->_pixmap = QPixmap(pixmap);
     this->_edited = true;
+    this->_invalidate();
     emit this->updated();
 }
 
 /**
  * intensityMap
  * 
- * Returns the intensity map (a mono color vector map).
+ * Returns the intensity map (a mono color vector map). Made from the vector
+ * map of the same scale, the last few are cached like the vector maps.
  * 
  * @param IntensityMap::Channel channel : The channel to use for combining the
  *                                        pixel colours into a mono channel.
@@ -230,7 +475,17 @@ void Texture::replace(QPixmap pixmap)
  */
 IntensityMap Texture::intensityMap(IntensityMap::Channel channel, int scale)
 {
-    return IntensityMap(this->pixmap(scale), channel);
+    if (this->_pixmap.isNull())
+        return IntensityMap(this->pixmap(scale), channel);
+
+    std::pair<int, int> key(channel, scale <= 0 ? -1 : scale);
+    if (IntensityMap const *found = cached(this->_intensity_maps, key))
+        return *found;
+
+    IntensityMap map = this->vectorMap(scale).toIntensityMap(channel);
+    cache(this->_intensity_maps, key, map, CACHED_MAPS);
+
+    return map;
 }
 
 /**
@@ -289,6 +544,7 @@ void Texture::draw(Stencil *stencil, QPointF pos)
     Q_CHECK_PTR(stencil);
     Q_CHECK_PTR(this->_painter);
     stencil->draw(this->_painter, pos);
+    this->_invalidate();
     emit this->updated();
 }
 
@@ -340,6 +596,56 @@ bool Texture::saveAs(QString filename)
     return this->_pixmap.save(filename, 0, 100);
 }
 
+/**
+ * _invalidate
+ *
+ * Drops the mip chain and the converted maps, they are made again from the
+ * pixmap when next asked for.
+ */
+void Texture::_invalidate()
+{
+    this->_mips.clear();
+    this->_vector_maps.clear();
+    this->_intensity_maps.clear();
+}
+
+/**
+ * _mip
+ *
+ * Returns the smallest level of the mip chain with at least the given size,
+ * building the chain from the pixmap as far as it is needed. Sizes more than
+ * half the pixmap use the pixmap (level 0), which is converted each time
+ * rather than kept, so the chain takes a third of the pixmap's pixels.
+ *
+ * @param int width : The width needed.
+ * @param int height : The height needed.
+ *
+ * @returns QImage : The mip level (RGBA64, premultiplied).
+ */
+QImage Texture::_mip(int width, int height)
+{
+    if (lastLevel(this->_pixmap.size(), width, height))
+        return this->_pixmap.toImage().convertToFormat(
+            QImage::Format_RGBA64_Premultiplied);
+
+    if (this->_mips.empty())
+        this->_mips.push_back(halve(this->_pixmap.toImage().convertToFormat(
+            QImage::Format_RGBA64_Premultiplied)));
+
+    for (size_t level = 0;; level++)
+    {
+        QImage const &image = this->_mips[level];
+        if (lastLevel(image.size(), width, height))
+            return this->_mips[level];
+
+        if (level + 1 == this->_mips.size())
+        {
+            QImage half = halve(image);
+            this->_mips.push_back(half);
+        }
+    }
+}
+
 /******************************************************************************
  *                               TEXTURELIST                                  *
  ******************************************************************************/
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include <QByteArray>
@@ -20,6 +21,14 @@
  * 
  * The texture class houses loaded and generated textures that are provided in
  * the InputTextureNode class and edited with the drawing singleton.
+ *
+ * Vector and intensity maps of the texture are cached by resolution, so nodes
+ * pulling the same size again get the converted map without scaling or
+ * converting the pixmap. Only the last few sizes used are kept (such as the
+ * preview and render resolutions), a full size vector map alone is 32 bytes
+ * a pixel. Smaller sizes are filtered from a mip chain of the pixmap (2x2 box
+ * filtered halvings), the last step averages the area each pixel covers.
+ * Replacing or drawing on the texture drops the caches.
  */
 class Texture : public QObject
 {
@@ -58,7 +67,7 @@ public:
     QString filename();
     QString saveName();
 
-    // Convert to vector map
+    // Convert to vector map (scale x scale, the pixmap size if <= 0)
     VectorMap vectorMap(int scale = -1);
 
     // Replace the underlying pixmap
@@ -83,6 +92,12 @@ signals:
     void updated();
 
 private:
+    // Drop the mip chain and the converted maps
+    void _invalidate();
+
+    // The smallest mip level with at least width x height pixels
+    QImage _mip(int width, int height);
+
     QString _filename = "";
     QPixmap _pixmap;
     // Painter for drawing on the _pixmap
@@ -90,6 +105,18 @@ private:
 
     bool _generated = false;
     bool _edited = false;
+
+    // Premultiplied 16 bit halvings of the pixmap from half size down, the
+    // pixmap itself is converted when needed rather than kept
+    std::vector<QImage> _mips;
+
+    // Maps kept of each kind
+    static const size_t CACHED_MAPS = 2;
+
+    // Converted maps by resolution (-1 for the pixmap size) and channel, most
+    // recently used first
+    std::vector<std::pair<int, VectorMap>> _vector_maps;
+    std::vector<std::pair<std::pair<int, int>, IntensityMap>> _intensity_maps;
 };
 
 /**
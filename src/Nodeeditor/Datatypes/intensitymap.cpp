@@ -1,9 +1,12 @@
 #include "intensitymap.h"
 
+#include <limits>
 #include <math.h>
 
 #include <QDebug>
 
+#include "Globals/parallel.h"
+
 /**
  * clamp
  * 
@@ -123,6 +126,48 @@ IntensityMap::IntensityMap(QPixmap image, IntensityMap::Channel channel)
     this->_saveImage(image.toImage(), channel);
 }
 
+/**
+ * IntensityMap
+ *
+ * Copies the pixels of another map. The cached tables are not shared, a copy
+ * that is written to directly would otherwise answer queries from the tables
+ * of the map it was copied from.
+ *
+ * @param IntensityMap const& other : The map to copy.
+ */
+IntensityMap::IntensityMap(IntensityMap const &other)
+    : width(other.width),
+      height(other.height),
+      values(other.values),
+      _fill(other._fill),
+      _use_fill(other._use_fill)
+{
+}
+
+/**
+ * operator=
+ *
+ * Copies the pixels of another map and drops the cached tables (see the copy
+ * constructor).
+ *
+ * @param IntensityMap const& other : The map to copy.
+ *
+ * @returns IntensityMap& : This map.
+ */
+IntensityMap &IntensityMap::operator=(IntensityMap const &other)
+{
+    if (this == &other)
+        return *this;
+
+    this->width = other.width;
+    this->height = other.height;
+    this->values = other.values;
+    this->_fill = other._fill;
+    this->_use_fill = other._use_fill;
+    this->invalidate();
+    return *this;
+}
+
 /**
  * toImage
  *
@@ -162,6 +207,40 @@ QImage IntensityMap::toImage(bool print_qimage)
     return image;
 }
 
+/**
+ * toHeightImage
+ *
+ * Returns the intensity map as a single channel 16 bit image, a quarter of
+ * the size of the 4 channel image. Values are clamped between 0 and 1 and
+ * the rows are converted in parallel.
+ *
+ * @returns QImage : The image (Format_Grayscale16).
+ */
+QImage IntensityMap::toHeightImage()
+{
+    QImage image(this->width, this->height, QImage::Format_Grayscale16);
+    bool full = this->values.size() == (size_t)this->width * this->height;
+
+    // Detach once before the rows are written from several threads
+    uchar *bits = image.bits();
+    int stride = image.bytesPerLine();
+
+    parallelRows(this->height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            quint16 *line = reinterpret_cast<quint16 *>(bits + (size_t)y * stride);
+            for (int x = 0; x < this->width; x++)
+            {
+                double h = full ? this->values[(size_t)y * this->width + x]
+                                : this->at(x, y);
+                line[x] = (quint16)qRound(qBound(0.00, h, 1.00) * 65535.00);
+            }
+        }
+    });
+
+    return image;
+}
+
 /**
  * toPixmap
  *
@@ -266,7 +345,7 @@ IntensityMap IntensityMap::transform(double func(double, double),
  *
  * @returns double : The intensity at the specified index.
  */
-double IntensityMap::at(int x, int y, bool clamp_to)
+double IntensityMap::at(int x, int y, bool clamp_to) const
 {
     if (x < 0 || x >= this->width || y < 0 || y >= this->height)
     {
@@ -294,7 +373,7 @@ double IntensityMap::at(int x, int y, bool clamp_to)
  *
  * @returns bool : Whether or not the map is only using fill.
  */
-bool IntensityMap::usingFill()
+bool IntensityMap::usingFill() const
 {
     return this->_use_fill;
 }
@@ -315,6 +394,7 @@ bool IntensityMap::append(double value)
 
     this->_use_fill = false;
     this->values.push_back(value);
+    this->invalidate();
     return true;
 }
 
@@ -341,9 +421,436 @@ bool IntensityMap::set(int x, int y, double value)
             this->values.push_back(this->_fill);
 
     this->values[y * this->width + x] = value;
+    this->invalidate();
     return true;
 }
 
+/**
+ * sum
+ *
+ * Sums the pixels of a region with the summed-area table, four reads however
+ * large the region is.
+ *
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The sum of the pixels in the region, 0 if empty.
+ */
+double IntensityMap::sum(int x_0, int y_0, int x_1, int y_1)
+{
+    if (!this->_clip(&x_0, &y_0, &x_1, &y_1))
+        return 0.00;
+
+    if (this->usingFill())
+        return this->_fill * (x_1 - x_0 + 1) * (y_1 - y_0 + 1);
+
+    this->_buildSums();
+    return this->_tableSum(*this->_sums, x_0, y_0, x_1, y_1);
+}
+
+/**
+ * average
+ *
+ * The mean of the pixels of a region (a box filter), see sum.
+ *
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The mean of the region, the fill value if empty.
+ */
+double IntensityMap::average(int x_0, int y_0, int x_1, int y_1)
+{
+    if (!this->_clip(&x_0, &y_0, &x_1, &y_1) || this->usingFill())
+        return this->_fill;
+
+    this->_buildSums();
+    double count = (double)(x_1 - x_0 + 1) * (double)(y_1 - y_0 + 1);
+    return this->_tableSum(*this->_sums, x_0, y_0, x_1, y_1) / count;
+}
+
+/**
+ * variance
+ *
+ * The variance of the pixels of a region from the tables of the values and
+ * their squares, the square root is the local contrast.
+ *
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The variance of the region, 0 if empty.
+ */
+double IntensityMap::variance(int x_0, int y_0, int x_1, int y_1)
+{
+    if (!this->_clip(&x_0, &y_0, &x_1, &y_1) || this->usingFill())
+        return 0.00;
+
+    this->_buildSums();
+    double count = (double)(x_1 - x_0 + 1) * (double)(y_1 - y_0 + 1);
+    double mean = this->_tableSum(*this->_sums, x_0, y_0, x_1, y_1) / count;
+    double squares =
+        this->_tableSum(*this->_squares, x_0, y_0, x_1, y_1) / count;
+
+    // Rounding can take a flat region slightly below 0
+    return std::max(0.00, squares - mean * mean);
+}
+
+/**
+ * minimum
+ *
+ * The smallest pixel of a region. The pyramid is descended from the top,
+ * cells inside the region are read whole and cells on its edges are split,
+ * so the cost follows the perimeter of the region rather than its area.
+ *
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The minimum of the region, the fill value if empty.
+ */
+double IntensityMap::minimum(int x_0, int y_0, int x_1, int y_1)
+{
+    if (!this->_clip(&x_0, &y_0, &x_1, &y_1) || this->usingFill())
+        return this->_fill;
+
+    this->_buildPyramid();
+    double min = std::numeric_limits<double>::infinity();
+    double max = -min;
+    this->_descend((int)this->_pyramid->size(), 0, 0,
+                   x_0, y_0, x_1, y_1, &min, &max);
+    return min;
+}
+
+/**
+ * maximum
+ *
+ * The largest pixel of a region, see minimum.
+ *
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The maximum of the region, the fill value if empty.
+ */
+double IntensityMap::maximum(int x_0, int y_0, int x_1, int y_1)
+{
+    if (!this->_clip(&x_0, &y_0, &x_1, &y_1) || this->usingFill())
+        return this->_fill;
+
+    this->_buildPyramid();
+    double min = std::numeric_limits<double>::infinity();
+    double max = -min;
+    this->_descend((int)this->_pyramid->size(), 0, 0,
+                   x_0, y_0, x_1, y_1, &min, &max);
+    return max;
+}
+
+/**
+ * minimum
+ *
+ * The smallest pixel of the map, the top of the pyramid.
+ *
+ * @returns double : The minimum.
+ */
+double IntensityMap::minimum()
+{
+    if (this->usingFill())
+        return this->_fill;
+
+    this->_buildPyramid();
+    if (this->_pyramid->empty())
+        return this->at(0, 0);
+    return this->_pyramid->back().min[0];
+}
+
+/**
+ * maximum
+ *
+ * The largest pixel of the map, the top of the pyramid.
+ *
+ * @returns double : The maximum.
+ */
+double IntensityMap::maximum()
+{
+    if (this->usingFill())
+        return this->_fill;
+
+    this->_buildPyramid();
+    if (this->_pyramid->empty())
+        return this->at(0, 0);
+    return this->_pyramid->back().max[0];
+}
+
+/**
+ * buildPyramid
+ *
+ * Builds the min/max pyramid if it is not built yet. Minimums and maximums
+ * can then be queried from several threads at once.
+ */
+void IntensityMap::buildPyramid()
+{
+    if (!this->usingFill())
+        this->_buildPyramid();
+}
+
+/**
+ * invalidate
+ *
+ * Drops the cached summed-area tables and pyramid, they are built again by
+ * the next query.
+ */
+void IntensityMap::invalidate()
+{
+    this->_sums.reset();
+    this->_squares.reset();
+    this->_pyramid.reset();
+}
+
+/**
+ * _buildSums
+ *
+ * Builds the summed-area tables of the values and their squares. The rows
+ * are prefix summed in parallel, then each row adds the row above it which
+ * runs along contiguous memory.
+ */
+void IntensityMap::_buildSums()
+{
+    if (this->_sums)
+        return;
+
+    int width = this->width;
+    int height = this->height;
+    size_t stride = (size_t)width + 1;
+    bool full = this->values.size() == (size_t)width * (size_t)height;
+
+    auto sums = std::make_shared<std::vector<double>>(
+        stride * (height + 1), 0.00);
+    auto squares = std::make_shared<std::vector<double>>(
+        stride * (height + 1), 0.00);
+
+    parallelRows(height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            double *row_sums = sums->data() + (y + 1) * stride;
+            double *row_squares = squares->data() + (y + 1) * stride;
+            double sum = 0.00;
+            double square = 0.00;
+            for (int x = 0; x < width; x++)
+            {
+                double value = full ? this->values[(size_t)y * width + x]
+                                    : this->at(x, y);
+                sum += value;
+                square += value * value;
+                row_sums[x + 1] = sum;
+                row_squares[x + 1] = square;
+            }
+        }
+    });
+
+    for (int y = 2; y <= height; y++)
+    {
+        double *row_sums = sums->data() + y * stride;
+        double *row_squares = squares->data() + y * stride;
+        double const *above_sums = row_sums - stride;
+        double const *above_squares = row_squares - stride;
+        for (size_t x = 1; x < stride; x++)
+        {
+            row_sums[x] += above_sums[x];
+            row_squares[x] += above_squares[x];
+        }
+    }
+
+    this->_sums = sums;
+    this->_squares = squares;
+}
+
+/**
+ * _buildPyramid
+ *
+ * Builds the min/max pyramid, halving the size (rounded up) every level
+ * until a single cell covers the whole map. Each level is built in parallel
+ * from the one below it.
+ */
+void IntensityMap::_buildPyramid()
+{
+    if (this->_pyramid)
+        return;
+
+    auto pyramid = std::make_shared<std::vector<Level>>();
+    bool full = this->values.size()
+                == (size_t)this->width * (size_t)this->height;
+
+    int width = this->width;
+    int height = this->height;
+    while (width > 1 || height > 1)
+    {
+        Level level;
+        level.width = (width + 1) / 2;
+        level.height = (height + 1) / 2;
+        level.min.resize((size_t)level.width * level.height);
+        level.max.resize((size_t)level.width * level.height);
+
+        Level const *below = pyramid->empty() ? nullptr : &pyramid->back();
+        parallelRows(level.height, [&](int start, int end) {
+            for (int cell_y = start; cell_y < end; cell_y++)
+            {
+                for (int cell_x = 0; cell_x < level.width; cell_x++)
+                {
+                    double min = std::numeric_limits<double>::infinity();
+                    double max = -min;
+                    int y_end = qMin(cell_y * 2 + 2, height);
+                    int x_end = qMin(cell_x * 2 + 2, width);
+                    for (int y = cell_y * 2; y < y_end; y++)
+                    {
+                        for (int x = cell_x * 2; x < x_end; x++)
+                        {
+                            size_t index = (size_t)y * width + x;
+                            double low, high;
+                            if (below)
+                            {
+                                low = below->min[index];
+                                high = below->max[index];
+                            }
+                            else
+                            {
+                                low = full ? this->values[index]
+                                           : this->at(x, y);
+                                high = low;
+                            }
+                            min = qMin(min, low);
+                            max = qMax(max, high);
+                        }
+                    }
+
+                    size_t cell = (size_t)cell_y * level.width + cell_x;
+                    level.min[cell] = min;
+                    level.max[cell] = max;
+                }
+            }
+        });
+
+        width = level.width;
+        height = level.height;
+        pyramid->push_back(std::move(level));
+    }
+
+    this->_pyramid = pyramid;
+}
+
+/**
+ * _clip
+ *
+ * Clips an inclusive region to the map.
+ *
+ * @param int* x_0 : The first column, clipped in place.
+ * @param int* y_0 : The first row, clipped in place.
+ * @param int* x_1 : The last column, clipped in place.
+ * @param int* y_1 : The last row, clipped in place.
+ *
+ * @returns bool : Whether any pixel of the map is in the region.
+ */
+bool IntensityMap::_clip(int *x_0, int *y_0, int *x_1, int *y_1) const
+{
+    Q_CHECK_PTR(x_0);
+    Q_CHECK_PTR(y_0);
+    Q_CHECK_PTR(x_1);
+    Q_CHECK_PTR(y_1);
+    *x_0 = std::max(*x_0, 0);
+    *y_0 = std::max(*y_0, 0);
+    *x_1 = std::min(*x_1, this->width - 1);
+    *y_1 = std::min(*y_1, this->height - 1);
+    return *x_0 <= *x_1 && *y_0 <= *y_1;
+}
+
+/**
+ * _tableSum
+ *
+ * Reads the sum of a clipped region from a summed-area table.
+ *
+ * @param std::vector<double> const& table : The summed-area table.
+ * @param int x_0 : The first column.
+ * @param int y_0 : The first row.
+ * @param int x_1 : The last column (inclusive).
+ * @param int y_1 : The last row (inclusive).
+ *
+ * @returns double : The sum of the region.
+ */
+double IntensityMap::_tableSum(std::vector<double> const &table,
+                               int x_0, int y_0, int x_1, int y_1) const
+{
+    size_t stride = (size_t)this->width + 1;
+    size_t top = (size_t)y_0 * stride;
+    size_t bottom = (size_t)(y_1 + 1) * stride;
+    return table[bottom + x_1 + 1] - table[top + x_1 + 1]
+           - table[bottom + x_0] + table[top + x_0];
+}
+
+/**
+ * _descend
+ *
+ * Folds the min and max of the part of a region within a pyramid cell into
+ * min and max. Cells outside the region are skipped, cells inside are read
+ * whole, and so are cells that cannot change the current min and max.
+ * Partly covered cells are split into their children.
+ *
+ * @param int level : The pyramid level of the cell, 0 is a pixel.
+ * @param int cell_x : The column of the cell in its level.
+ * @param int cell_y : The row of the cell in its level.
+ * @param int x_0 : The first column of the clipped region.
+ * @param int y_0 : The first row of the clipped region.
+ * @param int x_1 : The last column of the clipped region.
+ * @param int y_1 : The last row of the clipped region.
+ * @param double* min : The minimum so far, updated in place.
+ * @param double* max : The maximum so far, updated in place.
+ */
+void IntensityMap::_descend(int level, int cell_x, int cell_y,
+                            int x_0, int y_0, int x_1, int y_1,
+                            double *min, double *max)
+{
+    int left = cell_x << level;
+    int top = cell_y << level;
+    int right = qMin((cell_x + 1) << level, this->width) - 1;
+    int bottom = qMin((cell_y + 1) << level, this->height) - 1;
+    if (right < x_0 || left > x_1 || bottom < y_0 || top > y_1)
+        return;
+
+    if (level == 0)
+    {
+        double value = this->at(cell_x, cell_y);
+        *min = qMin(*min, value);
+        *max = qMax(*max, value);
+        return;
+    }
+
+    Level const &cells = (*this->_pyramid)[level - 1];
+    size_t index = (size_t)cell_y * cells.width + cell_x;
+    bool inside = left >= x_0 && right <= x_1 && top >= y_0 && bottom <= y_1;
+    bool within = cells.min[index] >= *min && cells.max[index] <= *max;
+    if (inside || within)
+    {
+        if (inside)
+        {
+            *min = qMin(*min, cells.min[index]);
+            *max = qMax(*max, cells.max[index]);
+        }
+        return;
+    }
+
+    int width = level == 1 ? this->width : (*this->_pyramid)[level - 2].width;
+    int height =
+        level == 1 ? this->height : (*this->_pyramid)[level - 2].height;
+    for (int y = cell_y * 2; y < qMin(cell_y * 2 + 2, height); y++)
+        for (int x = cell_x * 2; x < qMin(cell_x * 2 + 2, width); x++)
+            this->_descend(level - 1, x, y, x_0, y_0, x_1, y_1, min, max);
+}
+
 /**
  * _saveImage
  *
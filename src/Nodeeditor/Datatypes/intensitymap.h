@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <QImage>
@@ -10,6 +11,11 @@
  *
  * Houses a 2 dimensional array (internally stored in 1 dimension) a list of 
  * doubles that create a mono-coloured image or height map.
+ *
+ * Region queries (sums, averages, variances, minimums and maximums) build a
+ * summed-area table or a min/max pyramid on first use and cache it. Copies
+ * start without the cached tables (the copy may be written to), set and append
+ * drop them, and code that writes to values directly must call invalidate.
  */
 class IntensityMap
 {
@@ -45,9 +51,19 @@ public:
     // Create a map from a pixmap
     IntensityMap(QPixmap image, IntensityMap::Channel channel);
 
+    // Copy the pixels but not the cached tables, moves keep them
+    IntensityMap(IntensityMap const &other);
+    IntensityMap &operator=(IntensityMap const &other);
+    IntensityMap(IntensityMap &&other) = default;
+    IntensityMap &operator=(IntensityMap &&other) = default;
+
     // Return an image of the intensity map
     QImage toImage(bool print_qimage = true);
 
+    // Return a single channel 16 bit image of the intensity map (values
+    // clamped between 0 and 1), for height textures and exports
+    QImage toHeightImage();
+
     // Return a pixmap of the intensity map
     QPixmap toPixmap();
 
@@ -60,10 +76,10 @@ public:
     IntensityMap transform(double func(double, double), IntensityMap *map);
 
     // Get a specific value
-    double at(int x, int y, bool clamp_to = false);
+    double at(int x, int y, bool clamp_to = false) const;
 
     // Check if the map is using a solid fill color (all pixels the same)
-    bool usingFill();
+    bool usingFill() const;
 
     // Append a value (for filling with generated data) (bool whether can/successful)
     bool append(double value);
@@ -71,14 +87,70 @@ public:
     // Set a specific pixel (bool whether can/successful)
     bool set(int x, int y, double value);
 
+    // Region queries over the pixels from (x_0, y_0) to (x_1, y_1) inclusive,
+    // clipped to the map. Sums, averages and variances are O(1), minimums and
+    // maximums descend the pyramid. An empty region sums to 0, the other
+    // queries return the fill value.
+    double sum(int x_0, int y_0, int x_1, int y_1);
+    double average(int x_0, int y_0, int x_1, int y_1);
+    double variance(int x_0, int y_0, int x_1, int y_1);
+    double minimum(int x_0, int y_0, int x_1, int y_1);
+    double maximum(int x_0, int y_0, int x_1, int y_1);
+
+    // Smallest and largest value of the whole map
+    double minimum();
+    double maximum();
+
+    // Build the min/max pyramid up front. The queries build it on first use,
+    // which is not thread safe, call this before querying from several threads
+    void buildPyramid();
+
+    // Drop the cached tables, needed after writing to values directly
+    void invalidate();
+
     // Storage of the intensity map data
     int width = 1;
     int height = 1;
     std::vector<double> values;
 
 private:
+    // A level of the min/max pyramid, each cell covers 2x2 cells of the level
+    // below (clipped at the edges), level 0 is the map itself
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<double> min;
+        std::vector<double> max;
+    };
+
     // Used to convert image to intensity map
     void _saveImage(QImage image, IntensityMap::Channel channel);
+
+    // Build the cached tables if they are not built yet
+    void _buildSums();
+    void _buildPyramid();
+
+    // Clip a region to the map, false if nothing is left
+    bool _clip(int *x_0, int *y_0, int *x_1, int *y_1) const;
+
+    // Sum of a clipped region in a summed-area table
+    double _tableSum(std::vector<double> const &table,
+                     int x_0, int y_0, int x_1, int y_1) const;
+
+    // Min and max of the clipped region within a pyramid cell
+    void _descend(int level, int cell_x, int cell_y,
+                  int x_0, int y_0, int x_1, int y_1,
+                  double *min, double *max);
+
     double _fill = 0.00;
     bool _use_fill = false;
+
+    // Summed-area tables of the values and their squares, (width + 1) x
+    // (height + 1) with a leading row and column of zeros
+    std::shared_ptr<const std::vector<double>> _sums;
+    std::shared_ptr<const std::vector<double>> _squares;
+
+    // Min/max pyramid from level 1 (half size) up to a single cell
+    std::shared_ptr<const std::vector<Level>> _pyramid;
 };
\ No newline at end of file
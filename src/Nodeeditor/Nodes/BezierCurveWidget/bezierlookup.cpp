@@ -0,0 +1,121 @@
+#include "bezierlookup.h"
+
+#include <math.h>
+
+#include <QtGlobal>
+
+/**
+ * cubic
+ *
+ * The bezier function for a single dimension in the polynomial (horner) form.
+ *
+ * @param double t : The percentage of the bezier to get.
+ * @param double a : The first end point.
+ * @param double b : The first control point.
+ * @param double c : The second control point.
+ * @param double d : The second end point.
+ *
+ * @returns double : The resulting value.
+ */
+static inline double cubic(double t, double a, double b, double c, double d)
+{
+    double c_1 = 3.00 * (b - a);
+    double c_2 = 3.00 * (a - 2.00 * b + c);
+    double c_3 = d - a + 3.00 * (b - c);
+    return ((c_3 * t + c_2) * t + c_1) * t + a;
+}
+
+/**
+ * BezierLookup
+ *
+ * Creates an identity curve, every value maps to itself.
+ */
+BezierLookup::BezierLookup() : _table{0.00, 1.00} {}
+
+/**
+ * BezierLookup
+ *
+ * Samples the curve into the table. The points are in the widget space
+ * (0-100), the first end point followed by the control, control and end
+ * points of every bezier. Each bezier is flattened into a polyline with more
+ * samples than table entries it covers, then the polyline is read at every
+ * table entry. Before the first end point and after the last the curve is
+ * flat, as drawn by the widget.
+ *
+ * @param std::vector<QPointF> const& points : The saved points of the curve.
+ * @param int size : The number of table entries.
+ */
+BezierLookup::BezierLookup(std::vector<QPointF> const &points, int size)
+{
+    Q_ASSERT(size >= 2);
+    if (points.size() < 4)
+    {
+        this->_table = {0.00, 1.00};
+        return;
+    }
+
+    // Flatten the curve, x only increases along the polyline as the control
+    // points are clamped between the end points
+    std::vector<QPointF> line;
+    line.push_back(QPointF(0.00, points[0].y()));
+    line.push_back(points[0]);
+
+    for (size_t i = 0; i + 3 < points.size(); i += 3)
+    {
+        QPointF a = points[i];
+        QPointF b = points[i + 1];
+        QPointF c = points[i + 2];
+        QPointF d = points[i + 3];
+
+        int samples = 16 + (int)ceil((d.x() - a.x()) / 100.00 * size * 4);
+        for (int s = 1; s <= samples; s++)
+        {
+            double t = s / (double)samples;
+            line.push_back(QPointF(cubic(t, a.x(), b.x(), c.x(), d.x()),
+                                   cubic(t, a.y(), b.y(), c.y(), d.y())));
+        }
+    }
+
+    line.push_back(QPointF(100.00, line.back().y()));
+
+    // Read the polyline at every entry, the first segment that reaches x is
+    // used (same as the widget intersection)
+    this->_table.resize(size);
+    size_t j = 0;
+    for (int i = 0; i < size; i++)
+    {
+        double x = i * 100.00 / (size - 1);
+        while (j + 2 < line.size() && line[j + 1].x() < x)
+            j++;
+
+        QPointF p_0 = line[j];
+        QPointF p_1 = line[j + 1];
+        double dx = p_1.x() - p_0.x();
+        double t = dx > 0.00 ? (x - p_0.x()) / dx : 1.00;
+        t = qBound(0.00, t, 1.00);
+
+        this->_table[i] = (p_0.y() + (p_1.y() - p_0.y()) * t) / 100.00;
+    }
+}
+
+/**
+ * value
+ *
+ * Get the resulting value of y = f(x), linearly interpolated between the two
+ * nearest table entries. X is clamped between 0 and 1, the returned value can
+ * be outside of 0 and 1 as the control points can be.
+ *
+ * @param double x : The value to transform.
+ *
+ * @returns double : The transformed value.
+ */
+double BezierLookup::value(double x) const
+{
+    int last = (int)this->_table.size() - 1;
+    double position = qBound(0.00, x, 1.00) * last;
+
+    int i = qMin((int)position, last - 1);
+    double t = position - i;
+
+    return this->_table[i] + (this->_table[i + 1] - this->_table[i]) * t;
+}
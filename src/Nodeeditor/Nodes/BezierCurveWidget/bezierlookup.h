@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include <QPointF>
+
+/**
+ * BezierLookup
+ *
+ * A dense table of the combined bezier curve as a function y = f(x), sampled
+ * once from the control points saved by the BezierEditWidget. Looking up a
+ * value is an interpolated table read, so transforming a map does not touch
+ * the widget or the graphics scene and can run on any thread.
+ */
+class BezierLookup
+{
+public:
+    // Number of entries in the table across x [0, 1]
+    static const int SIZE = 16384;
+
+    // Create an identity curve (f(x) = x)
+    BezierLookup();
+
+    // Sample the curve from the saved points (BezierEditWidget::save)
+    BezierLookup(std::vector<QPointF> const &points, int size = SIZE);
+
+    // Get the transformed value, x is clamped between 0 and 1
+    double value(double x) const;
+
+private:
+    std::vector<double> _table;
+};
@@ -110,6 +110,61 @@ QPointF bezier(double t, QPointF a, QPointF b, QPointF c, QPointF d)
         bezier(t, a.y(), b.y(), c.y(), d.y()));
 }
 
+/**
+ * flatten
+ * 
+ * Adds the bezier to the path as line segments. The bezier is split in half
+ * (de Casteljau) until its control points are within the tolerance of the line
+ * between its end points, so straight parts get few segments and tight bends
+ * get many.
+ * 
+ * @param QPainterPath* path : The path to add to, it must end at a.
+ * @param QPointF a : The first end point.
+ * @param QPointF b : The first control point.
+ * @param QPointF c : The second control point.
+ * @param QPointF d : The second end point.
+ * @param int depth : The number of splits remaining.
+ */
+static void flatten(QPainterPath *path,
+                    QPointF a,
+                    QPointF b,
+                    QPointF c,
+                    QPointF d,
+                    int depth = 10)
+{
+    // Distance of the control points from the line between the end points,
+    // or from the end point when the end points meet
+    QPointF chord = d - a;
+    double length = hypot(chord.x(), chord.y());
+    double dist_b = hypot(b.x() - a.x(), b.y() - a.y());
+    double dist_c = hypot(c.x() - a.x(), c.y() - a.y());
+    if (length > 0.00)
+    {
+        dist_b = fabs(chord.x() * (b - a).y() - chord.y() * (b - a).x())
+                 / length;
+        dist_c = fabs(chord.x() * (c - a).y() - chord.y() * (c - a).x())
+                 / length;
+    }
+
+    // Flat within a tenth of a unit (the widget is 100 units across)
+    if (depth == 0 || (dist_b <= 0.10 && dist_c <= 0.10))
+    {
+        path->lineTo(d);
+        return;
+    }
+
+    // Split at t = 0.5
+    QPointF ab = (a + b) / 2.00;
+    QPointF bc = (b + c) / 2.00;
+    QPointF cd = (c + d) / 2.00;
+    QPointF abc = (ab + bc) / 2.00;
+    QPointF bcd = (bc + cd) / 2.00;
+    QPointF mid = (abc + bcd) / 2.00;
+
+    flatten(path, a, ab, abc, mid, depth - 1);
+    flatten(path, mid, bcd, cd, d, depth - 1);
+}
+
 /******************************************************************************
  *                                BEZIER                                      *
  ******************************************************************************/
@@ -257,11 +312,16 @@ bool Bezier::intersect(QLineF line, QPointF *pos)
         return false;
     }
 
-    // Find an intersetion point by iterating over each line segment
-    for (int i = 0; i < (int)this->curve.size(); i++)
+    if (!this->curve)
+        return false;
+
+    // Find an intersetion point by iterating over each line segment of the
+    // flattened path
+    QPainterPath path = this->curve->path();
+    for (int i = 1; i < path.elementCount(); i++)
     {
-        if (line.intersects(this->curve[i]->line(), pos)
-            == QLineF::BoundedIntersection)
+        QLineF segment(path.elementAt(i - 1), path.elementAt(i));
+        if (line.intersects(segment, pos) == QLineF::BoundedIntersection)
         {
             return true;
         }
@@ -272,8 +332,9 @@ bool Bezier::intersect(QLineF line, QPointF *pos)
 /**
  * draw
  * 
- * Draws the curve using the bezier function to draw segments of line to the
- * scene.
+ * Draws the curve as a single path item, the path is the bezier flattened
+ * into line segments. The item is created once and its path is replaced on
+ * every redraw.
  */
 void Bezier::draw()
 {
@@ -292,48 +353,38 @@ void Bezier::draw()
     QPointF c = this->control_1->pos();
     QPointF d = this->end_1->pos();
 
-    // The number of samples (the entire widget line segment gets 2048 samples,
-    // each bezier gets a percentage of that)
-    int samples = (int)((this->end_1->pos().x()
-                         - this->end_0->pos().x()) * 2048 / 100);
-
     // Update control lines
     this->line_0->setLine(QLineF(a, b));
     this->line_1->setLine(QLineF(c, d));
 
-    // Clear the current existing curve curve
-    this->clear();
+    QPainterPath path(a);
+    flatten(&path, a, b, c, d);
 
-    QPointF prev = a;
-    // For each pair of points along the curve using the bezier fuction
-    // draw the line segments
-    for (int i = 1; i < samples + 1; i++)
+    if (this->curve)
     {
-        double perc = i / (double)samples;
-        QPointF cur = bezier(perc, a, b, c, d);
-        this->curve.push_back(
-            this->scene->addLine(QLineF(prev, cur), curve_pen));
-
-        prev = cur;
+        this->curve->setPath(path);
+        return;
     }
+
+    this->curve = this->scene->addPath(path, this->curve_pen);
+    this->curve->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 /**
  * clear
  * 
- * Clears the drawn lines from the scene, usually used for redrawing the updated
- * curve.
+ * Clears the drawn curve from the scene, usually used for removing the curve.
  */
 void Bezier::clear()
 {
     Q_CHECK_PTR(this->scene);
-    // Remove lines from the scene
-    for (int i = 0; i < (int)this->curve.size(); i++)
-    {
-        this->scene->removeItem(this->curve[i]);
-    }
-    // Empty the vector list
-    this->curve.clear();
+    if (!this->curve)
+        return;
+
+    // Remove the path from the scene
+    this->scene->removeItem(this->curve);
+    delete this->curve;
+    this->curve = nullptr;
 }
 
 /**
@@ -4,8 +4,10 @@
 
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
+#include <QGraphicsPathItem>
 #include <QGraphicsView>
 #include <QMouseEvent>
+#include <QPainterPath>
 #include <QPointF>
 #include <QResizeEvent>
 
@@ -53,7 +55,7 @@ public:
     // Show the control elements
     void show();
 
-    // Clears the curve line (for redrawing updated curve)
+    // Clears the curve line (for removing the curve)
     void clear();
 
     // Removes the control values from the widget, for using restored data
@@ -76,7 +78,7 @@ public:
     float curve_width;
 
     // Graphic elements
-    std::vector<QGraphicsLineItem *> curve;
+    QGraphicsPathItem *curve = nullptr; // the flattened curve
     QGraphicsScene *scene = nullptr;
 
     QGraphicsEllipseItem *end_0 = nullptr;
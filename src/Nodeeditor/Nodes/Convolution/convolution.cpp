@@ -0,0 +1,672 @@
+#include "convolution.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+#include "fft.h"
+
+/**
+ * Convolution
+ *
+ * Creates the convolution.
+ *
+ * @param Border border : How pixels outside of the map are read.
+ */
+Convolution::Convolution(Border border) : _border(border) {}
+
+/**
+ * separable
+ *
+ * Convolves the map with a separable kernel, the kernel is the product of a
+ * horizontal and a vertical kernel. Both kernels must have an odd number of
+ * taps, the middle tap is over the pixel. Kernels with many taps are
+ * convolved in the frequency domain.
+ *
+ * @param IntensityMap map : The map to convolve.
+ * @param std::vector<double> const& kernel_x : The horizontal kernel.
+ * @param std::vector<double> const& kernel_y : The vertical kernel.
+ *
+ * @returns IntensityMap : The convolved map.
+ */
+IntensityMap Convolution::separable(IntensityMap map,
+                                    std::vector<double> const &kernel_x,
+                                    std::vector<double> const &kernel_y)
+{
+    Q_ASSERT(kernel_x.size() % 2 == 1);
+    Q_ASSERT(kernel_y.size() % 2 == 1);
+
+    if ((int)(kernel_x.size() + kernel_y.size()) > SPECTRAL_TAPS)
+    {
+        IntensityMap kernel((int)kernel_x.size(), (int)kernel_y.size());
+        for (double tap_y : kernel_y)
+            for (double tap_x : kernel_x)
+                kernel.append(tap_x * tap_y);
+
+        return this->spectral(map, kernel);
+    }
+
+    std::vector<double> values = this->_load(map);
+    std::vector<double> buffer(values.size());
+
+    this->_kernelRows(values, &buffer, kernel_x);
+    this->_kernelColumns(buffer, &values, kernel_y);
+
+    return IntensityMap(map.width, map.height, values);
+}
+
+/**
+ * spectral
+ *
+ * Convolves the map with a 2D kernel through the frequency domain. The map is
+ * padded with its border (the radius of the kernel on every side) and the
+ * kernel is flipped around the origin, so the circular convolution of the
+ * transforms does not wrap around. With the NORMALIZE border the pixels on the
+ * map are convolved as well, to rescale the kernel at the edges.
+ *
+ * @param IntensityMap map : The map to convolve.
+ * @param IntensityMap kernel : The kernel (odd width and height), the middle
+ *                              tap is over the pixel.
+ *
+ * @returns IntensityMap : The convolved map.
+ */
+IntensityMap Convolution::spectral(IntensityMap map, IntensityMap kernel)
+{
+    Q_ASSERT(kernel.width % 2 == 1);
+    Q_ASSERT(kernel.height % 2 == 1);
+
+    std::vector<double> values = this->_load(map);
+    int radius_x = kernel.width / 2;
+    int radius_y = kernel.height / 2;
+    int width = FFT::fastSize(map.width + 2 * radius_x);
+    int height = FFT::fastSize(map.height + 2 * radius_y);
+    size_t size = (size_t)width * (size_t)height;
+
+    // The map and its border, the map pixels are marked in the mask
+    std::vector<double> padded(size, 0.00);
+    std::vector<double> mask(size, 0.00);
+    for (int y = 0; y < map.height + 2 * radius_y; y++)
+    {
+        int source_y = this->_sample(y - radius_y, map.height);
+        for (int x = 0; x < map.width + 2 * radius_x; x++)
+        {
+            int source_x = this->_sample(x - radius_x, map.width);
+            bool inside = source_x >= 0 && source_y >= 0;
+            padded[(size_t)y * width + x] =
+                inside ? values[(size_t)source_y * map.width + source_x]
+                       : this->_fill;
+            mask[(size_t)y * width + x] = inside ? 1.00 : 0.00;
+        }
+    }
+
+    // The kernel flipped and wrapped around the origin
+    std::vector<double> wrapped(size, 0.00);
+    double total = 0.00;
+    for (int j = 0; j < kernel.height; j++)
+    {
+        for (int i = 0; i < kernel.width; i++)
+        {
+            int x = (radius_x - i + width) % width;
+            int y = (radius_y - j + height) % height;
+            wrapped[(size_t)y * width + x] = kernel.at(i, j);
+            total += kernel.at(i, j);
+        }
+    }
+
+    FFT fft(width, height);
+    std::vector<FFT::Complex> filter =
+        fft.forward(IntensityMap(width, height, wrapped));
+
+    auto convolve = [&](std::vector<double> const &grid) {
+        std::vector<FFT::Complex> spectrum =
+            fft.forward(IntensityMap(width, height, grid));
+        for (size_t i = 0; i < spectrum.size(); i++)
+            spectrum[i] *= filter[i];
+        return fft.inverse(spectrum);
+    };
+
+    IntensityMap result = convolve(padded);
+    IntensityMap weight = this->_border == NORMALIZE
+                              ? convolve(mask)
+                              : IntensityMap(1, 1, 1.00);
+
+    for (int y = 0; y < map.height; y++)
+    {
+        for (int x = 0; x < map.width; x++)
+        {
+            size_t i = (size_t)(y + radius_y) * width + x + radius_x;
+            double value = result.values[i];
+            if (this->_border == NORMALIZE && fabs(weight.values[i]) > 1e-12)
+                value *= total / weight.values[i];
+
+            values[(size_t)y * map.width + x] = value;
+        }
+    }
+
+    return IntensityMap(map.width, map.height, values);
+}
+
+/**
+ * direct
+ *
+ * Convolves the map with a small 2D kernel tap by tap, for kernels that are
+ * not separable and too small for the frequency domain to pay off. For every
+ * output row the rows under the kernel are copied into a padded line (as in
+ * _kernelRows) and each tap is added along the whole line. With the NORMALIZE
+ * border the taps on the map are added up as well, to rescale the kernel at
+ * the edges.
+ *
+ * @param IntensityMap map : The map to convolve.
+ * @param IntensityMap kernel : The kernel (odd width and height), the middle
+ *                              tap is over the pixel.
+ *
+ * @returns IntensityMap : The convolved map.
+ */
+IntensityMap Convolution::direct(IntensityMap map, IntensityMap kernel)
+{
+    Q_ASSERT(kernel.width % 2 == 1);
+    Q_ASSERT(kernel.height % 2 == 1);
+
+    std::vector<double> values = this->_load(map);
+    int width = map.width;
+    int height = map.height;
+    int radius_x = kernel.width / 2;
+    int radius_y = kernel.height / 2;
+
+    double total = 0.00;
+    for (int j = 0; j < kernel.height; j++)
+        for (int i = 0; i < kernel.width; i++)
+            total += kernel.at(i, j);
+
+    std::vector<double> out(values.size());
+    parallelRows(height, [&](int start, int end) {
+        std::vector<double> line(width + 2 * radius_x);
+        std::vector<double> mask(width + 2 * radius_x);
+        std::vector<double> weight(width);
+        for (int y = start; y < end; y++)
+        {
+            double *result = out.data() + (size_t)y * width;
+            std::fill(result, result + width, 0.00);
+            std::fill(weight.begin(), weight.end(), 0.00);
+
+            for (int j = 0; j < kernel.height; j++)
+            {
+                int source_y = this->_sample(y + j - radius_y, height);
+                for (int i = 0; i < (int)line.size(); i++)
+                {
+                    int x = source_y < 0 ? -1
+                                         : this->_sample(i - radius_x, width);
+                    line[i] = x < 0 ? this->_fill
+                                    : values[(size_t)source_y * width + x];
+                    mask[i] = x < 0 ? 0.00 : 1.00;
+                }
+
+                for (int i = 0; i < kernel.width; i++)
+                {
+                    double tap = kernel.at(i, j);
+                    double const *shifted = line.data() + i;
+                    double const *inside = mask.data() + i;
+                    for (int x = 0; x < width; x++)
+                    {
+                        result[x] += tap * shifted[x];
+                        weight[x] += tap * inside[x];
+                    }
+                }
+            }
+
+            if (this->_border == NORMALIZE)
+                for (int x = 0; x < width; x++)
+                    if (weight[x] != 0.00)
+                        result[x] *= total / weight[x];
+        }
+    });
+
+    return IntensityMap(width, height, out);
+}
+
+/**
+ * box
+ *
+ * Averages every pixel with the pixels in the square around it. The running
+ * sums make the cost per pixel the same for every radius. Repeating the box
+ * approaches a gaussian (3 passes is close).
+ *
+ * @param IntensityMap map : The map to blur.
+ * @param int radius : The distance from the pixel to the edge of the square.
+ * @param int passes : The number of times the box is applied.
+ *
+ * @returns IntensityMap : The blurred map.
+ */
+IntensityMap Convolution::box(IntensityMap map, int radius, int passes)
+{
+    if (radius <= 0 || passes <= 0)
+        return map;
+
+    std::vector<double> values = this->_load(map);
+    std::vector<double> buffer(values.size());
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        this->_boxRows(values, &buffer, radius);
+        this->_boxColumns(buffer, &values, radius);
+    }
+
+    return IntensityMap(map.width, map.height, values);
+}
+
+/**
+ * gaussian
+ *
+ * Blurs the map with a gaussian. Small spreads use the sampled kernel, larger
+ * spreads use three box passes with the same spread so the cost does not grow
+ * with sigma.
+ *
+ * @param IntensityMap map : The map to blur.
+ * @param double sigma : The standard deviation (in pixels).
+ *
+ * @returns IntensityMap : The blurred map.
+ */
+IntensityMap Convolution::gaussian(IntensityMap map, double sigma)
+{
+    if (sigma <= 0.00)
+        return map;
+
+    if (sigma < 3.00)
+    {
+        std::vector<double> kernel = Convolution::gaussianKernel(sigma);
+        return this->separable(map, kernel, kernel);
+    }
+
+    std::vector<double> values = this->_load(map);
+    std::vector<double> buffer(values.size());
+
+    for (int radius : Convolution::gaussianBoxes(sigma))
+    {
+        this->_boxRows(values, &buffer, radius);
+        this->_boxColumns(buffer, &values, radius);
+    }
+
+    return IntensityMap(map.width, map.height, values);
+}
+
+/**
+ * gaussianKernel
+ *
+ * Samples the gaussian function at every tap within 3 sigma of the center,
+ * the taps are normalized to add up to 1.
+ *
+ * @param double sigma : The standard deviation (in pixels).
+ *
+ * @returns std::vector<double> : The kernel (odd length).
+ */
+std::vector<double> Convolution::gaussianKernel(double sigma)
+{
+    if (sigma <= 0.00)
+        return {1.00};
+
+    int radius = (int)ceil(3.00 * sigma);
+    std::vector<double> kernel(2 * radius + 1);
+
+    double total = 0.00;
+    for (int i = -radius; i <= radius; i++)
+    {
+        kernel[i + radius] = exp(-(i * i) / (2.00 * sigma * sigma));
+        total += kernel[i + radius];
+    }
+
+    for (double &tap : kernel)
+        tap /= total;
+
+    return kernel;
+}
+
+/**
+ * gaussianBoxes
+ *
+ * Finds the radii of three box passes that together have the spread of a
+ * gaussian. The box widths are the two odd widths around the ideal width,
+ * mixed so the variance matches.
+ * (Kovesi, Fast Almost-Gaussian Filtering)
+ *
+ * @param double sigma : The standard deviation (in pixels).
+ *
+ * @returns std::vector<int> : The radius of each box pass.
+ */
+std::vector<int> Convolution::gaussianBoxes(double sigma)
+{
+    const int passes = 3;
+    double variance = 12.00 * sigma * sigma;
+
+    int lower = (int)floor(sqrt(variance / passes + 1.00));
+    if (lower % 2 == 0)
+        lower--;
+    int upper = lower + 2;
+
+    // Number of passes that use the lower width
+    int count = (int)round((variance
+                            - passes * lower * lower
+                            - 4 * passes * lower
+                            - 3 * passes)
+                           / (-4.00 * lower - 4.00));
+
+    std::vector<int> radii;
+    for (int i = 0; i < passes; i++)
+        radii.push_back(((i < count ? lower : upper) - 1) / 2);
+
+    return radii;
+}
+
+/**
+ * _kernelRows
+ *
+ * Convolves every row with the kernel. Each row is copied into a padded line
+ * (the border pixels resolved once), then every tap is added along the whole
+ * line.
+ *
+ * @param std::vector<double> const& in : The grid to read.
+ * @param std::vector<double>* out : The grid to write.
+ * @param std::vector<double> const& kernel : The horizontal kernel.
+ */
+void Convolution::_kernelRows(std::vector<double> const &in,
+                              std::vector<double> *out,
+                              std::vector<double> const &kernel)
+{
+    Q_CHECK_PTR(out);
+    int width = this->_width;
+    int radius = (int)kernel.size() / 2;
+    std::vector<double> scale = this->_normalize(width, kernel);
+
+    parallelRows(this->_height, [&](int start, int end) {
+        std::vector<double> line(width + 2 * radius);
+        for (int y = start; y < end; y++)
+        {
+            double const *row = in.data() + (size_t)y * width;
+            for (int i = 0; i < (int)line.size(); i++)
+            {
+                int x = this->_sample(i - radius, width);
+                line[i] = x < 0 ? this->_fill : row[x];
+            }
+
+            double *result = out->data() + (size_t)y * width;
+            std::fill(result, result + width, 0.00);
+            for (int k = 0; k < (int)kernel.size(); k++)
+            {
+                double tap = kernel[k];
+                double const *shifted = line.data() + k;
+                for (int x = 0; x < width; x++)
+                    result[x] += tap * shifted[x];
+            }
+
+            if (!scale.empty())
+                for (int x = 0; x < width; x++)
+                    result[x] *= scale[x];
+        }
+    });
+}
+
+/**
+ * _kernelColumns
+ *
+ * Convolves every column with the kernel. Each output row adds the rows above
+ * and below it scaled by their tap, a whole row at a time.
+ *
+ * @param std::vector<double> const& in : The grid to read.
+ * @param std::vector<double>* out : The grid to write.
+ * @param std::vector<double> const& kernel : The vertical kernel.
+ */
+void Convolution::_kernelColumns(std::vector<double> const &in,
+                                 std::vector<double> *out,
+                                 std::vector<double> const &kernel)
+{
+    Q_CHECK_PTR(out);
+    int width = this->_width;
+    int radius = (int)kernel.size() / 2;
+    std::vector<double> scale = this->_normalize(this->_height, kernel);
+
+    parallelRows(this->_height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            double *result = out->data() + (size_t)y * width;
+            std::fill(result, result + width, 0.00);
+            for (int k = 0; k < (int)kernel.size(); k++)
+            {
+                double tap = kernel[k];
+                int source = this->_sample(y + k - radius, this->_height);
+                if (source < 0)
+                {
+                    for (int x = 0; x < width; x++)
+                        result[x] += tap * this->_fill;
+                    continue;
+                }
+
+                double const *row = in.data() + (size_t)source * width;
+                for (int x = 0; x < width; x++)
+                    result[x] += tap * row[x];
+            }
+
+            if (!scale.empty())
+                for (int x = 0; x < width; x++)
+                    result[x] *= scale[y];
+        }
+    });
+}
+
+/**
+ * _boxRows
+ *
+ * Averages every row over a window. The sum of the window is kept while it
+ * slides, adding the pixel entering and removing the pixel leaving.
+ *
+ * @param std::vector<double> const& in : The grid to read.
+ * @param std::vector<double>* out : The grid to write.
+ * @param int radius : The distance from the pixel to the edge of the window.
+ */
+void Convolution::_boxRows(std::vector<double> const &in,
+                           std::vector<double> *out,
+                           int radius)
+{
+    Q_CHECK_PTR(out);
+    int width = this->_width;
+    int size = 2 * radius + 1;
+
+    std::vector<double> scale =
+        this->_normalize(width, std::vector<double>(size, 1.00 / size));
+
+    parallelRows(this->_height, [&](int start, int end) {
+        std::vector<double> line(width + 2 * radius);
+        for (int y = start; y < end; y++)
+        {
+            double const *row = in.data() + (size_t)y * width;
+            for (int i = 0; i < (int)line.size(); i++)
+            {
+                int x = this->_sample(i - radius, width);
+                line[i] = x < 0 ? this->_fill : row[x];
+            }
+
+            double *result = out->data() + (size_t)y * width;
+            double sum = 0.00;
+            for (int i = 0; i < size; i++)
+                sum += line[i];
+
+            result[0] = sum / size;
+            for (int x = 1; x < width; x++)
+            {
+                sum += line[x + size - 1] - line[x - 1];
+                result[x] = sum / size;
+            }
+
+            if (!scale.empty())
+                for (int x = 0; x < width; x++)
+                    result[x] *= scale[x];
+        }
+    });
+}
+
+/**
+ * _boxColumns
+ *
+ * Averages every column over a window. A whole row of sums slides down the
+ * map, adding the row entering and removing the row leaving. Each band of
+ * rows starts its own sums.
+ *
+ * @param std::vector<double> const& in : The grid to read.
+ * @param std::vector<double>* out : The grid to write.
+ * @param int radius : The distance from the pixel to the edge of the window.
+ */
+void Convolution::_boxColumns(std::vector<double> const &in,
+                              std::vector<double> *out,
+                              int radius)
+{
+    Q_CHECK_PTR(out);
+    int width = this->_width;
+    int size = 2 * radius + 1;
+
+    std::vector<double> scale = this->_normalize(
+        this->_height, std::vector<double>(size, 1.00 / size));
+
+    // Add (sign 1) or remove (sign -1) a row to the sums
+    auto accumulate = [&](double *sums, int y, double sign) {
+        int source = this->_sample(y, this->_height);
+        if (source < 0)
+        {
+            for (int x = 0; x < width; x++)
+                sums[x] += sign * this->_fill;
+            return;
+        }
+
+        double const *row = in.data() + (size_t)source * width;
+        for (int x = 0; x < width; x++)
+            sums[x] += sign * row[x];
+    };
+
+    parallelRows(this->_height, [&](int start, int end) {
+        std::vector<double> sums(width, 0.00);
+        for (int y = start - radius; y <= start + radius; y++)
+            accumulate(sums.data(), y, 1.00);
+
+        for (int y = start; y < end; y++)
+        {
+            if (y > start)
+            {
+                accumulate(sums.data(), y + radius, 1.00);
+                accumulate(sums.data(), y - radius - 1, -1.00);
+            }
+
+            double factor = scale.empty() ? 1.00 / size : scale[y] / size;
+            double *result = out->data() + (size_t)y * width;
+            for (int x = 0; x < width; x++)
+                result[x] = sums[x] * factor;
+        }
+    });
+}
+
+/**
+ * _normalize
+ *
+ * With the NORMALIZE border the taps outside of the map are dropped, the rest
+ * are scaled up to weigh as much as the whole kernel. Other borders read every
+ * tap and need no scale (empty).
+ *
+ * @param int size : The number of pixels along the line.
+ * @param std::vector<double> const& kernel : The kernel along the line.
+ *
+ * @returns std::vector<double> : The scale for each position on the line.
+ */
+std::vector<double> Convolution::_normalize(int size,
+                                            std::vector<double> const &kernel)
+{
+    if (this->_border != NORMALIZE)
+        return std::vector<double>();
+
+    int radius = (int)kernel.size() / 2;
+    double total = 0.00;
+    for (double tap : kernel)
+        total += tap;
+
+    std::vector<double> scale(size, 1.00);
+    for (int i = 0; i < size; i++)
+    {
+        double inside = 0.00;
+        for (int k = std::max(0, radius - i);
+             k < (int)kernel.size() && i + k - radius < size;
+             k++)
+            inside += kernel[k];
+
+        if (inside != 0.00)
+            scale[i] = total / inside;
+    }
+    return scale;
+}
+
+/**
+ * _sample
+ *
+ * Finds the pixel read for a position on a line, positions outside the line
+ * are resolved with the border mode.
+ *
+ * @param int i : The position on the line.
+ * @param int size : The number of pixels along the line.
+ *
+ * @returns int : The pixel to read, -1 reads the fill value.
+ */
+int Convolution::_sample(int i, int size) const
+{
+    if (i >= 0 && i < size)
+        return i;
+
+    switch (this->_border)
+    {
+    case CLAMP:
+        return i < 0 ? 0 : size - 1;
+
+    case MIRROR:
+    {
+        if (size == 1)
+            return 0;
+
+        int period = 2 * size - 2;
+        int m = ((i % period) + period) % period;
+        return m < size ? m : period - m;
+    }
+
+    case WRAP:
+        return ((i % size) + size) % size;
+
+    case FILL:
+    case NORMALIZE:
+        break;
+    }
+    return -1;
+}
+
+/**
+ * _load
+ *
+ * Reads the map into a grid (one value per pixel) and keeps the size and fill
+ * value. The NORMALIZE border reads 0 outside of the map (the taps are
+ * dropped).
+ *
+ * @param IntensityMap& map : The map to read.
+ *
+ * @returns std::vector<double> : The grid (row-major).
+ */
+std::vector<double> Convolution::_load(IntensityMap &map)
+{
+    this->_width = map.width;
+    this->_height = map.height;
+    this->_fill = this->_border == NORMALIZE ? 0.00 : map.at(-1, -1);
+
+    size_t size = (size_t)map.width * (size_t)map.height;
+    if (map.values.size() == size)
+        return map.values;
+
+    std::vector<double> values(size);
+    for (int y = 0; y < map.height; y++)
+        for (int x = 0; x < map.width; x++)
+            values[(size_t)y * map.width + x] = map.at(x, y);
+
+    return values;
+}
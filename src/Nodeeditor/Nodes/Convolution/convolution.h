@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * Convolution
+ *
+ * Convolves intensity maps with separable kernels, a horizontal pass along the
+ * rows followed by a vertical pass down the columns. Box filters use running
+ * sums so their cost per pixel does not grow with the radius, and gaussian
+ * filters with a large spread are made from three box passes. Every pass
+ * works on contiguous rows (tap by tap over a padded row, or row by row for
+ * the vertical pass) and the rows are split between threads. The inner loops
+ * are plain streams over rows, GCC vectorizes them at -O3 (at -O2 its cost
+ * model skips loops that need a check that the rows do not overlap). Large
+ * kernels are multiplied in the frequency domain instead, so their cost does
+ * not depend on the kernel size.
+ */
+class Convolution
+{
+public:
+    // How pixels outside of the map are read
+    enum Border
+    {
+        CLAMP, // The nearest edge pixel
+        MIRROR, // Reflected about the edge pixel
+        WRAP, // The opposite side of the map (tiling)
+        FILL, // The fill value of the map
+        NORMALIZE // Ignored, the kernel is rescaled over the map pixels
+    };
+
+    // Create the convolution with a border mode
+    Convolution(Border border = NORMALIZE);
+
+    // Convolve with a horizontal and a vertical kernel (odd length, centered)
+    IntensityMap separable(IntensityMap map,
+                           std::vector<double> const &kernel_x,
+                           std::vector<double> const &kernel_y);
+
+    // Convolve with a 2D kernel (odd width and height) in the frequency domain
+    IntensityMap spectral(IntensityMap map, IntensityMap kernel);
+
+    // Convolve with a small 2D kernel (odd width and height) tap by tap
+    IntensityMap direct(IntensityMap map, IntensityMap kernel);
+
+    // Average over a (2 * radius + 1) square, repeated a number of passes
+    IntensityMap box(IntensityMap map, int radius, int passes = 1);
+
+    // Gaussian blur with a standard deviation of sigma pixels
+    IntensityMap gaussian(IntensityMap map, double sigma);
+
+    // Sampled gaussian kernel (normalized, covers 3 sigma)
+    static std::vector<double> gaussianKernel(double sigma);
+
+    // Radii of the three box passes that approximate a gaussian
+    static std::vector<int> gaussianBoxes(double sigma);
+
+    // Separable kernels with more taps (both kernels) use the spectral path
+    static const int SPECTRAL_TAPS = 128;
+
+private:
+    // Single passes over the grid, in to out (same size)
+    void _kernelRows(std::vector<double> const &in,
+                     std::vector<double> *out,
+                     std::vector<double> const &kernel);
+    void _kernelColumns(std::vector<double> const &in,
+                        std::vector<double> *out,
+                        std::vector<double> const &kernel);
+    void _boxRows(std::vector<double> const &in,
+                  std::vector<double> *out,
+                  int radius);
+    void _boxColumns(std::vector<double> const &in,
+                     std::vector<double> *out,
+                     int radius);
+
+    // Scale for each position so the taps within the map weigh as the kernel
+    std::vector<double> _normalize(int size,
+                                   std::vector<double> const &kernel);
+
+    // The pixel read for position i on a line of size pixels, -1 is outside
+    int _sample(int i, int size) const;
+
+    // Read the map into a grid
+    std::vector<double> _load(IntensityMap &map);
+
+    Border _border;
+
+    int _width = 0;
+    int _height = 0;
+    double _fill = 0.00;
+};
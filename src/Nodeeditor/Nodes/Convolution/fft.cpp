@@ -0,0 +1,379 @@
+#include "fft.h"
+
+#include <math.h>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+/**
+ * FFT
+ *
+ * Plans the row and column transforms for a map size.
+ *
+ * @param int width : The width of the maps.
+ * @param int height : The height of the maps.
+ */
+FFT::FFT(int width, int height)
+    : _width(width),
+      _height(height),
+      _row_forward(width, false),
+      _row_inverse(width, true),
+      _column_forward(height, false),
+      _column_inverse(height, true)
+{
+    Q_ASSERT(width > 0);
+    Q_ASSERT(height > 0);
+}
+
+/**
+ * forward
+ *
+ * Transforms a map into its spectrum. Every row is transformed and its non
+ * negative frequencies kept, then every kept column is transformed.
+ *
+ * @param IntensityMap map : The map to transform, the size of the plan.
+ *
+ * @returns std::vector<Complex> : The spectrum, frequency (kx, ky) is at
+ *                                 ky * spectrumWidth() + kx.
+ */
+std::vector<FFT::Complex> FFT::forward(IntensityMap map)
+{
+    Q_ASSERT(map.width == this->_width);
+    Q_ASSERT(map.height == this->_height);
+
+    int width = this->_width;
+    int height = this->_height;
+    int half = this->spectrumWidth();
+    std::vector<Complex> spectrum((size_t)half * height);
+
+    bool full = map.values.size() == (size_t)width * (size_t)height;
+
+    parallelRows(height, [&](int start, int end) {
+        std::vector<Complex> line(width);
+        std::vector<Complex> result(width);
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+                line[x] = full ? map.values[(size_t)y * width + x]
+                               : map.at(x, y);
+
+            this->_row_forward.run(line.data(), result.data());
+            std::copy(result.begin(),
+                      result.begin() + half,
+                      spectrum.begin() + (size_t)y * half);
+        }
+    });
+
+    // Columns split between threads like rows
+    parallelRows(half, [&](int start, int end) {
+        std::vector<Complex> line(height);
+        std::vector<Complex> result(height);
+        for (int x = start; x < end; x++)
+        {
+            for (int y = 0; y < height; y++)
+                line[y] = spectrum[(size_t)y * half + x];
+
+            this->_column_forward.run(line.data(), result.data());
+
+            for (int y = 0; y < height; y++)
+                spectrum[(size_t)y * half + x] = result[y];
+        }
+    });
+
+    return spectrum;
+}
+
+/**
+ * inverse
+ *
+ * Transforms a spectrum back into a map. Every column is transformed back,
+ * then each row is completed with the conjugates of its frequencies and
+ * transformed back. The result is scaled so inverse(forward(map)) is map.
+ *
+ * @param std::vector<Complex> spectrum : The spectrum (spectrumWidth() x
+ *                                        height).
+ *
+ * @returns IntensityMap : The map.
+ */
+IntensityMap FFT::inverse(std::vector<Complex> spectrum)
+{
+    int width = this->_width;
+    int height = this->_height;
+    int half = this->spectrumWidth();
+    Q_ASSERT(spectrum.size() == (size_t)half * height);
+
+    parallelRows(half, [&](int start, int end) {
+        std::vector<Complex> line(height);
+        std::vector<Complex> result(height);
+        for (int x = start; x < end; x++)
+        {
+            for (int y = 0; y < height; y++)
+                line[y] = spectrum[(size_t)y * half + x];
+
+            this->_column_inverse.run(line.data(), result.data());
+
+            for (int y = 0; y < height; y++)
+                spectrum[(size_t)y * half + x] = result[y];
+        }
+    });
+
+    std::vector<double> values((size_t)width * height);
+    double scale = 1.00 / ((double)width * (double)height);
+
+    parallelRows(height, [&](int start, int end) {
+        std::vector<Complex> line(width);
+        std::vector<Complex> result(width);
+        for (int y = start; y < end; y++)
+        {
+            Complex const *row = spectrum.data() + (size_t)y * half;
+            for (int x = 0; x < half; x++)
+                line[x] = row[x];
+            for (int x = half; x < width; x++)
+                line[x] = std::conj(row[width - x]);
+
+            this->_row_inverse.run(line.data(), result.data());
+
+            for (int x = 0; x < width; x++)
+                values[(size_t)y * width + x] = result[x].real() * scale;
+        }
+    });
+
+    return IntensityMap(width, height, values);
+}
+
+/**
+ * spectrumWidth
+ *
+ * The number of horizontal frequencies kept in the spectrum.
+ *
+ * @returns int : width / 2 + 1
+ */
+int FFT::spectrumWidth() const
+{
+    return this->_width / 2 + 1;
+}
+
+/**
+ * fastSize
+ *
+ * Finds the smallest size that is at least n and only has the factors 2, 3
+ * and 5, these sizes transform fastest. Used for padding.
+ *
+ * @param int n : The minimum size.
+ *
+ * @returns int : The size.
+ */
+int FFT::fastSize(int n)
+{
+    for (int size = qMax(n, 1);; size++)
+    {
+        int m = size;
+        for (int factor : {2, 3, 5})
+            while (m % factor == 0)
+                m /= factor;
+
+        if (m == 1)
+            return size;
+    }
+}
+
+/******************************************************************************
+ *                                  PLAN                                      *
+ ******************************************************************************/
+
+/**
+ * Plan
+ *
+ * Factors the size (4s, then 2s, then odd factors) and computes the twiddle
+ * factors.
+ *
+ * @param int size : The number of values in the line.
+ * @param bool inverse : Whether this is the inverse (unscaled) transform.
+ */
+FFT::Plan::Plan(int size, bool inverse) : _size(size), _inverse(inverse)
+{
+    double sign = inverse ? 1.00 : -1.00;
+    this->_twiddles.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        double phase = sign * 2.00 * M_PI * i / size;
+        this->_twiddles[i] = Complex(cos(phase), sin(phase));
+    }
+
+    int n = size;
+    int p = 4;
+    while (n > 1)
+    {
+        while (n % p != 0)
+        {
+            if (p == 4)
+                p = 2;
+            else if (p == 2)
+                p = 3;
+            else
+                p += 2;
+
+            // No factor below the square root, what is left is prime
+            if ((long long)p * p > n)
+                p = n;
+        }
+        n /= p;
+        this->_factors.push_back(std::make_pair(p, n));
+    }
+}
+
+/**
+ * run
+ *
+ * Transforms a line.
+ *
+ * @param Complex const* in : The values (size of the plan).
+ * @param Complex* out : The transformed values (size of the plan), must not
+ *                       be the same as in.
+ */
+void FFT::Plan::run(Complex const *in, Complex *out) const
+{
+    Q_ASSERT(in != out);
+    if (this->_size == 1)
+    {
+        out[0] = in[0];
+        return;
+    }
+    this->_work(out, in, 1, 0);
+}
+
+/**
+ * _work
+ *
+ * Decimation in time, the input is split into p interleaved lines that are
+ * transformed recursively into consecutive blocks of the output, then the
+ * blocks are combined with a butterfly.
+ *
+ * @param Complex* out : Where to write the m * p transformed values.
+ * @param Complex const* in : The first input value.
+ * @param int stride : The distance between the input values.
+ * @param int factor : The stage (index into the factors).
+ */
+void FFT::Plan::_work(Complex *out,
+                      Complex const *in,
+                      int stride,
+                      int factor) const
+{
+    int p = this->_factors[factor].first;
+    int m = this->_factors[factor].second;
+
+    if (m == 1)
+    {
+        for (int k = 0; k < p; k++)
+            out[k] = in[k * stride];
+    }
+    else
+    {
+        for (int k = 0; k < p; k++)
+            this->_work(out + k * m, in + k * stride, stride * p, factor + 1);
+    }
+
+    switch (p)
+    {
+    case 2:
+        this->_butterfly2(out, stride, m);
+        break;
+    case 4:
+        this->_butterfly4(out, stride, m);
+        break;
+    default:
+        this->_butterfly(out, stride, m, p);
+        break;
+    }
+}
+
+/**
+ * _butterfly2
+ *
+ * Combines two blocks of m transformed values.
+ *
+ * @param Complex* out : The blocks, combined in place.
+ * @param int stride : The twiddle step.
+ * @param int m : The size of each block.
+ */
+void FFT::Plan::_butterfly2(Complex *out, int stride, int m) const
+{
+    Complex *second = out + m;
+    for (int k = 0; k < m; k++)
+    {
+        Complex t = second[k] * this->_twiddles[k * stride];
+        second[k] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+/**
+ * _butterfly4
+ *
+ * Combines four blocks of m transformed values.
+ *
+ * @param Complex* out : The blocks, combined in place.
+ * @param int stride : The twiddle step.
+ * @param int m : The size of each block.
+ */
+void FFT::Plan::_butterfly4(Complex *out, int stride, int m) const
+{
+    Complex const *twiddles = this->_twiddles.data();
+    for (int k = 0; k < m; k++)
+    {
+        Complex s_0 = out[k + m] * twiddles[k * stride];
+        Complex s_1 = out[k + 2 * m] * twiddles[2 * k * stride];
+        Complex s_2 = out[k + 3 * m] * twiddles[3 * k * stride];
+
+        Complex s_5 = out[k] - s_1;
+        out[k] += s_1;
+        Complex s_3 = s_0 + s_2;
+        Complex s_4 = s_0 - s_2;
+
+        out[k + 2 * m] = out[k] - s_3;
+        out[k] += s_3;
+
+        // Multiply s_4 by -i (forward) or i (inverse)
+        Complex turned = this->_inverse ? Complex(-s_4.imag(), s_4.real())
+                                        : Complex(s_4.imag(), -s_4.real());
+        out[k + m] = s_5 + turned;
+        out[k + 3 * m] = s_5 - turned;
+    }
+}
+
+/**
+ * _butterfly
+ *
+ * Combines p blocks of m transformed values for any factor p, a direct
+ * transform of size p over every set of matching values.
+ *
+ * @param Complex* out : The blocks, combined in place.
+ * @param int stride : The twiddle step.
+ * @param int m : The size of each block.
+ * @param int p : The number of blocks.
+ */
+void FFT::Plan::_butterfly(Complex *out, int stride, int m, int p) const
+{
+    std::vector<Complex> scratch(p);
+    for (int u = 0; u < m; u++)
+    {
+        for (int q = 0; q < p; q++)
+            scratch[q] = out[u + q * m];
+
+        for (int q_1 = 0; q_1 < p; q_1++)
+        {
+            int k = u + q_1 * m;
+            int twiddle = 0;
+            Complex sum = scratch[0];
+            for (int q = 1; q < p; q++)
+            {
+                twiddle += stride * k;
+                if (twiddle >= this->_size)
+                    twiddle %= this->_size;
+                sum += scratch[q] * this->_twiddles[twiddle];
+            }
+            out[k] = sum;
+        }
+    }
+}
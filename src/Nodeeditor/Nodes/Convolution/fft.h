@@ -0,0 +1,78 @@
+#pragma once
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * FFT
+ *
+ * Fast fourier transforms of real intensity maps of any size. Each line is
+ * transformed with a mixed radix (4, 2, 3, 5, ...) Cooley-Tukey plan, the rows
+ * first then the columns, and the lines are split between threads. As the map
+ * is real only the non negative horizontal frequencies are kept (the others
+ * are their conjugates), which halves the column transforms.
+ */
+class FFT
+{
+public:
+    typedef std::complex<double> Complex;
+
+    // Plan the transforms for a map size
+    FFT(int width, int height);
+
+    // Transform a map, the spectrum is spectrumWidth() x height (row-major)
+    std::vector<Complex> forward(IntensityMap map);
+
+    // Transform a spectrum back into a map
+    IntensityMap inverse(std::vector<Complex> spectrum);
+
+    // Number of horizontal frequencies kept in the spectrum (width / 2 + 1)
+    int spectrumWidth() const;
+
+    // Smallest size that is at least n and only has the factors 2, 3 and 5
+    static int fastSize(int n);
+
+private:
+    /**
+     * Plan
+     *
+     * The factors and twiddles to transform a single line of a size. The
+     * inverse is not scaled.
+     */
+    class Plan
+    {
+    public:
+        Plan(int size, bool inverse);
+
+        // Transform in (contiguous) into out (contiguous)
+        void run(Complex const *in, Complex *out) const;
+
+    private:
+        void _work(Complex *out,
+                   Complex const *in,
+                   int stride,
+                   int factor) const;
+
+        void _butterfly2(Complex *out, int stride, int m) const;
+        void _butterfly4(Complex *out, int stride, int m) const;
+        void _butterfly(Complex *out, int stride, int m, int p) const;
+
+        int _size;
+        bool _inverse;
+
+        // (radix, remaining size) for every stage
+        std::vector<std::pair<int, int>> _factors;
+        std::vector<Complex> _twiddles;
+    };
+
+    int _width;
+    int _height;
+
+    Plan _row_forward;
+    Plan _row_inverse;
+    Plan _column_forward;
+    Plan _column_inverse;
+};
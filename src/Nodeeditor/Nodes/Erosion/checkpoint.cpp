@@ -0,0 +1,391 @@
+#include "checkpoint.h"
+
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+// Identifies checkpoint files and their layout
+static const quint32 MAGIC = 0x54474543; // TGEC
+static const quint32 VERSION = 2;
+
+/**
+ * writeMap
+ *
+ * Writes a map into a stream, a fill map as its value and any other map as
+ * every pixel (row by row).
+ *
+ * @param QDataStream& stream : The stream to write to.
+ * @param IntensityMap& map : The map to write.
+ */
+static void writeMap(QDataStream &stream, IntensityMap &map)
+{
+    bool fill = map.usingFill();
+    stream << (quint8)fill;
+    if (fill)
+    {
+        stream << map.at(0, 0);
+        return;
+    }
+
+    std::vector<double> row(map.width);
+    for (int y = 0; y < map.height; y++)
+    {
+        for (int x = 0; x < map.width; x++)
+            row[x] = map.at(x, y);
+
+        stream.writeRawData((char const *)row.data(),
+                            (int)(row.size() * sizeof(double)));
+    }
+}
+
+/**
+ * readMap
+ *
+ * Reads a map written by writeMap.
+ *
+ * @param QDataStream& stream : The stream to read from.
+ * @param int width : The width of the map.
+ * @param int height : The height of the map.
+ * @param IntensityMap* map : Receives the map.
+ *
+ * @returns bool : Whether the whole map was read.
+ */
+static bool readMap(QDataStream &stream,
+                    int width,
+                    int height,
+                    IntensityMap *map)
+{
+    quint8 fill = 0;
+    stream >> fill;
+    if (fill)
+    {
+        double value = 0.00;
+        stream >> value;
+        *map = IntensityMap(width, height, value);
+        return stream.status() == QDataStream::Ok;
+    }
+
+    std::vector<double> values((size_t)width * (size_t)height);
+    int bytes = (int)(width * sizeof(double));
+    for (int y = 0; y < height; y++)
+    {
+        char *row = (char *)&values[(size_t)y * width];
+        if (stream.readRawData(row, bytes) != bytes)
+            return false;
+    }
+
+    *map = IntensityMap(width, height, values);
+    return stream.status() == QDataStream::Ok;
+}
+
+/**
+ * ErosionCheckpoint
+ *
+ * Creates an empty checkpoint, not valid for any simulation.
+ */
+ErosionCheckpoint::ErosionCheckpoint()
+{
+}
+
+/**
+ * ErosionCheckpoint
+ *
+ * Creates the checkpoint at the start of a simulation, no droplets simulated.
+ *
+ * @param QByteArray key : The key of the simulation (see createKey).
+ * @param IntensityMap height : The input height map.
+ */
+ErosionCheckpoint::ErosionCheckpoint(QByteArray key, IntensityMap height)
+    : key(key),
+      height(height),
+      sediment(height.width, height.height, 0.00),
+      erosion(height.width, height.height, 0.00)
+{
+}
+
+/**
+ * createKey
+ *
+ * Creates a key from the input map and the settings of a simulation, when
+ * either changes the simulation has to start over. The settings should hold
+ * everything that changes the result except the number of droplets.
+ *
+ * @param IntensityMap& input : The input height map.
+ * @param QJsonObject const& settings : The simulation settings.
+ *
+ * @returns QByteArray : The key (hex).
+ */
+QByteArray ErosionCheckpoint::createKey(IntensityMap &input,
+                                        QJsonObject const &settings)
+{
+    return ErosionCheckpoint::createKey(ErosionCheckpoint::hashMap(input),
+                                        settings);
+}
+
+/**
+ * createKey
+ *
+ * Creates a key from the hash of the input map (see hashMap) and the settings
+ * of a simulation. Hashing a large map takes a while, callers that simulate
+ * the same input with different settings can keep the hash.
+ *
+ * @param QByteArray input : The hash of the input height map.
+ * @param QJsonObject const& settings : The simulation settings.
+ *
+ * @returns QByteArray : The key (hex).
+ */
+QByteArray ErosionCheckpoint::createKey(QByteArray input,
+                                        QJsonObject const &settings)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(QJsonDocument(settings).toJson(QJsonDocument::Compact));
+    hash.addData(input);
+
+    return hash.result().toHex();
+}
+
+/**
+ * hashMap
+ *
+ * Hashes the size and every pixel of a map.
+ *
+ * @param IntensityMap& map : The map to hash.
+ *
+ * @returns QByteArray : The hash.
+ */
+QByteArray ErosionCheckpoint::hashMap(IntensityMap &map)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    qint32 size[2] = {map.width, map.height};
+    hash.addData((char const *)size, (int)sizeof(size));
+
+    std::vector<double> row(map.width);
+    for (int y = 0; y < map.height; y++)
+    {
+        for (int x = 0; x < map.width; x++)
+            row[x] = map.at(x, y);
+
+        hash.addData((char const *)row.data(),
+                     (int)(row.size() * sizeof(double)));
+    }
+
+    return hash.result();
+}
+
+/**
+ * chunkSeed
+ *
+ * The seed used for a chunk of droplets. The first chunk uses the seed as is.
+ *
+ * @param unsigned int seed : The seed of the simulation.
+ * @param int chunk : The chunk.
+ *
+ * @returns unsigned int : The seed of the chunk.
+ */
+unsigned int ErosionCheckpoint::chunkSeed(unsigned int seed, int chunk)
+{
+    return seed ^ ((unsigned int)chunk * 2654435761u);
+}
+
+/**
+ * path
+ *
+ * The file of the checkpoint of a simulation in a cache directory.
+ *
+ * @param QDir dir : The cache directory.
+ * @param QByteArray key : The key of the simulation (see createKey).
+ *
+ * @returns QString : The absolute path of the checkpoint file.
+ */
+QString ErosionCheckpoint::path(QDir dir, QByteArray key)
+{
+    return dir.absoluteFilePath(
+        QString("erosion_%1.checkpoint").arg(QString(key)));
+}
+
+/**
+ * prune
+ *
+ * Deletes checkpoint files from a directory, oldest first, until the files
+ * left take no more than the limit. Checkpoints of simulations that were
+ * interrupted and never continued would otherwise fill the directory.
+ *
+ * @param QDir dir : The cache directory.
+ * @param qint64 limit : The bytes the checkpoint files may take.
+ * @param QString keep : A checkpoint file that is not deleted.
+ */
+void ErosionCheckpoint::prune(QDir dir, qint64 limit, QString keep)
+{
+    QFileInfoList files =
+        dir.entryInfoList(QStringList{"erosion_*.checkpoint"},
+                          QDir::Files,
+                          QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (QFileInfo const &file : files)
+        total += file.size();
+
+    for (QFileInfo const &file : files)
+    {
+        if (total <= limit)
+            break;
+
+        if (file.absoluteFilePath() == QFileInfo(keep).absoluteFilePath())
+            continue;
+
+        qint64 size = file.size();
+        if (QFile::remove(file.absoluteFilePath()))
+            total -= size;
+    }
+}
+
+/**
+ * advance
+ *
+ * Simulates whole chunks of droplets until the checkpoint is after the
+ * chunks. Every chunk is simulated the same way whether the chunks are
+ * simulated at once, continued from this checkpoint later or from the
+ * checkpoint saved to disk, so the result is the same.
+ *
+ * @param int chunks : The chunks simulated when done.
+ * @param bool sediment : Whether to track the sediment map.
+ * @param bool erosion : Whether to track the erosion map.
+ * @param Simulate const& simulate : Simulates a chunk of droplets.
+ * @param Snapshot const& snapshot : Saves the checkpoint, may be nullptr.
+ * @param qint64 interval : Milliseconds between snapshots.
+ */
+void ErosionCheckpoint::advance(int chunks,
+                                bool sediment,
+                                bool erosion,
+                                Simulate const &simulate,
+                                Snapshot const &snapshot,
+                                qint64 interval)
+{
+    Q_ASSERT(this->valid());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (this->chunks < chunks)
+    {
+        simulate(&this->height,
+                 sediment ? &this->sediment : nullptr,
+                 erosion ? &this->erosion : nullptr,
+                 this->chunks);
+
+        this->chunks++;
+
+        if (snapshot && this->chunks < chunks && timer.elapsed() >= interval)
+        {
+            snapshot();
+            timer.restart();
+        }
+    }
+}
+
+/**
+ * save
+ *
+ * Saves the checkpoint to a file. The file is replaced only once it is
+ * completely written, so an interrupted save keeps the previous checkpoint.
+ *
+ * @param QString path : The file to save to.
+ *
+ * @returns bool : Whether the checkpoint was saved.
+ */
+bool ErosionCheckpoint::save(QString path)
+{
+    Q_ASSERT(this->valid());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Unable to save erosion checkpoint '%s'", qPrintable(path));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << MAGIC << VERSION << this->key << (qint32)this->chunks
+           << (qint32)this->height.width << (qint32)this->height.height;
+
+    writeMap(stream, this->height);
+    writeMap(stream, this->sediment);
+    writeMap(stream, this->erosion);
+
+    return file.commit();
+}
+
+/**
+ * load
+ *
+ * Loads a checkpoint from a file if the file exists and belongs to the
+ * simulation with the key.
+ *
+ * @param QString path : The file to load from.
+ * @param QByteArray key : The key of the simulation (see createKey).
+ *
+ * @returns bool : Whether the checkpoint was loaded.
+ */
+bool ErosionCheckpoint::load(QString path, QByteArray key)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray file_key;
+    qint32 chunks = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    stream >> magic >> version >> file_key >> chunks >> width >> height;
+
+    if (stream.status() != QDataStream::Ok
+        || magic != MAGIC
+        || version != VERSION
+        || file_key != key
+        || chunks < 0
+        || width <= 0
+        || height <= 0)
+        return false;
+
+    IntensityMap maps[3];
+    for (int i = 0; i < 3; i++)
+        if (!readMap(stream, width, height, &maps[i]))
+            return false;
+
+    this->key = key;
+    this->chunks = chunks;
+    this->height = maps[0];
+    this->sediment = maps[1];
+    this->erosion = maps[2];
+
+    qDebug("Loaded erosion checkpoint '%s' (%d droplets)",
+           qPrintable(path),
+           chunks * ErosionCheckpoint::CHUNK);
+
+    return true;
+}
+
+/**
+ * valid
+ *
+ * Checks if the checkpoint belongs to a simulation.
+ *
+ * @returns bool : True when the checkpoint has a key.
+ */
+bool ErosionCheckpoint::valid() const
+{
+    return !this->key.isEmpty();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <functional>
+
+#include <QByteArray>
+#include <QDir>
+#include <QJsonObject>
+#include <QString>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * ErosionCheckpoint
+ *
+ * The state of a droplet erosion simulation after a number of whole chunks of
+ * droplets. Every chunk uses its own seed, so a simulation can be continued
+ * from a checkpoint (more droplets) and gives the same result as simulating
+ * every droplet at once. Checkpoints can be saved to disk so a long simulation
+ * that was interrupted can be resumed. Maps that are not tracked stay fill
+ * maps, they take no memory and are saved as a single value.
+ */
+class ErosionCheckpoint
+{
+public:
+    // Droplets simulated in each chunk
+    static const int CHUNK = 25000;
+
+    // Bytes of checkpoint files kept in a cache directory
+    static const qint64 CACHE_LIMIT = 4LL << 30;
+
+    // Simulates the droplets of a chunk, the sediment and erosion maps are
+    // nullptr when they are not tracked
+    typedef std::function<void(IntensityMap *height,
+                               IntensityMap *sediment,
+                               IntensityMap *erosion,
+                               int chunk)>
+        Simulate;
+
+    // Called between chunks to save the checkpoint
+    typedef std::function<void()> Snapshot;
+
+    // Create an empty (invalid) checkpoint
+    ErosionCheckpoint();
+
+    // Create a checkpoint at the start of a simulation
+    ErosionCheckpoint(QByteArray key, IntensityMap height);
+
+    // Key identifying the input map and the simulation settings
+    static QByteArray createKey(IntensityMap &input,
+                                QJsonObject const &settings);
+    static QByteArray createKey(QByteArray input, QJsonObject const &settings);
+
+    // Hash of the size and pixels of a map, for createKey
+    static QByteArray hashMap(IntensityMap &map);
+
+    // Seed used by a chunk of droplets
+    static unsigned int chunkSeed(unsigned int seed, int chunk);
+
+    // File of the checkpoint of a simulation in a cache directory
+    static QString path(QDir dir, QByteArray key);
+
+    // Delete the oldest checkpoint files of a directory (other than keep)
+    // until the files left take no more than limit bytes
+    static void prune(QDir dir, qint64 limit, QString keep = QString());
+
+    // Simulate whole chunks until chunks are simulated, calling snapshot
+    // every interval milliseconds
+    void advance(int chunks,
+                 bool sediment,
+                 bool erosion,
+                 Simulate const &simulate,
+                 Snapshot const &snapshot = nullptr,
+                 qint64 interval = 0);
+
+    // Save to or load from a checkpoint file (bool whether successful)
+    bool save(QString path);
+    bool load(QString path, QByteArray key);
+
+    // Whether the checkpoint belongs to a simulation
+    bool valid() const;
+
+    QByteArray key;
+    int chunks = 0; // Whole chunks simulated
+    IntensityMap height;
+    IntensityMap sediment;
+    IntensityMap erosion;
+};
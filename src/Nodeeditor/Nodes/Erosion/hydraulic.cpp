@@ -0,0 +1,1051 @@
+#include "hydraulic.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+// Droplets spawned per tile in each round of the tiled simulation
+static const int ROUND_DROPLETS = 32;
+
+// Distance (pixels) a droplet may step outside of its tile
+static const int TILE_HALO = 8;
+
+// Each finer multigrid level simulates this fraction of the previous droplets
+static const int REFINE_DIVISOR = 4;
+
+/**
+ * mix
+ *
+ * Interpolates a value between a range using a percentage value.
+ *
+ * @param double x : The start value.
+ * @param double y : The end value.
+ * @param double a : The percentage value between x and y.
+ *
+ * @returns double : The interpolated value.
+ */
+static double mix(double x, double y, double a)
+{
+    return x * (1.00 - a) + y * a;
+}
+
+/**
+ * biLinearMix
+ *
+ * Bilinear interpolation between four values and two percentages. Applies
+ * mix(a, b, x), mix(c, d, x) and then mixes the result with y. See above mix
+ * function. Used for interpolating a value in between four pixels.
+ *
+ * @param double a : The first value to use (a - b).
+ * @param double b : The second value to use (a - b).
+ * @param double c : The third value to use (c - d).
+ * @param double d : The fourth value to use (c - d).
+ * @param double x : The interpolation percentage for (a - b) and (c - d).
+ * @param double y : The interpolation percentage for the result from
+ *                   interpolating (a - b) and (c - d).
+ *
+ * @returns double : The resulting interpolated value.
+ */
+static double biLinearMix(double a,
+                          double b,
+                          double c,
+                          double d,
+                          double x,
+                          double y)
+{
+    return mix(mix(a, b, x), mix(c, d, x), y);
+}
+
+/**
+ * materialize
+ *
+ * Makes sure every pixel of a map is stored in its values. Solid fill maps and
+ * partially filled maps grow their values on the first set, which is not safe
+ * when several threads set pixels at the same time.
+ *
+ * @param IntensityMap *map : The map to fill out.
+ */
+static void materialize(IntensityMap *map)
+{
+    if (!map)
+        return;
+
+    int x = map->width - 1;
+    int y = map->height - 1;
+    map->set(x, y, map->at(x, y));
+}
+
+/**
+ * downsample
+ *
+ * Shrinks a map by averaging the pixels that fall into each new pixel.
+ *
+ * @param IntensityMap& map : The map to shrink.
+ * @param int width : The new width (at most the map width).
+ * @param int height : The new height (at most the map height).
+ *
+ * @returns IntensityMap : The shrunk map.
+ */
+static IntensityMap downsample(IntensityMap &map, int width, int height)
+{
+    materialize(&map);
+    std::vector<double> values((size_t)width * (size_t)height);
+
+    parallelRows(height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            int y_0 = (int)((long long)y * map.height / height);
+            int y_1 = (int)((long long)(y + 1) * map.height / height);
+            y_1 = std::max(y_0 + 1, y_1);
+
+            for (int x = 0; x < width; x++)
+            {
+                int x_0 = (int)((long long)x * map.width / width);
+                int x_1 = (int)((long long)(x + 1) * map.width / width);
+                x_1 = std::max(x_0 + 1, x_1);
+
+                double sum = 0.00;
+                for (int sy = y_0; sy < y_1; sy++)
+                    for (int sx = x_0; sx < x_1; sx++)
+                        sum += map.values[sy * map.width + sx];
+
+                values[y * width + x] = sum / ((x_1 - x_0) * (y_1 - y_0));
+            }
+        }
+    });
+
+    return IntensityMap(width, height, values);
+}
+
+/**
+ * upsample
+ *
+ * Grows a map with bilinear interpolation between the pixel centres.
+ *
+ * @param IntensityMap& map : The map to grow.
+ * @param int width : The new width (at least the map width).
+ * @param int height : The new height (at least the map height).
+ *
+ * @returns IntensityMap : The grown map.
+ */
+static IntensityMap upsample(IntensityMap &map, int width, int height)
+{
+    materialize(&map);
+    std::vector<double> values((size_t)width * (size_t)height);
+
+    double scale_x = (double)map.width / (double)width;
+    double scale_y = (double)map.height / (double)height;
+
+    parallelRows(height, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            double sy = std::max(0.00, (y + 0.50) * scale_y - 0.50);
+            int y_0 = std::min(map.height - 1, (int)sy);
+            int y_1 = std::min(map.height - 1, y_0 + 1);
+            double yp = sy - y_0;
+
+            for (int x = 0; x < width; x++)
+            {
+                double sx = std::max(0.00, (x + 0.50) * scale_x - 0.50);
+                int x_0 = std::min(map.width - 1, (int)sx);
+                int x_1 = std::min(map.width - 1, x_0 + 1);
+                double xp = sx - x_0;
+
+                values[y * width + x] =
+                    biLinearMix(map.values[y_0 * map.width + x_0],
+                                map.values[y_0 * map.width + x_1],
+                                map.values[y_1 * map.width + x_0],
+                                map.values[y_1 * map.width + x_1],
+                                xp, yp);
+            }
+        }
+    });
+
+    return IntensityMap(width, height, values);
+}
+
+/**
+ * HydraulicErosion
+ *
+ * Creates the simulation.
+ *
+ * @param DropletParameters parameters : The simulation constants.
+ */
+HydraulicErosion::HydraulicErosion(DropletParameters parameters)
+    : _parameters(parameters)
+{
+    double radius = this->_parameters.erosion_radius;
+
+    // Erosion radius distance, for rounding erosion distance from point
+    double r = sqrt(2.00 * radius * radius);
+
+    // Erosion brush, pixels in a radius from the position weakening the
+    // farther away from the point
+    for (double x = -radius; x <= radius; x += 1.00)
+    {
+        for (double y = -radius; y <= radius; y += 1.00)
+        {
+            double weight = (r - sqrt(x * x + y * y)) / r;
+            this->_brush.push_back(BrushTap{x, y, weight});
+            this->_brush_reach = std::max(this->_brush_reach,
+                                          std::max(fabs(x), fabs(y)));
+        }
+    }
+
+    // Simple smoothing kernel
+    double strength = this->_parameters.smooth_strength;
+    double kernel[3][3] = {
+        {1.00, 4.00, 1.00},
+        {4.00, strength + 20.00, 4.00},
+        {1.00, 4.00, 1.00}};
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            this->_kernel[i][j] = kernel[i][j];
+
+    // Averaging value
+    this->_kernel_sum = strength + 40.00;
+}
+
+/**
+ * Grid::at
+ *
+ * Get the value of a pixel, pixels outside of the map are the fill like
+ * IntensityMap::at.
+ *
+ * @param int x : The x pixel.
+ * @param int y : The y pixel.
+ *
+ * @returns double : The value.
+ */
+double HydraulicErosion::Grid::at(int x, int y) const
+{
+    if (x < 0 || x >= this->width || y < 0 || y >= this->height)
+        return this->fill;
+    return this->values[y * this->width + x];
+}
+
+/**
+ * Grid::clamped
+ *
+ * Get the value of a pixel, pixels outside of the map are clamped to the edge.
+ *
+ * @param int x : The x pixel.
+ * @param int y : The y pixel.
+ *
+ * @returns double : The value.
+ */
+double HydraulicErosion::Grid::clamped(int x, int y) const
+{
+    x = std::max(0, std::min(this->width - 1, x));
+    y = std::max(0, std::min(this->height - 1, y));
+    return this->values[y * this->width + x];
+}
+
+/**
+ * Grid::sample
+ *
+ * Get the height at a position on the map. Uses bilinear interpolation to get
+ * the value for between pixels.
+ *
+ * @param double x : The x position to get.
+ * @param double y : The y position to get.
+ *
+ * @returns double : The interpolated height
+ */
+double HydraulicErosion::Grid::sample(double x, double y) const
+{
+    int x_0 = (int)floor(x);
+    int y_0 = (int)floor(y);
+
+    double xp = x - floor(x);
+    double yp = y - floor(y);
+
+    // Interior, no clamping needed
+    if (x_0 >= 0
+        && y_0 >= 0
+        && x_0 < this->width - 1
+        && y_0 < this->height - 1)
+    {
+        double const *row = this->values + y_0 * this->width + x_0;
+        return biLinearMix(row[0],
+                           row[1],
+                           row[this->width],
+                           row[this->width + 1],
+                           xp, yp);
+    }
+
+    return biLinearMix(this->clamped(x_0, y_0),
+                       this->clamped(x_0 + 1, y_0),
+                       this->clamped(x_0, y_0 + 1),
+                       this->clamped(x_0 + 1, y_0 + 1),
+                       xp, yp);
+}
+
+/**
+ * Grid::gradient
+ *
+ * Obtain the direction (x, y) of greatest descent, the -gradient. The value is
+ * calculated using linear interpolation to get appropriate heights between
+ * pixels.
+ *
+ * @param double x : The x position to get
+ * @param double y : The y position to get
+ *
+ * @returns glm::dvec2 : The direction of greatest descent
+ */
+glm::dvec2 HydraulicErosion::Grid::gradient(double x, double y) const
+{
+    int x_0 = (int)floor(x);
+    int y_0 = (int)floor(y);
+
+    double xp = x - floor(x);
+    double yp = y - floor(y);
+
+    // Interpolate left/right positions
+    double r = mix(this->at(x_0 + 1, y_0 - 1), this->at(x_0 + 1, y_0 + 1), yp);
+    double l = mix(this->at(x_0 - 1, y_0 - 1), this->at(x_0 - 1, y_0 + 1), yp);
+
+    // Interpolate top/bottom positions
+    double t = mix(this->at(x_0 - 1, y_0 + 1), this->at(x_0 - 1, y_0 + 1), xp);
+    double b = mix(this->at(x_0 - 1, y_0 - 1), this->at(x_0 - 1, y_0 - 1), xp);
+
+    // Get the descent
+    return glm::dvec2( 0.5 * (l - r), 0.5 * (t - b));
+}
+
+/**
+ * Grid::interpolateAdd
+ *
+ * Adds a value to the map using interpolation for values between pixels,
+ * pixels outside of the map are skipped.
+ *
+ * @param double x : The x position to affect.
+ * @param double y : The y position to affect.
+ * @param double v : The value to place into the map.
+ */
+void HydraulicErosion::Grid::interpolateAdd(double x, double y, double v)
+{
+    int x_0 = (int)floor(x);
+    int y_0 = (int)floor(y);
+
+    double xp = x - floor(x);
+    double yp = y - floor(y);
+    double xp_1 = 1.00 - xp;
+    double yp_1 = 1.00 - yp;
+
+    // Interior, all four pixels are in the map
+    if (x_0 >= 0
+        && y_0 >= 0
+        && x_0 < this->width - 1
+        && y_0 < this->height - 1)
+    {
+        double *row = this->values + y_0 * this->width + x_0;
+        row[0] += v * xp_1 * yp_1;
+        row[1] += v * xp * yp_1;
+        row[this->width] += v * xp_1 * yp;
+        row[this->width + 1] += v * xp * yp;
+        return;
+    }
+
+    double add[4] = {v * xp_1 * yp_1,
+                     v * xp * yp_1,
+                     v * xp_1 * yp,
+                     v * xp * yp};
+    for (int i = 0; i < 4; i++)
+    {
+        int px = x_0 + (i & 1);
+        int py = y_0 + (i >> 1);
+        if (px >= 0 && px < this->width && py >= 0 && py < this->height)
+            this->values[py * this->width + px] += add[i];
+    }
+}
+
+/**
+ * Grid::inside
+ *
+ * Checks if every pixel touched by interpolating within reach of a position is
+ * inside the map, so the position can be worked on without bounds checks.
+ *
+ * @param double x : The x position.
+ * @param double y : The y position.
+ * @param double reach : Distance from the position that will be touched.
+ *
+ * @returns bool : True when everything touched is inside the map.
+ */
+bool HydraulicErosion::Grid::inside(double x, double y, double reach) const
+{
+    return x - reach >= 0.00
+        && y - reach >= 0.00
+        && x + reach < (double)this->width - 1.00
+        && y + reach < (double)this->height - 1.00;
+}
+
+/**
+ * run
+ *
+ * Simulates the droplets one after another with random start positions over
+ * the whole map.
+ *
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ * @param int droplets : The number of droplets to simulate.
+ */
+void HydraulicErosion::run(IntensityMap *height,
+                           IntensityMap *sediment,
+                           IntensityMap *erosion,
+                           int droplets)
+{
+    Q_CHECK_PTR(height);
+    this->_attach(height, sediment, erosion);
+
+    // Generate a random distribution of rain drops
+    std::default_random_engine gen(this->_parameters.seed);
+
+    std::uniform_real_distribution<double>
+        distrib_x(0.00, (double)height->width - 1.00);
+
+    std::uniform_real_distribution<double>
+        distrib_y(0.00, (double)height->height - 1.00);
+
+    // Droplets only stop at the edges of the map
+    Bounds bounds{-HUGE_VAL, -HUGE_VAL, HUGE_VAL, HUGE_VAL};
+
+    // Generate droplets number of rain drops
+    for (int i = 0; i < droplets; i++)
+    {
+        // Random raindrop location
+        // TODO: Add a rainmap (intensity map) that affects water value
+        Droplet drop;
+        drop.pos_x = distrib_x(gen);
+        drop.pos_y = distrib_y(gen);
+
+        this->_droplet(drop, bounds);
+    }
+
+    this->_detach();
+}
+
+/**
+ * runMultigrid
+ *
+ * Simulates the droplets coarse to fine. The map is halved until it fits
+ * within the base size, the coarsest level is eroded with all of the droplets
+ * (so a map at the base size, such as the preview, looks the same as the tiled
+ * simulation). The change in height of each level is upsampled onto the next
+ * finer level of the original map, which is refined with a fraction of the
+ * droplets of the previous level. The large features are carved cheaply at low
+ * resolution while the finer levels add detail.
+ *
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ * @param int droplets : The number of droplets on the coarsest level.
+ * @param int base : The largest size of the coarsest level.
+ */
+void HydraulicErosion::runMultigrid(IntensityMap *height,
+                                    IntensityMap *sediment,
+                                    IntensityMap *erosion,
+                                    int droplets,
+                                    int base)
+{
+    Q_CHECK_PTR(height);
+    Q_ASSERT(base > 0);
+
+    // Level sizes from finest (the map) to coarsest
+    std::vector<std::pair<int, int>> sizes;
+    sizes.push_back({height->width, height->height});
+    while (std::max(sizes.back().first, sizes.back().second) > base)
+        sizes.push_back({(sizes.back().first + 1) / 2,
+                         (sizes.back().second + 1) / 2});
+    std::reverse(sizes.begin(), sizes.end());
+
+    IntensityMap original = *height;
+    IntensityMap level_original; // The original terrain at the level
+    IntensityMap level_height;
+    IntensityMap level_sediment;
+    IntensityMap level_erosion;
+
+    for (size_t level = 0; level < sizes.size(); level++)
+    {
+        int width = sizes[level].first;
+        int rows = sizes[level].second;
+        bool finest = level == sizes.size() - 1;
+
+        IntensityMap terrain = finest ? original
+                                      : downsample(original, width, rows);
+        materialize(&terrain);
+
+        if (level == 0)
+        {
+            level_height = terrain;
+            level_sediment = IntensityMap(width, rows, 0.00);
+            level_erosion = IntensityMap(width, rows, 0.00);
+        }
+        else
+        {
+            // Carry the change from the coarser level onto this level
+            for (size_t i = 0; i < level_height.values.size(); i++)
+                level_height.values[i] -= level_original.values[i];
+            level_height.invalidate();
+
+            IntensityMap change = upsample(level_height, width, rows);
+
+            level_height = terrain;
+            for (size_t i = 0; i < level_height.values.size(); i++)
+                level_height.values[i] += change.values[i];
+            level_height.invalidate();
+
+            level_sediment = upsample(level_sediment, width, rows);
+            level_erosion = upsample(level_erosion, width, rows);
+
+            droplets /= REFINE_DIVISOR;
+        }
+        level_original = terrain;
+
+        DropletParameters parameters = this->_parameters;
+        parameters.seed += (unsigned int)level;
+
+        HydraulicErosion simulation(parameters);
+        simulation.runTiled(&level_height,
+                            sediment ? &level_sediment : nullptr,
+                            erosion ? &level_erosion : nullptr,
+                            droplets);
+    }
+
+    *height = level_height;
+
+    if (sediment)
+    {
+        materialize(sediment);
+        for (size_t i = 0; i < sediment->values.size(); i++)
+            sediment->values[i] += level_sediment.values[i];
+        sediment->invalidate();
+    }
+
+    if (erosion)
+    {
+        materialize(erosion);
+        for (size_t i = 0; i < erosion->values.size(); i++)
+            erosion->values[i] += level_erosion.values[i];
+        erosion->invalidate();
+    }
+}
+
+/**
+ * _attach
+ *
+ * Stores the maps being simulated on. Every pixel of the maps is stored (see
+ * materialize) so the simulation can read and write their values directly.
+ *
+ * @param IntensityMap* height : The height map.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ */
+void HydraulicErosion::_attach(IntensityMap *height,
+                               IntensityMap *sediment,
+                               IntensityMap *erosion)
+{
+    IntensityMap *maps[3] = {height, sediment, erosion};
+    Grid *grids[3] = {&this->_height_grid,
+                      &this->_sediment_grid,
+                      &this->_erosion_grid};
+
+    for (int i = 0; i < 3; i++)
+    {
+        *grids[i] = Grid();
+        if (!maps[i])
+            continue;
+
+        materialize(maps[i]);
+        grids[i]->values = maps[i]->values.data();
+        grids[i]->width = maps[i]->width;
+        grids[i]->height = maps[i]->height;
+        grids[i]->fill = maps[i]->at(-1, -1);
+    }
+
+    this->_height = height;
+    this->_sediment = sediment;
+    this->_erosion = erosion;
+}
+
+/**
+ * _detach
+ *
+ * Drops the cached tables of the attached maps after the simulation wrote to
+ * their values directly.
+ */
+void HydraulicErosion::_detach()
+{
+    IntensityMap *maps[3] = {this->_height, this->_sediment, this->_erosion};
+    for (IntensityMap *map : maps)
+        if (map)
+            map->invalidate();
+}
+
+/**
+ * tileSize
+ *
+ * The size of the square tiles used by the tiled simulation. Tiles need to be
+ * large enough to hold the erosion brush and smoothing kernel inside their
+ * halo, otherwise the size follows the map so smaller maps still split into
+ * enough tiles to keep the threads busy.
+ *
+ * @param int width : The width of the map.
+ * @param int height : The height of the map.
+ *
+ * @returns int : The tile size in pixels.
+ */
+int HydraulicErosion::tileSize(int width, int height)
+{
+    int margin = (int)ceil(this->_parameters.erosion_radius) + 3;
+    int size = std::max(64, std::min(256, std::min(width, height) / 8));
+    return std::max(size, 2 * (TILE_HALO + margin) + 2);
+}
+
+/**
+ * runTiled
+ *
+ * Simulates droplets in parallel. The map is split into square tiles and each
+ * round every tile spawns its share of droplets (by area). The tiles run in
+ * four checkerboard phases so tiles running at the same time are never
+ * adjacent. A droplet may step into a small halo around its tile, the halo
+ * plus the reach of the erosion brush is less than half a tile so concurrent
+ * tiles never touch the same pixels and write directly into the shared maps.
+ *
+ * When a droplet leaves the halo it is handed over (halo exchange) to the tile
+ * it moved into and continues when that tile's phase runs, so droplets keep
+ * their full lifespan. The tile grid is shifted randomly each round so the
+ * tile borders do not line up between rounds.
+ *
+ * Every tile uses its own generator seeded from the seed, round, and tile, and
+ * handed over droplets are queued in tile order, so the result only depends
+ * on the seed and the map, not the number of threads.
+ *
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ * @param int droplets : The number of droplets to simulate.
+ */
+void HydraulicErosion::runTiled(IntensityMap *height,
+                                IntensityMap *sediment,
+                                IntensityMap *erosion,
+                                int droplets)
+{
+    Q_CHECK_PTR(height);
+    int width = height->width;
+    int rows = height->height;
+
+    // Tiles write directly into the maps
+    this->_attach(height, sediment, erosion);
+
+    int size = this->tileSize(width, rows);
+    double halo = (double)TILE_HALO;
+
+    int round_size = (width / size + 1) * (rows / size + 1) * ROUND_DROPLETS;
+    long long area = (long long)width * (long long)rows;
+
+    std::mt19937 round_gen(this->_parameters.seed);
+
+    // Droplets still moving at the end of a round
+    std::vector<Droplet> carry;
+
+    int done = 0;
+    for (unsigned int round = 0; done < droplets || !carry.empty(); round++)
+    {
+        int count = std::min(round_size, droplets - done);
+
+        // Shift the tile grid
+        int offset_x = (int)(round_gen() % (unsigned int)size);
+        int offset_y = (int)(round_gen() % (unsigned int)size);
+
+        int tiles_x = (width + offset_x + size - 1) / size;
+        int tiles_y = (rows + offset_y + size - 1) / size;
+        int tiles = tiles_x * tiles_y;
+
+        auto tileOf = [&](Droplet const &drop) {
+            int tx = std::max(0, std::min(tiles_x - 1,
+                (int)floor((drop.pos_x + offset_x) / size)));
+            int ty = std::max(0, std::min(tiles_y - 1,
+                (int)floor((drop.pos_y + offset_y) / size)));
+            return ty * tiles_x + tx;
+        };
+
+        // Split the rounds droplets between tiles by their area in the map,
+        // tile t spawns droplets [first[t], first[t + 1])
+        std::vector<int> first(tiles + 1, 0);
+        long long covered = 0;
+        for (int t = 0; t < tiles; t++)
+        {
+            int tx = t % tiles_x;
+            int ty = t / tiles_x;
+            int x_0 = std::max(0, tx * size - offset_x);
+            int x_1 = std::min(width, (tx + 1) * size - offset_x);
+            int y_0 = std::max(0, ty * size - offset_y);
+            int y_1 = std::min(rows, (ty + 1) * size - offset_y);
+
+            first[t] = (int)((long long)count * covered / area);
+            covered += (long long)std::max(0, x_1 - x_0)
+                     * (long long)std::max(0, y_1 - y_0);
+        }
+        first[tiles] = count;
+
+        // Droplets waiting on each tile, and droplets leaving each tile
+        std::vector<std::vector<Droplet>> inbox(tiles);
+        std::vector<std::vector<Droplet>> outbox(tiles);
+        for (Droplet const &drop : carry)
+            inbox[tileOf(drop)].push_back(drop);
+        carry.clear();
+
+        for (int phase = 0; phase < 4; phase++)
+        {
+            std::vector<int> phase_tiles;
+            for (int t = 0; t < tiles; t++)
+                if (((t % tiles_x) & 1) + (((t / tiles_x) & 1) << 1) == phase)
+                    phase_tiles.push_back(t);
+
+            parallelFor((int)phase_tiles.size(), [&](int i) {
+                int t = phase_tiles[i];
+                int tx = t % tiles_x;
+                int ty = t / tiles_x;
+
+                double x_0 = std::max(0, tx * size - offset_x);
+                double x_1 = std::min(width - 1, (tx + 1) * size - offset_x);
+                double y_0 = std::max(0, ty * size - offset_y);
+                double y_1 = std::min(rows - 1, (ty + 1) * size - offset_y);
+
+                Bounds bounds{x_0 - halo, y_0 - halo, x_1 + halo, y_1 + halo};
+
+                std::seed_seq seq{this->_parameters.seed,
+                                  round,
+                                  (unsigned int)t};
+                std::mt19937 gen(seq);
+                std::uniform_real_distribution<double> distrib_x(x_0, x_1);
+                std::uniform_real_distribution<double> distrib_y(y_0, y_1);
+
+                // Continue droplets handed over from neighbouring tiles, then
+                // spawn this tiles droplets
+                size_t handed = 0;
+                int d = first[t];
+                auto next = [&](Droplet &drop) {
+                    if (handed < inbox[t].size())
+                    {
+                        drop = inbox[t][handed++];
+                        return true;
+                    }
+                    if (d >= first[t + 1])
+                        return false;
+                    drop = Droplet();
+                    drop.pos_x = distrib_x(gen);
+                    drop.pos_y = distrib_y(gen);
+                    d++;
+                    return true;
+                };
+
+                Droplet drop;
+                while (next(drop))
+                    if (!this->_droplet(drop, bounds))
+                        outbox[t].push_back(drop);
+                inbox[t].clear();
+            });
+
+            // Halo exchange, hand droplets to the tiles they moved into
+            for (int t = 0; t < tiles; t++)
+            {
+                for (Droplet const &drop : outbox[t])
+                    inbox[tileOf(drop)].push_back(drop);
+                outbox[t].clear();
+            }
+        }
+
+        // Droplets handed to tiles that already ran go to the next round
+        for (int t = 0; t < tiles; t++)
+            carry.insert(carry.end(), inbox[t].begin(), inbox[t].end());
+
+        done += count;
+    }
+
+    this->_detach();
+}
+
+/**
+ * _droplet
+ *
+ * Simulates a rain drop until it evaporates, stops, or falls off the map. If
+ * the droplet is about to step from outside the bounds it is left as is so it
+ * can be continued by whoever owns that region.
+ *
+ * @param Droplet& drop : The droplet to simulate, updated in place.
+ * @param Bounds bounds : The region the droplet may step from.
+ *
+ * @returns bool : True when the droplet died, false when it left the bounds.
+ */
+bool HydraulicErosion::_droplet(Droplet &drop, Bounds bounds)
+{
+    DropletParameters &p = this->_parameters;
+    Grid &map = this->_height_grid;
+
+    double &pos_x = drop.pos_x;
+    double &pos_y = drop.pos_y;
+    double &dir_x = drop.dir_x;
+    double &dir_y = drop.dir_y;
+    double &speed = drop.speed;
+    double &sediment = drop.sediment;
+    double &water = drop.water;
+
+    // While the raindrop lives, move, erode, and deposit.
+    for (; drop.life < p.max_drop_life; drop.life++)
+    {
+        // Moved out of the region, let the next region continue
+        if (pos_x < bounds.min_x
+            || pos_x > bounds.max_x
+            || pos_y < bounds.min_y
+            || pos_y > bounds.max_y)
+            return false;
+
+        // Get the current height
+        double old_height = map.sample(pos_x, pos_y);
+
+        // Get the greatest descent
+        glm::dvec2 grad = map.gradient(pos_x, pos_y);
+
+        // Update the movement direction with inertia and gradient descent
+        dir_x = dir_x * p.inertia - grad.x * (1.00 - p.inertia);
+        dir_y = dir_y * p.inertia - grad.y * (1.00 - p.inertia);
+
+        // Normalize the movement (1 pixel radius distance of movement)
+        double norm = sqrt(dir_x * dir_x + dir_y * dir_y);
+        if (norm != 0.00)
+        {
+            dir_x /= norm;
+            dir_y /= norm;
+        }
+
+        // Update particle position
+        pos_x += dir_x;
+        pos_y += dir_y;
+
+        // Fell off map or stopped moving? Go to next particle
+        if ((dir_x == 0.00 && dir_y == 0.00)
+            || pos_x < 0.00
+            || pos_x > (double)map.width - 1.00
+            || pos_y < 0.00
+            || pos_y > (double)map.height - 1.00)
+            return true;
+
+        // Get new position height
+        double new_height = map.sample(pos_x, pos_y);
+
+        // Get the change in height
+        double delta_height = new_height - old_height;
+
+        // Calculate the sediment capacity
+        double sediment_cap =
+            std::max(-delta_height * speed * water * p.sediment_capacity,
+                     p.min_sediment_capacity);
+
+        // If sediment is beyond capacity deposit sediment
+        if (sediment > sediment_cap
+            || delta_height > 0.00
+            || (dir_x == 0.00 && dir_y == 0.00))
+        {
+            // Deposit at most the change in height (prevents holes)
+            double deposit = delta_height > 0.00
+                             ? std::min(delta_height, sediment)
+                             : (sediment - sediment_cap) * p.deposit_speed;
+
+            // Update the sediment value
+            sediment -= deposit;
+
+            this->_deposit(pos_x, pos_y, deposit);
+        }
+
+        // Still have capacity for sediment, erode some terrain
+        else
+        {
+            // Get erosion amount
+            double erode = std::min((sediment_cap - sediment)
+                                    * p.erosion_speed,
+                                    -delta_height);
+
+            sediment = this->_erode(pos_x, pos_y, erode, sediment);
+        }
+        // Update the speed of the droplet
+        speed = sqrt(speed * speed + delta_height * p.g);
+        // Slowly evaporate the water
+        water *= (1.00 - p.evaporation_rate);
+    }
+    return true;
+}
+
+/**
+ * _deposit
+ *
+ * Places deposited sediment onto the height map (and sediment map) spread over
+ * the pixels around the position, then smooths the pixel.
+ *
+ * @param double x : The x position of the droplet.
+ * @param double y : The y position of the droplet.
+ * @param double amount : The amount of sediment deposited.
+ */
+void HydraulicErosion::_deposit(double x, double y, double amount)
+{
+    // Place the depositing value onto the map
+    this->_height_grid.interpolateAdd(x, y, amount);
+    if (this->_sediment)
+        this->_sediment_grid.interpolateAdd(x, y, amount);
+
+    // Smooth particle (apply intensity)
+    this->_smooth((int)round(x), (int)round(y));
+}
+
+/**
+ * _erode
+ *
+ * Erodes the terrain with the precomputed brush around the position. When the
+ * whole brush is inside the map the pixels are updated directly, near the
+ * edges every pixel is bounds checked.
+ *
+ * @param double x : The x position of the droplet.
+ * @param double y : The y position of the droplet.
+ * @param double amount : The amount to erode.
+ * @param double sediment : The sediment carried by the droplet.
+ *
+ * @returns double : The sediment carried by the droplet after eroding.
+ */
+double HydraulicErosion::_erode(double x,
+                                double y,
+                                double amount,
+                                double sediment)
+{
+    Grid &map = this->_height_grid;
+    Grid &erosion = this->_erosion_grid;
+    bool track = this->_erosion != nullptr;
+
+    if (map.inside(x, y, this->_brush_reach))
+    {
+        for (BrushTap const &tap : this->_brush)
+        {
+            // Reduce erosion the farther away from the point
+            double strength = std::min(0.001, tap.weight * amount);
+
+            double px = x + tap.x;
+            double py = y + tap.y;
+            int x_0 = (int)floor(px);
+            int y_0 = (int)floor(py);
+            double xp = px - floor(px);
+            double yp = py - floor(py);
+            double xp_1 = 1.00 - xp;
+            double yp_1 = 1.00 - yp;
+
+            // Update the terrain with erosion
+            double v = -strength;
+            double w[4] = {v * xp_1 * yp_1,
+                           v * xp * yp_1,
+                           v * xp_1 * yp,
+                           v * xp * yp};
+            int i = y_0 * map.width + x_0;
+
+            map.values[i] += w[0];
+            map.values[i + 1] += w[1];
+            map.values[i + map.width] += w[2];
+            map.values[i + map.width + 1] += w[3];
+
+            if (track)
+            {
+                erosion.values[i] += w[0];
+                erosion.values[i + 1] += w[1];
+                erosion.values[i + map.width] += w[2];
+                erosion.values[i + map.width + 1] += w[3];
+            }
+
+            // Normally would be 'sediment += strength' however,
+            // there is an odd problem where sediment is 0,
+            // strength is some positive number, but sediment
+            // becomes -strength
+            sediment = abs(sediment + strength);
+        }
+        return sediment;
+    }
+
+    for (BrushTap const &tap : this->_brush)
+    {
+        double strength = std::min(0.001, tap.weight * amount);
+
+        // Update the terrain with erosion
+        map.interpolateAdd(x + tap.x, y + tap.y, -strength);
+        if (track)
+            erosion.interpolateAdd(x + tap.x, y + tap.y, -strength);
+
+        sediment = abs(sediment + strength);
+    }
+    return sediment;
+}
+
+/**
+ * _smooth
+ *
+ * Applies a smoothing function (kernel) to a pixel at a specific point.
+ * Used during the sediment placement process as there is some heavy
+ * artifacting. Interesting side effect of this function the way it is, is the
+ * changing of the smooth value effects an intensity of the erosion effect.
+ * The kernel is built with the simulation, pixels away from the edges are
+ * read directly without bounds checks.
+ *
+ * @param int x : The x pixel to smooth.
+ * @param int y : The y pixel to smooth.
+ */
+void HydraulicErosion::_smooth(int x, int y)
+{
+    Grid &map = this->_height_grid;
+    double const (&K)[3][3] = this->_kernel;
+
+    // Interior, all neighbours are in the map
+    if (x > 0 && y > 0 && x < map.width - 1 && y < map.height - 1)
+    {
+        double *up = map.values + (y - 1) * map.width + x;
+        double *row = up + map.width;
+        double *down = row + map.width;
+
+        double v = up[-1] * K[0][0] + row[-1] * K[1][0] + down[-1] * K[2][0]
+                 + up[0] * K[0][1] + row[0] * K[1][1] + down[0] * K[2][1]
+                 + up[1] * K[0][2] + row[1] * K[1][2] + down[1] * K[2][2];
+
+        row[0] = v / this->_kernel_sum;
+        return;
+    }
+
+    double div = this->_kernel_sum;
+
+    // Compensation for edge values
+    if (x <= 0 || x >= map.width - 1)
+        div -= 6.00;
+
+    if (y <= 0 || y >= map.height - 1)
+        div -= 6.00;
+
+    if ((x <= 0 || x >= map.width - 1)
+        && (y <= 0 || y >= map.height - 1))
+        div += 1.00;
+
+    // Get pixels to smooth with
+    double M[3][3] = {
+        {map.at(x - 1, y - 1), map.at(x, y - 1), map.at(x + 1, y - 1)},
+        {map.at(x - 1, y), map.at(x, y), map.at(x + 1, y)},
+        {map.at(x - 1, y + 1), map.at(x, y + 1), map.at(x + 1, y + 1)}};
+
+    // Apply smoothing
+    double v = M[0][0] * K[0][0] + M[1][0] * K[1][0] + M[2][0] * K[2][0]
+             + M[0][1] * K[0][1] + M[1][1] * K[1][1] + M[2][1] * K[2][1]
+             + M[0][2] * K[0][2] + M[1][2] * K[1][2] + M[2][2] * K[2][2];
+
+    if (x >= 0 && x < map.width && y >= 0 && y < map.height)
+        map.values[y * map.width + x] = v / div;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * DropletParameters
+ *
+ * The constants that control the droplet (particle) erosion simulation.
+ */
+struct DropletParameters
+{
+    int max_drop_life = 200;
+
+    double inertia = 0.4; // Inertia constant
+    double sediment_capacity = 1.00; // Sediment capacity constant
+    double min_sediment_capacity = 0.01; // Minimum sediment capacity constant
+    double deposit_speed = 0.012; // Deposit speed constant
+    double erosion_speed = 0.012; // Erode speed constant
+    double erosion_radius = 0.2; // Erosion radius
+    double g = 4.00;
+    double evaporation_rate = 0.12;
+    double smooth_strength = 0.10;
+
+    // Seed for the droplet positions
+    unsigned int seed = 1;
+};
+
+/**
+ * HydraulicErosion
+ *
+ * Droplet based hydraulic erosion simulation. Simulates rain drops running down
+ * the height map, eroding terrain while they have capacity and depositing
+ * sediment when they slow down. The sediment and erosion maps are optional
+ * (nullptr) debugging outputs of where material was moved.
+ */
+class HydraulicErosion
+{
+public:
+    // Create a simulation with the provided parameters
+    HydraulicErosion(DropletParameters parameters);
+
+    // Simulate droplets one after the other over the whole map
+    void run(IntensityMap *height,
+             IntensityMap *sediment,
+             IntensityMap *erosion,
+             int droplets);
+
+    // Simulate droplets in tiles, non-adjacent tiles run concurrently
+    void runTiled(IntensityMap *height,
+                  IntensityMap *sediment,
+                  IntensityMap *erosion,
+                  int droplets);
+
+    // Simulate droplets coarse to fine, the coarsest level fits within base
+    // pixels and finer levels refine it with fewer droplets (uses runTiled)
+    void runMultigrid(IntensityMap *height,
+                      IntensityMap *sediment,
+                      IntensityMap *erosion,
+                      int droplets,
+                      int base);
+
+    // The tile size used by runTiled for a map size
+    int tileSize(int width, int height);
+
+private:
+    // The state of a droplet, kept so droplets can move between tiles
+    struct Droplet
+    {
+        double pos_x;
+        double pos_y;
+        double dir_x = 0.00;
+        double dir_y = 0.00;
+        double speed = 1.00;
+        double sediment = 0.00;
+        double water = 1.00;
+        int life = 0;
+    };
+
+    // Region a droplet may step from [min, max]
+    struct Bounds
+    {
+        double min_x;
+        double min_y;
+        double max_x;
+        double max_y;
+    };
+
+    // Direct view of the values of a fully stored map (no bounds growth)
+    struct Grid
+    {
+        double *values = nullptr;
+        int width = 0;
+        int height = 0;
+        double fill = 0.00;
+
+        // Pixel value, fill outside of the map
+        double at(int x, int y) const;
+
+        // Pixel value clamped to the edge of the map
+        double clamped(int x, int y) const;
+
+        // Interpolated height and direction of greatest descent
+        double sample(double x, double y) const;
+        glm::dvec2 gradient(double x, double y) const;
+
+        // Spread a value over the four pixels around a position
+        void interpolateAdd(double x, double y, double v);
+
+        // Whether a position and the pixel after it are inside the map
+        bool inside(double x, double y, double reach) const;
+    };
+
+    // Offset from the droplet and weight of a pixel of the erosion brush
+    struct BrushTap
+    {
+        double x;
+        double y;
+        double weight;
+    };
+
+    // Store the maps and make them ready for direct access
+    void _attach(IntensityMap *height,
+                 IntensityMap *sediment,
+                 IntensityMap *erosion);
+
+    // Drop the cached tables of the maps written through the grids
+    void _detach();
+
+    // Simulate a droplet until it dies (true) or leaves the bounds (false)
+    bool _droplet(Droplet &drop, Bounds bounds);
+
+    // Deposit sediment at a position and smooth it
+    void _deposit(double x, double y, double amount);
+
+    // Erode terrain with the brush, returns the new droplet sediment
+    double _erode(double x, double y, double amount, double sediment);
+
+    // Smooth a deposited pixel
+    void _smooth(int x, int y);
+
+    DropletParameters _parameters;
+
+    // Erosion brush and smoothing kernel, built from the parameters
+    std::vector<BrushTap> _brush;
+    double _brush_reach = 0.00;
+    double _kernel[3][3];
+    double _kernel_sum = 0.00;
+
+    // Maps being simulated on, sediment and erosion may be nullptr
+    IntensityMap *_height = nullptr;
+    IntensityMap *_sediment = nullptr;
+    IntensityMap *_erosion = nullptr;
+    Grid _height_grid;
+    Grid _sediment_grid;
+    Grid _erosion_grid;
+};
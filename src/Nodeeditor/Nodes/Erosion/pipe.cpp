@@ -0,0 +1,348 @@
+#include "pipe.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+// Water depth below which a pixel is treated as dry
+static const double DRY = 1e-6;
+
+/**
+ * PipeErosion
+ *
+ * Creates the simulation.
+ *
+ * @param PipeParameters parameters : The simulation constants.
+ */
+PipeErosion::PipeErosion(PipeParameters parameters)
+    : _parameters(parameters)
+{
+}
+
+/**
+ * run
+ *
+ * Simulates rain falling over the whole map for a number of steps. Each step
+ * runs the flux, transport, flow, and erosion passes in order. Any sediment
+ * still carried by the water at the end is deposited where it is.
+ *
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ * @param int steps : The number of steps to simulate.
+ */
+void PipeErosion::run(IntensityMap *height,
+                      IntensityMap *sediment,
+                      IntensityMap *erosion,
+                      int steps)
+{
+    Q_CHECK_PTR(height);
+    this->_width = height->width;
+    this->_height = height->height;
+
+    size_t size = (size_t)this->_width * (size_t)this->_height;
+    double scale = this->_parameters.height_scale;
+
+    this->_terrain.resize(size);
+    for (int y = 0; y < this->_height; y++)
+        for (int x = 0; x < this->_width; x++)
+            this->_terrain[y * this->_width + x] = height->at(x, y) * scale;
+
+    this->_terrain_next.assign(size, 0.00);
+    this->_water.assign(size, 0.00);
+    this->_flux_left.assign(size, 0.00);
+    this->_flux_right.assign(size, 0.00);
+    this->_flux_top.assign(size, 0.00);
+    this->_flux_bottom.assign(size, 0.00);
+    this->_velocity_x.assign(size, 0.00);
+    this->_velocity_y.assign(size, 0.00);
+    this->_suspended.assign(size, 0.00);
+    this->_suspended_next.assign(size, 0.00);
+    this->_deposited.assign(size, 0.00);
+    this->_eroded.assign(size, 0.00);
+
+    for (int step = 0; step < steps; step++)
+    {
+        this->_flux();
+        this->_transport();
+        this->_flow();
+        this->_erode();
+    }
+
+    // Drop what the water still carries
+    for (size_t i = 0; i < size; i++)
+    {
+        this->_terrain[i] += this->_suspended[i];
+        this->_deposited[i] += this->_suspended[i];
+    }
+
+    // A new map, the input may be a fill map
+    std::vector<double> values(size);
+    for (size_t i = 0; i < size; i++)
+        values[i] = this->_terrain[i] / scale;
+    *height = IntensityMap(this->_width, this->_height, values);
+
+    if (sediment)
+        for (int y = 0; y < this->_height; y++)
+            for (int x = 0; x < this->_width; x++)
+                sediment->set(x, y, sediment->at(x, y)
+                    + this->_deposited[y * this->_width + x] / scale);
+
+    if (erosion)
+        for (int y = 0; y < this->_height; y++)
+            for (int x = 0; x < this->_width; x++)
+                erosion->set(x, y, erosion->at(x, y)
+                    + this->_eroded[y * this->_width + x] / scale);
+}
+
+/**
+ * _flux
+ *
+ * Adds the rain to every pixel and updates the flux through the virtual pipes
+ * to the four neighbours from the difference in water surface height. The flux
+ * is scaled down when it would drain more water than the pixel holds. Pipes
+ * leading off the map are closed.
+ */
+void PipeErosion::_flux()
+{
+    PipeParameters &p = this->_parameters;
+    int width = this->_width;
+    int rows = this->_height;
+
+    double dt = p.time_step;
+    double pipe = dt * p.pipe_area * p.g;
+
+    // Rain first, the flux reads the neighbours water
+    parallelRows(rows, [&](int start, int end) {
+        for (int i = start * width; i < end * width; i++)
+            this->_water[i] += dt * p.rain;
+    });
+
+    parallelRows(rows, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int i = y * width + x;
+                double surface = this->_terrain[i] + this->_water[i];
+
+                auto flow = [&](double flux, int n) {
+                    double difference = surface
+                                        - this->_terrain[n]
+                                        - this->_water[n];
+                    return std::max(0.00, flux + pipe * difference);
+                };
+
+                double left = x > 0 ? flow(this->_flux_left[i], i - 1) : 0.00;
+                double right = x < width - 1
+                               ? flow(this->_flux_right[i], i + 1)
+                               : 0.00;
+                double top = y > 0 ? flow(this->_flux_top[i], i - width) : 0.00;
+                double bottom = y < rows - 1
+                                ? flow(this->_flux_bottom[i], i + width)
+                                : 0.00;
+
+                // Can not drain more water than there is
+                double out = (left + right + top + bottom) * dt;
+                double k = out > 0.00
+                           ? std::min(1.00, this->_water[i] / out)
+                           : 1.00;
+
+                this->_flux_left[i] = left * k;
+                this->_flux_right[i] = right * k;
+                this->_flux_top[i] = top * k;
+                this->_flux_bottom[i] = bottom * k;
+            }
+        }
+    });
+}
+
+/**
+ * _flow
+ *
+ * Moves the water through the pipes, each pixel gains the flux flowing in from
+ * its neighbours and loses its own outflow, then some of it evaporates. The
+ * velocity is the average flow through the pixel divided by its average water
+ * depth.
+ */
+void PipeErosion::_flow()
+{
+    int width = this->_width;
+    int rows = this->_height;
+    double dt = this->_parameters.time_step;
+    double evaporation =
+        std::max(0.00, 1.00 - this->_parameters.evaporation_rate * dt);
+
+    parallelRows(rows, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int i = y * width + x;
+
+                double from_left = x > 0 ? this->_flux_right[i - 1] : 0.00;
+                double from_right = x < width - 1
+                                    ? this->_flux_left[i + 1]
+                                    : 0.00;
+                double from_top = y > 0 ? this->_flux_bottom[i - width] : 0.00;
+                double from_bottom = y < rows - 1
+                                     ? this->_flux_top[i + width]
+                                     : 0.00;
+
+                double in = from_left + from_right + from_top + from_bottom;
+                double out = this->_flux_left[i]
+                           + this->_flux_right[i]
+                           + this->_flux_top[i]
+                           + this->_flux_bottom[i];
+
+                double before = this->_water[i];
+                double after = std::max(0.00, before + dt * (in - out));
+                this->_water[i] = after * evaporation;
+
+                // Average flow through the pixel
+                double flow_x = 0.5 * (from_left
+                                       - this->_flux_left[i]
+                                       + this->_flux_right[i]
+                                       - from_right);
+                double flow_y = 0.5 * (from_top
+                                       - this->_flux_top[i]
+                                       + this->_flux_bottom[i]
+                                       - from_bottom);
+
+                double depth = 0.5 * (before + after);
+                this->_velocity_x[i] = depth > DRY ? flow_x / depth : 0.00;
+                this->_velocity_y[i] = depth > DRY ? flow_y / depth : 0.00;
+            }
+        }
+    });
+}
+
+/**
+ * _erode
+ *
+ * Compares the sediment each pixel carries against the capacity of its water
+ * (from the slope and the speed of the water). Below capacity the terrain is
+ * dissolved into the water, above it sediment is deposited. Reads the terrain
+ * around the pixel for the slope so the result goes into a second buffer.
+ */
+void PipeErosion::_erode()
+{
+    PipeParameters &p = this->_parameters;
+    int width = this->_width;
+    int rows = this->_height;
+    double dt = p.time_step;
+
+    parallelRows(rows, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int i = y * width + x;
+
+                double left = this->_terrain[x > 0 ? i - 1 : i];
+                double right = this->_terrain[x < width - 1 ? i + 1 : i];
+                double top = this->_terrain[y > 0 ? i - width : i];
+                double bottom = this->_terrain[y < rows - 1 ? i + width : i];
+
+                double slope_x = 0.5 * (right - left);
+                double slope_y = 0.5 * (bottom - top);
+                double slope = slope_x * slope_x + slope_y * slope_y;
+
+                // Sine of the tilt angle
+                double tilt = std::max(p.min_tilt, sqrt(slope / (1.00 + slope)));
+
+                double speed = sqrt(this->_velocity_x[i] * this->_velocity_x[i]
+                                  + this->_velocity_y[i] * this->_velocity_y[i]);
+
+                // Shallow water carries less
+                double capacity = p.sediment_capacity
+                                  * tilt
+                                  * speed
+                                  * std::min(1.00, this->_water[i]);
+                double carried = this->_suspended[i];
+                double terrain = this->_terrain[i];
+
+                if (capacity > carried)
+                {
+                    double amount = dt * p.dissolve_speed * (capacity - carried);
+                    terrain -= amount;
+                    carried += amount;
+                    this->_eroded[i] -= amount;
+                }
+                else
+                {
+                    double amount = std::min(carried,
+                                             dt * p.deposit_speed
+                                             * (carried - capacity));
+                    terrain += amount;
+                    carried -= amount;
+                    this->_deposited[i] += amount;
+                }
+
+                this->_terrain_next[i] = terrain;
+                this->_suspended[i] = carried;
+            }
+        }
+    });
+
+    std::swap(this->_terrain, this->_terrain_next);
+}
+
+/**
+ * _transport
+ *
+ * Carries the suspended sediment along with the water. The share of a pixels
+ * water leaving through each pipe this step takes the same share of its
+ * sediment, so no sediment is lost or created. Runs before the water moves
+ * (uses the water and flux of the same step).
+ */
+void PipeErosion::_transport()
+{
+    int width = this->_width;
+    int rows = this->_height;
+    double dt = this->_parameters.time_step;
+
+    // Share of the water of pixel n leaving through a pipe
+    auto share = [&](double flux, int n) {
+        return this->_water[n] > DRY ? flux * dt / this->_water[n] : 0.00;
+    };
+
+    parallelRows(rows, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int i = y * width + x;
+
+                double out = this->_flux_left[i]
+                           + this->_flux_right[i]
+                           + this->_flux_top[i]
+                           + this->_flux_bottom[i];
+
+                double carried = this->_suspended[i]
+                                 * std::max(0.00, 1.00 - share(out, i));
+
+                if (x > 0)
+                    carried += this->_suspended[i - 1]
+                               * share(this->_flux_right[i - 1], i - 1);
+                if (x < width - 1)
+                    carried += this->_suspended[i + 1]
+                               * share(this->_flux_left[i + 1], i + 1);
+                if (y > 0)
+                    carried += this->_suspended[i - width]
+                               * share(this->_flux_bottom[i - width],
+                                       i - width);
+                if (y < rows - 1)
+                    carried += this->_suspended[i + width]
+                               * share(this->_flux_top[i + width], i + width);
+
+                this->_suspended_next[i] = carried;
+            }
+        }
+    });
+
+    std::swap(this->_suspended, this->_suspended_next);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * PipeParameters
+ *
+ * The constants that control the grid (virtual pipe) erosion simulation.
+ */
+struct PipeParameters
+{
+    double time_step = 0.02;
+    double rain = 0.01; // Water added to every pixel each step
+    double pipe_area = 1.00; // Cross section of the pipes between pixels
+    double g = 9.81;
+    double sediment_capacity = 1.00; // Sediment capacity constant
+    double dissolve_speed = 0.50; // Erode speed constant
+    double deposit_speed = 1.00; // Deposit speed constant
+    double evaporation_rate = 0.015;
+    double min_tilt = 0.05; // Lowest slope used for the capacity (flat ground)
+
+    // Height of the terrain (in pixels) for a height map value of 1.00
+    double height_scale = 64.00;
+};
+
+/**
+ * PipeErosion
+ *
+ * Grid based hydraulic erosion simulation using the virtual pipe shallow water
+ * model. Every pixel stores its water height, outflow flux to its four
+ * neighbours, water velocity, and suspended sediment. Each step updates every
+ * grid with a stencil pass over the rows, the passes only write to their own
+ * pixel so rows are processed concurrently.
+ */
+class PipeErosion
+{
+public:
+    // Create a simulation with the provided parameters
+    PipeErosion(PipeParameters parameters);
+
+    // Simulate steps over the whole map
+    void run(IntensityMap *height,
+             IntensityMap *sediment,
+             IntensityMap *erosion,
+             int steps);
+
+private:
+    // Add rain and update the outflow flux of every pixel
+    void _flux();
+
+    // Carry the suspended sediment with the flux
+    void _transport();
+
+    // Move the water along the flux, update the velocity, and evaporate
+    void _flow();
+
+    // Erode or deposit sediment depending on the carrying capacity
+    void _erode();
+
+    PipeParameters _parameters;
+
+    int _width = 0;
+    int _height = 0;
+
+    // Grids (row-major, one value per pixel)
+    std::vector<double> _terrain;
+    std::vector<double> _terrain_next;
+    std::vector<double> _water;
+    std::vector<double> _flux_left;
+    std::vector<double> _flux_right;
+    std::vector<double> _flux_top;
+    std::vector<double> _flux_bottom;
+    std::vector<double> _velocity_x;
+    std::vector<double> _velocity_y;
+    std::vector<double> _suspended;
+    std::vector<double> _suspended_next;
+
+    // Total material deposited (positive) and eroded (negative) per pixel
+    std::vector<double> _deposited;
+    std::vector<double> _eroded;
+};
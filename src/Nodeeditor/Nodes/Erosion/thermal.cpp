@@ -0,0 +1,243 @@
+#include "thermal.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+// Offsets to the 8 neighbours, the opposite of neighbour k is 7 - k
+static const int NEIGHBOUR_X[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int NEIGHBOUR_Y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+/**
+ * ThermalErosion
+ *
+ * Creates the simulation.
+ *
+ * @param ThermalParameters parameters : The simulation constants.
+ */
+ThermalErosion::ThermalErosion(ThermalParameters parameters)
+    : _parameters(parameters)
+{
+    // Stable height difference, diagonal neighbours are further away
+    double talus = tan(this->_parameters.angle * M_PI / 180.00);
+    for (int k = 0; k < 8; k++)
+    {
+        bool diagonal = NEIGHBOUR_X[k] != 0 && NEIGHBOUR_Y[k] != 0;
+        this->_talus[k] = diagonal ? talus * M_SQRT2 : talus;
+    }
+}
+
+/**
+ * run
+ *
+ * Simulates material sliding down the slopes for a number of iterations. The
+ * edges of the map are closed, no material is lost or created.
+ *
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param int iterations : The number of iterations to simulate.
+ */
+void ThermalErosion::run(IntensityMap *height, int iterations)
+{
+    Q_CHECK_PTR(height);
+    this->_width = height->width;
+    this->_height = height->height;
+
+    size_t size = (size_t)this->_width * (size_t)this->_height;
+    double scale = this->_parameters.height_scale;
+
+    this->_terrain.resize(size);
+    for (int y = 0; y < this->_height; y++)
+        for (int x = 0; x < this->_width; x++)
+            this->_terrain[y * this->_width + x] = height->at(x, y) * scale;
+
+    this->_terrain_next.assign(size, 0.00);
+    this->_moved.assign(size, 0.00);
+    this->_rate.assign(size, 0.00);
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        this->_slide();
+        this->_settle();
+    }
+
+    // A new map, the input may be a fill map
+    std::vector<double> values(size);
+    for (size_t i = 0; i < size; i++)
+        values[i] = this->_terrain[i] / scale;
+    *height = IntensityMap(this->_width, this->_height, values);
+}
+
+/**
+ * _slide
+ *
+ * Finds the excess height over the talus to every lower neighbour. A share
+ * (strength) of the largest excess slides off the pixel and is split between
+ * the neighbours by their excess. The interior of each row reads its
+ * neighbours from the rows above and below without bounds checks, GCC
+ * vectorizes that loop at -O3.
+ */
+void ThermalErosion::_slide()
+{
+    int width = this->_width;
+    int rows = this->_height;
+    double strength = this->_parameters.strength;
+    double const *terrain = this->_terrain.data();
+    double const *talus = this->_talus;
+
+    auto store = [&](int i, double total, double steepest) {
+        double moved = strength * steepest;
+        this->_moved[i] = moved;
+        this->_rate[i] = total > 0.00 ? moved / total : 0.00;
+    };
+
+    // Pixels on the edge skip the neighbours off the map
+    auto edge = [&](int x, int y) {
+        int i = y * width + x;
+        double total = 0.00;
+        double steepest = 0.00;
+        for (int k = 0; k < 8; k++)
+        {
+            int nx = x + NEIGHBOUR_X[k];
+            int ny = y + NEIGHBOUR_Y[k];
+            if (nx < 0 || nx >= width || ny < 0 || ny >= rows)
+                continue;
+
+            double excess = std::max(0.00, terrain[i]
+                                           - terrain[ny * width + nx]
+                                           - talus[k]);
+            total += excess;
+            steepest = std::max(steepest, excess);
+        }
+        store(i, total, steepest);
+    };
+
+    parallelRows(rows, [&](int start, int end) {
+        // Local copy, otherwise the compiler can not tell that the rows
+        // written below leave the talus alone and does not vectorize
+        double row_talus[8];
+        std::copy(talus, talus + 8, row_talus);
+
+        for (int y = start; y < end; y++)
+        {
+            if (y == 0 || y == rows - 1 || width < 3)
+            {
+                for (int x = 0; x < width; x++)
+                    edge(x, y);
+                continue;
+            }
+
+            double const *top = terrain + (size_t)(y - 1) * width;
+            double const *row = terrain + (size_t)y * width;
+            double const *bottom = terrain + (size_t)(y + 1) * width;
+            double *moved = this->_moved.data() + (size_t)y * width;
+            double *rate = this->_rate.data() + (size_t)y * width;
+
+            edge(0, y);
+            for (int x = 1; x < width - 1; x++)
+            {
+                // In the order of NEIGHBOUR_X and NEIGHBOUR_Y
+                double neighbour[8] = {top[x - 1], top[x], top[x + 1],
+                                       row[x - 1], row[x + 1],
+                                       bottom[x - 1], bottom[x], bottom[x + 1]};
+                double total = 0.00;
+                double steepest = 0.00;
+                for (int k = 0; k < 8; k++)
+                {
+                    double excess = std::max(0.00, row[x]
+                                                   - neighbour[k]
+                                                   - row_talus[k]);
+                    total += excess;
+                    steepest = std::max(steepest, excess);
+                }
+                double slide = strength * steepest;
+                moved[x] = slide;
+                rate[x] = total > 0.00 ? slide / total : 0.00;
+            }
+            edge(width - 1, y);
+        }
+    });
+}
+
+/**
+ * _settle
+ *
+ * Removes the sliding material from every pixel and adds the material sliding
+ * in from its higher neighbours. Each pixel gathers from its neighbours rather
+ * than scattering into them, so the pass only writes its own pixel and the
+ * result goes into a second buffer. As in _slide the interior of each row
+ * reads the rows above and below, GCC vectorizes that loop at -O3.
+ */
+void ThermalErosion::_settle()
+{
+    int width = this->_width;
+    int rows = this->_height;
+    double const *terrain = this->_terrain.data();
+    double const *rate = this->_rate.data();
+    double const *talus = this->_talus;
+
+    // Pixels on the edge skip the neighbours off the map
+    auto edge = [&](int x, int y) {
+        int i = y * width + x;
+        double gathered = 0.00;
+        for (int k = 0; k < 8; k++)
+        {
+            int nx = x + NEIGHBOUR_X[k];
+            int ny = y + NEIGHBOUR_Y[k];
+            if (nx < 0 || nx >= width || ny < 0 || ny >= rows)
+                continue;
+
+            int n = ny * width + nx;
+            gathered += rate[n] * std::max(0.00, terrain[n]
+                                                 - terrain[i]
+                                                 - talus[k]);
+        }
+        this->_terrain_next[i] = terrain[i] - this->_moved[i] + gathered;
+    };
+
+    parallelRows(rows, [&](int start, int end) {
+        for (int y = start; y < end; y++)
+        {
+            if (y == 0 || y == rows - 1 || width < 3)
+            {
+                for (int x = 0; x < width; x++)
+                    edge(x, y);
+                continue;
+            }
+
+            double const *top = terrain + (size_t)(y - 1) * width;
+            double const *row = terrain + (size_t)y * width;
+            double const *bottom = terrain + (size_t)(y + 1) * width;
+            double const *rate_top = rate + (size_t)(y - 1) * width;
+            double const *rate_row = rate + (size_t)y * width;
+            double const *rate_bottom = rate + (size_t)(y + 1) * width;
+            double const *moved = this->_moved.data() + (size_t)y * width;
+            double *next = this->_terrain_next.data() + (size_t)y * width;
+
+            edge(0, y);
+            for (int x = 1; x < width - 1; x++)
+            {
+                // In the order of NEIGHBOUR_X and NEIGHBOUR_Y
+                double neighbour[8] = {top[x - 1], top[x], top[x + 1],
+                                       row[x - 1], row[x + 1],
+                                       bottom[x - 1], bottom[x], bottom[x + 1]};
+                double neighbour_rate[8] = {
+                    rate_top[x - 1], rate_top[x], rate_top[x + 1],
+                    rate_row[x - 1], rate_row[x + 1],
+                    rate_bottom[x - 1], rate_bottom[x], rate_bottom[x + 1]};
+                double gathered = 0.00;
+                for (int k = 0; k < 8; k++)
+                    gathered += neighbour_rate[k]
+                                * std::max(0.00, neighbour[k]
+                                                 - row[x]
+                                                 - talus[k]);
+                next[x] = row[x] - moved[x] + gathered;
+            }
+            edge(width - 1, y);
+        }
+    });
+
+    std::swap(this->_terrain, this->_terrain_next);
+}
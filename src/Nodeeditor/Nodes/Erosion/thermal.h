@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+#include "../../Datatypes/intensitymap.h"
+
+/**
+ * ThermalParameters
+ *
+ * The constants that control the thermal (talus) erosion simulation.
+ */
+struct ThermalParameters
+{
+    double angle = 35.00; // Steepest stable slope (talus angle) in degrees
+    double strength = 0.50; // Share of the excess material moved [0-0.5]
+
+    // Height of the terrain (in pixels) for a height map value of 1.00
+    double height_scale = 64.00;
+};
+
+/**
+ * ThermalErosion
+ *
+ * Thermal erosion simulation, material on slopes steeper than the talus angle
+ * slides down to its lower neighbours (8 connected) until the slopes settle.
+ * Each iteration is two stencil passes over the rows that only write their own
+ * pixel, so rows are processed concurrently and no intermediate maps are made.
+ */
+class ThermalErosion
+{
+public:
+    // Create a simulation with the provided parameters
+    ThermalErosion(ThermalParameters parameters);
+
+    // Simulate iterations over the whole map
+    void run(IntensityMap *height, int iterations);
+
+private:
+    // Find how much material slides off every pixel
+    void _slide();
+
+    // Move the sliding material onto the lower neighbours
+    void _settle();
+
+    ThermalParameters _parameters;
+
+    int _width = 0;
+    int _height = 0;
+
+    // Height difference to each neighbour that is still stable
+    double _talus[8];
+
+    // Grids (row-major, one value per pixel)
+    std::vector<double> _terrain;
+    std::vector<double> _terrain_next;
+    std::vector<double> _moved; // Material sliding off the pixel
+    std::vector<double> _rate; // Moved per unit of excess height
+};
@@ -1,33 +1,109 @@
 #include "normal.h"
 
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
 #include <QDebug>
 
+#include "Globals/parallel.h"
+
 /******************************************************************************
  *                                 WORKER                                     *
  ******************************************************************************/
 
-// Sobel Kernels for calculating normal values from the height map
-static double KERNEL_X[3][3] = {
-    {-1.00, 0.00, 1.00},
-    {-2.00, 0.00, 2.00},
-    {-1.00, 0.00, 1.00}};
+// Scale applied to the heights before the sobel filter
+static const double STRENGTH = 25.00;
+
+// Colour of pixels whose normal can not be converted into a colour
+static const QRgba64 FILL = QRgba64::fromRgba64(0, 0, 65535, 65535);
+
+/**
+ * normalColor
+ *
+ * Converts the sobel filter of a 3x3 neighbourhood of heights into the colour
+ * of the normal. The sobel kernels are
+ *
+ *     | -1  0  1 |       | -1 -2 -1 |
+ * x = | -2  0  2 |   y = |  0  0  0 |
+ *     | -1  0  1 |       |  1  2  1 |
+ *
+ * applied in row order to | a b c | d e f | g h i |.
+ * https://en.wikipedia.org/wiki/Sobel_operator
+ *
+ * The normal (-x, -y, |(x, y)|) is moved to the colour range [0, 1] and
+ * normalized. Normals out of the colour range get FILL, which is picked with
+ * a 0 or 1 weight instead of a branch, and the channels are rounded with
+ * + 0.50 as they are never negative.
+ *
+ * @returns QRgba64 : The normal colour (FILL when out of the colour range).
+ */
+static inline QRgba64 normalColor(double a, double b, double c,
+                                  double d, double f,
+                                  double g, double h, double i)
+{
+    double x_prime = -a + c - 2.00 * d + 2.00 * f - g + i;
+    double y_prime = -a - 2.00 * b - c + g + 2.00 * h + i;
+
+    double mag = sqrt(x_prime * x_prime + y_prime * y_prime);
+
+    // (n + 1) / 2 normalized, the halving cancels out in the normalization
+    double x = 1.00 - x_prime;
+    double y = 1.00 - y_prime;
+    double z = 1.00 + mag;
+    double scale = 1.00 / sqrt(x * x + y * y + z * z);
+    x *= scale;
+    y *= scale;
+    z *= scale;
+
+    // Same as QColor::fromRgbF, which rejects values out of range
+    double keep = (double)((x >= 0.00) & (x <= 1.00)
+                           & (y >= 0.00) & (y <= 1.00)
+                           & (z >= 0.00) & (z <= 1.00));
+
+    return QRgba64::fromRgba64(
+        (quint16)(keep * x * 65535.00 + 0.50),
+        (quint16)(keep * y * 65535.00 + 0.50),
+        (quint16)((keep * z + (1.00 - keep)) * 65535.00 + 0.50),
+        65535);
+}
 
-static double KERNEL_Y[3][3] = {
-    {-1.00, -2.00, -1.00},
-    {0.00, 0.00, 0.00},
-    {1.00, 2.00, 1.00}};
+/**
+ * completeValues
+ *
+ * Returns every pixel of a map row by row, maps using a fill value are
+ * expanded to one value per pixel.
+ *
+ * @param IntensityMap& map : The map.
+ *
+ * @returns std::vector<double> : The values of the map.
+ */
+static std::vector<double> completeValues(IntensityMap &map)
+{
+    size_t size = (size_t)map.width * (size_t)map.height;
+    if (map.values.size() >= size)
+        return std::vector<double>(map.values.begin(),
+                                   map.values.begin() + size);
+
+    std::vector<double> values(size);
+    for (int y = 0; y < map.height; y++)
+        for (int x = 0; x < map.width; x++)
+            values[(size_t)y * map.width + x] = map.at(x, y);
+    return values;
+}
 
 /**
  * set
  * 
- * Function to set variables needed for the workers generation. Must be used
- * after the worker is attached to the other thread and the thread has started.
+ * Function to set variables needed for the workers generation. The map is
+ * copied so it can be set while a generation is running.
  * 
- * @param IntensityMap *height_map : The height map used to generate the normal
- *                                   map.
+ * @param IntensityMap height_map : The height map used to generate the normal
+ *                                  map.
  */
-void NormalWorker::set(IntensityMap *height_map)
+void NormalWorker::set(IntensityMap height_map)
 {
+    QMutexLocker lock(&this->_mutex);
     this->_height_map = height_map;
 }
 
@@ -35,8 +111,14 @@ void NormalWorker::set(IntensityMap *height_map)
  * generate
  * 
  * The generation function that operates in a separate thread to calculate the
- * normal map. Uses sobel kernel filtering for edge detection.
- * https://en.wikipedia.org/wiki/Sobel_operator
+ * normal map. Uses sobel kernel filtering for edge detection. When the size
+ * matches the previous generation only the pixels that changed since then
+ * (plus a 1 pixel border, which their normals depend on) are filtered and
+ * patched into a copy of the previous normal map.
+ * 
+ * Rows are split into bands and filtered in parallel, each band writes its own
+ * scan lines of the image. The map is read row by row, only the first and last
+ * pixel of a row clamp their neighbours to the edge of the map.
  * 
  * @signals started
  * @signals progress
@@ -44,117 +126,180 @@ void NormalWorker::set(IntensityMap *height_map)
  */
 void NormalWorker::generate()
 {
-    Q_CHECK_PTR(this->_height_map);
-    qDebug() << this->thread()->currentThreadId();
-    qDebug() << this->_height_map->width << this->_height_map->height;
-    QImage normal(this->_height_map->width,
-                  this->_height_map->height,
-                  QImage::Format_RGBA64);
-
-    normal.fill(QColor(0, 0, 255));
+    IntensityMap height_map;
+    {
+        QMutexLocker lock(&this->_mutex);
+        height_map = this->_height_map;
+    }
+
+    int width = height_map.width;
+    int height = height_map.height;
+    std::vector<double> heights = completeValues(height_map);
+    double const *values = heights.data();
+
     emit this->started();
-    int i = 0;
-    int total = this->_height_map->width * this->_height_map->height;
 
     this->_run = true;
 
-    // Loop over all the pixels
-    for (int x = 0; x < this->_height_map->width; x++)
+    QRect region(0, 0, width, height);
+    QImage normal;
+    if (this->_previous_normal.width() == width
+        && this->_previous_normal.height() == height)
     {
-        for (int y = 0; y < this->_height_map->height; y++)
+        QRect changed = this->_changed(heights, width, height);
+
+        // Nothing changed
+        if (changed.isEmpty())
         {
-            double matrix[3][3] = {
-                {this->_getHeightIntensity(x - 1, y - 1, this->_height_map),
-                    this->_getHeightIntensity(x, y - 1, this->_height_map),
-                    this->_getHeightIntensity(x + 1, y - 1, this->_height_map)},
-                {this->_getHeightIntensity(x - 1, y, this->_height_map),
-                    0.00,
-                    this->_getHeightIntensity(x + 1, y, this->_height_map)},
-                {this->_getHeightIntensity(x - 1, y + 1, this->_height_map),
-                    this->_getHeightIntensity(x, y + 1, this->_height_map),
-                    this->_getHeightIntensity(x + 1, y + 1, this->_height_map)}
-            };
+            emit this->done(this->_previous_normal, QRect());
+            return;
+        }
+
+        region = changed.adjusted(-1, -1, 1, 1).intersected(region);
+        normal = this->_previous_normal;
+    }
+    else
+    {
+        normal = QImage(width, height, QImage::Format_RGBA64);
+        normal.fill(QColor(0, 0, 255));
+    }
+
+    // Scan lines are written from the bands, detach the image once up front
+    uchar *bits = normal.bits();
+    int stride = normal.bytesPerLine();
 
-// | a b c |   | 1 2 3 |
-// | d e f | o | 4 5 6 | = a*1 + b*2 + c*3 + d*4 + e*5 + f*6 + g*7 + h*8 + i*9
-// | g h i |   | 7 8 9 |
-            double x_prime = KERNEL_X[0][0] * matrix[0][0] + KERNEL_X[0][1] *
-                                 matrix[0][1] + KERNEL_X[0][2] * matrix[0][2] +
-                             KERNEL_X[1][0] * matrix[1][0] + KERNEL_X[1][1] *
-                                 matrix[1][1] + KERNEL_X[1][2] * matrix[1][2] +
-                             KERNEL_X[2][0] * matrix[2][0] + KERNEL_X[2][1] *
-                                 matrix[2][1] + KERNEL_X[2][2] * matrix[2][2];
-
-            double y_prime = KERNEL_Y[0][0] * matrix[0][0] + KERNEL_Y[0][1] *
-                                 matrix[0][1] + KERNEL_Y[0][2] * matrix[0][2] +
-                             KERNEL_Y[1][0] * matrix[1][0] + KERNEL_Y[1][1] *
-                                 matrix[1][1] + KERNEL_Y[1][2] * matrix[1][2] +
-                             KERNEL_Y[2][0] * matrix[2][0] + KERNEL_Y[2][1] *
-                                 matrix[2][1] + KERNEL_X[2][2] * matrix[2][2];
-
-            double mag = glm::sqrt(x_prime * x_prime + y_prime * y_prime);
-
-            // Get the normal vector, adjusted for [-1, 1] range to color range
-            // [0, 1]
-            glm::dvec3 n = glm::normalize(
-                (glm::dvec3(-x_prime, -y_prime, mag) + 1.00) / 2.00);
-
-            // Create color and apply to the normal image
-            QColor color = QColor::fromRgbF(n.x, n.y, n.z);
-            normal.setPixelColor(x, y, color);
-            emit this->progress((int)round(100.0f * (float)i / (float)total));
-            i++;
+    int left = region.left();
+    int right = region.right();
 
+    std::atomic<int> rows_done{0};
+    std::atomic<int> last_perc{-1};
+
+    parallelRows(region.height(), [&](int start, int end) {
+        for (int y = region.top() + start; y < region.top() + end; y++)
+        {
             if (!this->_run)
-            {
-                emit this->stopped();
                 return;
-            }
+
+            // Rows above and below, clamped to the edge of the map
+            double const *top = values + (size_t)std::max(0, y - 1) * width;
+            double const *row = values + (size_t)y * width;
+            double const *bottom =
+                values + (size_t)std::min(height - 1, y + 1) * width;
+
+            QRgba64 *line = (QRgba64 *)(bits + (size_t)y * stride);
+
+            auto edge = [&](int x) {
+                int l = std::max(0, x - 1);
+                int r = std::min(width - 1, x + 1);
+                line[x] = normalColor(top[l] * STRENGTH,
+                                      top[x] * STRENGTH,
+                                      top[r] * STRENGTH,
+                                      row[l] * STRENGTH,
+                                      row[r] * STRENGTH,
+                                      bottom[l] * STRENGTH,
+                                      bottom[x] * STRENGTH,
+                                      bottom[r] * STRENGTH);
+            };
+
+            if (left == 0)
+                edge(0);
+            int last_x = std::min(width - 2, right);
+            for (int x = std::max(1, left); x <= last_x; x++)
+                line[x] = normalColor(top[x - 1] * STRENGTH,
+                                      top[x] * STRENGTH,
+                                      top[x + 1] * STRENGTH,
+                                      row[x - 1] * STRENGTH,
+                                      row[x + 1] * STRENGTH,
+                                      bottom[x - 1] * STRENGTH,
+                                      bottom[x] * STRENGTH,
+                                      bottom[x + 1] * STRENGTH);
+            if (right == width - 1 && width > 1)
+                edge(width - 1);
+
+            // Only report when the percentage changes
+            int perc = (int)round(100.0f * (float)++rows_done
+                                  / (float)region.height());
+            int last = last_perc.load();
+            if (perc > last && last_perc.compare_exchange_strong(last, perc))
+                emit this->progress(perc);
         }
-    }
-    emit this->done(normal);
-}
+    });
 
-/**
- * stop @slot
- * 
- * Sets the run flag to stop to interupt any further work during generate
- */
-void NormalWorker::stop()
-{
     if (!this->_run)
+    {
         emit this->stopped();
-    this->_run = false;
+        return;
+    }
+
+    this->_previous_heights = heights;
+    this->_previous_normal = normal;
+    emit this->done(normal, region);
 }
 
 /**
- * _getHeightIntensity
+ * _changed
  * 
- * Helper function to get a specific intensity at an index and if it goes beyond
- * the bounds it truncates to the nearest pixel value.
+ * Finds the pixels that differ from the height map of the previous
+ * generation (of the same size).
  * 
- * @param int x : The column.
- * @param int y : The row.
- * @param IntensityMap* map : The map to get a value from.
+ * @param std::vector<double>& heights : The values of the new height map.
+ * @param int width : The width of the height map.
+ * @param int height : The height of the height map.
  * 
- * @returns double : The resulting intensity.
+ * @returns QRect : The bounding rectangle of the changed pixels (empty when
+ *                  nothing changed).
  */
-double NormalWorker::_getHeightIntensity(int x, int y, IntensityMap *map)
+QRect NormalWorker::_changed(std::vector<double> &heights,
+                             int width,
+                             int height)
 {
-    if (x < 0)
-        x = 0;
-    else if (x >= map->width)
-        x = map->width - 1;
-    if (y < 0)
-        y = 0;
-    else if (y >= map->height)
-        y = map->height - 1;
+    double const *previous = this->_previous_heights.data();
+    double const *current = heights.data();
+
+    QMutex mutex;
+    QRect changed;
+
+    parallelRows(height, [&](int start, int end) {
+        int min_x = width;
+        int max_x = -1;
+        int min_y = height;
+        int max_y = -1;
+        for (int y = start; y < end; y++)
+        {
+            size_t row = (size_t)y * width;
+            for (int x = 0; x < width; x++)
+            {
+                if (previous[row + x] != current[row + x])
+                {
+                    min_x = std::min(min_x, x);
+                    max_x = std::max(max_x, x);
+                    min_y = std::min(min_y, y);
+                    max_y = std::max(max_y, y);
+                }
+            }
+        }
 
+        if (max_x < 0)
+            return;
 
-    double height = map->at(x, y);
+        QMutexLocker lock(&mutex);
+        changed = changed.united(QRect(QPoint(min_x, min_y),
+                                       QPoint(max_x, max_y)));
+    });
 
-    double strength = 25.00;
-    return height * strength;
+    return changed;
+}
+
+/**
+ * stop @slot
+ * 
+ * Sets the run flag to stop to interupt any further work during generate
+ */
+void NormalWorker::stop()
+{
+    if (!this->_run)
+        emit this->stopped();
+    this->_run = false;
 }
 
 /******************************************************************************
@@ -244,7 +389,7 @@ void NormalMapGenerator::generate()
         QMetaObject::invokeMethod(this->_worker, "stop", Qt::QueuedConnection);
     }
 
-    this->_worker->set(&this->_height_map);
+    this->_worker->set(this->_height_map);
     QMetaObject::invokeMethod(this->_worker, "generate", Qt::QueuedConnection);
 }
 
@@ -255,13 +400,16 @@ void NormalMapGenerator::generate()
  * Called when the generation by the worker object has completed the normal map.
  * 
  * @param QImage const& normal_map : The generated normal map.
+ * @param QRect const& region : The area that changed.
  * 
  * @signals done
  */
-void NormalMapGenerator::normalDone(QImage const &normal_map)
+void NormalMapGenerator::normalDone(QImage const &normal_map,
+                                    QRect const &region)
 {
     qInfo("Generation of normal map complete");
     this->_normal_map = normal_map;
+    this->_region = region;
     emit this->done();
 }
 
@@ -275,4 +423,17 @@ void NormalMapGenerator::normalDone(QImage const &normal_map)
 QImage NormalMapGenerator::toImage()
 {
     return this->_normal_map;
+}
+
+/**
+ * region
+ * 
+ * Returns the area of the normal map that changed with the last generation,
+ * the whole map when it was generated from scratch.
+ * 
+ * @returns QRect : The changed area (empty if nothing changed).
+ */
+QRect NormalMapGenerator::region()
+{
+    return this->_region;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <QImage>
 #include <QMutex>
 #include <QObject>
+#include <QRect>
 #include <QThread>
 
 #include <glm/mat3x3.hpp>
@@ -22,9 +23,8 @@ class NormalWorker : public QObject
 {
     Q_OBJECT
 public:
-    // Set variables that are needed, must be called after the worker is in a
-    // different thread
-    void set(IntensityMap *height_map);
+    // Set the height map to generate from (copied)
+    void set(IntensityMap height_map);
 
 public slots:
     // Generate the normal map
@@ -37,13 +37,19 @@ signals:
     // Progress updates
     void started();
     void progress(int perc);
-    void done(QImage const &normal_map);
+    void done(QImage const &normal_map, QRect const &region);
     void stopped();
 
 private:
-    // Helper function
-    double _getHeightIntensity(int x, int y, IntensityMap *map);
-    IntensityMap *_height_map = nullptr;
+    // Area that differs from the previous height map
+    QRect _changed(std::vector<double> &heights, int width, int height);
+
+    IntensityMap _height_map;
+    QMutex _mutex;
+
+    // Height values and normal map of the last completed generation
+    std::vector<double> _previous_heights;
+    QImage _previous_normal;
 
     // Flag for interuption
     bool _run = false;
@@ -75,6 +81,9 @@ public:
     // Get the generated normal map image
     QImage toImage();
 
+    // Get the area that changed with the last generation
+    QRect region();
+
 signals:
     // Progress signals.
     void done();
@@ -82,7 +91,7 @@ signals:
     void started();
 
 public slots:
-    void normalDone(QImage const &normal_map);
+    void normalDone(QImage const &normal_map, QRect const &region);
 
 private:
     // Normal map size
@@ -96,6 +105,7 @@ private:
 
     // The resulting normal map.
     QImage _normal_map;
+    QRect _region;
 
     // The input height map
     IntensityMap _height_map;
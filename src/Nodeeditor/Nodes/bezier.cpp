@@ -4,6 +4,8 @@
 #include <QJsonArray>
 #include <QJsonObject>
 
+#include "Globals/parallel.h"
+
 /**
  * ConverterBezierCurveNode
  * 
@@ -13,6 +15,7 @@ ConverterBezierCurveNode::ConverterBezierCurveNode()
 {
     this->_widget = new BezierEditWidget();
     this->_shared_widget = new BezierEditWidget();
+    this->_lookup = BezierLookup(this->_widget->save());
 }
 
 /**
@@ -27,7 +30,9 @@ void ConverterBezierCurveNode::created()
     QObject::connect(this->_widget, &BezierEditWidget::curveChanged, [this]() {
         Q_CHECK_PTR(this->_widget);
         Q_CHECK_PTR(this->_shared_widget);
-        this->_shared_widget->restore(this->_widget->save());
+        std::vector<QPointF> points = this->_widget->save();
+        this->_shared_widget->restore(points);
+        this->_lookup = BezierLookup(points);
         if (this->_set)
         {
             this->_generate();
@@ -40,7 +45,9 @@ void ConverterBezierCurveNode::created()
     {
         Q_CHECK_PTR(this->_widget);
         Q_CHECK_PTR(this->_shared_widget);
-        this->_widget->restore(this->_shared_widget->save());
+        std::vector<QPointF> points = this->_shared_widget->save();
+        this->_widget->restore(points);
+        this->_lookup = BezierLookup(points);
         if (this->_set)
         {
             this->_generate();
@@ -206,6 +213,7 @@ void ConverterBezierCurveNode::restore(QJsonObject const &data)
 
     this->_widget->restore(save_data);
     this->_shared_widget->restore(save_data);
+    this->_lookup = BezierLookup(this->_widget->save());
 }
 
 /**
@@ -252,28 +260,33 @@ void ConverterBezierCurveNode::setInData(
 /**
  * _generate
  * 
- * Generates the output data from the supplied and available data.
+ * Generates the output data from the supplied and available data. The curve is
+ * read from the lookup table, the widget is not used.
  * 
  * @signals dataUpdated
  */
 void ConverterBezierCurveNode::_generate()
 {
     Q_CHECK_PTR(this->_input);
-    Q_CHECK_PTR(this->_widget);
     IntensityMap map = this->_input->intensityMap();
 
     if (map.usingFill())
     {
-        double v = this->_widget->valueAt(map.at(0, 0));
+        double v = this->_lookup.value(map.at(0, 0));
         this->_output = IntensityMap(map.width, map.height, v);
     }
     else
     {
         this->_output = IntensityMap(map.width, map.height);
-        
-        for (int y = 0; y < map.height; y++)
-            for (int x = 0; x < map.width; x++)
-                this->_output.append(this->_widget->valueAt(map.at(x, y)));
+        this->_output.values.resize((size_t)map.width * (size_t)map.height);
+
+        parallelRows(map.height, [&](int start, int end) {
+            for (int y = start; y < end; y++)
+                for (int x = 0; x < map.width; x++)
+                    this->_output.values[y * map.width + x] =
+                        this->_lookup.value(map.at(x, y));
+        });
+        this->_output.invalidate();
     }
 
     emit this->dataUpdated(0);
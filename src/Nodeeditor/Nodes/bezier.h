@@ -8,6 +8,7 @@
 
 #include "../Datatypes/intensitymap.h"
 #include "../Datatypes/pixmap.h"
+#include "./BezierCurveWidget/bezierlookup.h"
 #include "./BezierCurveWidget/bezierwidget.h"
 
 #include "node.h"
@@ -20,8 +21,8 @@
  * 
  * Converts an intensity map value x into a new intensity value x' with a
  * function f(x) that is defined by a series of curves and slopes created in the
- * widget. The x value is calculated via finding the vertical line intercept on
- * the line segments of the slopes.
+ * widget. The curve is sampled into a lookup table whenever it is edited, each
+ * value is then transformed with an interpolated table read.
  */
 class ConverterBezierCurveNode : public Node
 {
@@ -78,6 +79,9 @@ private:
 
     bool _set = false;
 
+    // The curve sampled for transforming values
+    BezierLookup _lookup;
+
     BezierEditWidget *_widget;
     BezierEditWidget *_shared_widget;
 };
\ No newline at end of file
@@ -1,161 +1,20 @@
 #include "erosion.h"
 
-#include <math.h>
-#include <random>
+#include <algorithm>
 
+#include <QComboBox>
 #include <QDebug>
 #include <QDoubleSpinBox>
+#include <QFile>
+#include <QFuture>
 #include <QPushButton>
 #include <QSpinBox>
-#include <QThread>
+#include <QtConcurrent>
 
-#include <glm/vec2.hpp>
+#include "Globals/settings.h"
 
-/**
- * mix
- * 
- * Interpolates a value between a range using a percentage value.
- * 
- * @param double x : The start value.
- * @param double y : The end value.
- * @param double a : The percentage value between x and y.
- * 
- * @returns double : The interpolated value.
- */
-static double mix(double x, double y, double a)
-{
-    return x * (1.00 - a) + y * a;
-}
-
-/**
- * biLinearMix
- * 
- * Bilinear interpolation between four values and two percentages. Applies 
- * mix(a, b, x), mix(c, d, x) and then mixes the result with y. See above mix
- * function. Used for interpolating a value in between four pixels.
- * 
- * @param double a : The first value to use (a - b).
- * @param double b : The second value to use (a - b).
- * @param double c : The third value to use (c - d).
- * @param double d : The fourth value to use (c - d).
- * @param double x : The interpolation percentage for (a - b) and (c - d).
- * @param double y : The interpolation percentage for the result from
- *                   interpolating (a - b) and (c - d).
- * 
- * @returns double : The resulting interpolated value.
- */
-static double biLinearMix(double a,
-                          double b,
-                          double c,
-                          double d,
-                          double x,
-                          double y)
-{
-    return mix(mix(a, b, x), mix(c, d, x), y);
-}
-
-/**
- * height
- * 
- * Get the height at a position on the map. Uses bilinear interpolation to get
- * the value for between pixels.
- * 
- * @param IntensityMap *map : The map to get value from.
- * @param double x : The x position to get.
- * @param double y : The y position to get.
- * 
- * @returns double : The interpolated height
- */
-static double height(IntensityMap *map, double x, double y)
-{
-    int x_0 = (int)floor(x);
-    int y_0 = (int)floor(y);
-
-    double xp = x - floor(x);
-    double yp = y - floor(y);
-
-    return biLinearMix(map->at(x_0, y_0, true),
-                       map->at(x_0 + 1, y_0, true),
-                       map->at(x_0, y_0 + 1, true),
-                       map->at(x_0 + 1, y_0 + 1, true),
-                       xp, yp);
-}
-
-/**
- * interpolateAdd
- * 
- * Helper function that adds a value to a map using interpolation for values
- * between pixels.
- * 
- * @param IntensityMap *map : The map to affect.
- * @param double x : The x position to affect.
- * @param double y : The y position to affect.
- * @param double v : The value to place into the map.
- */
-static void interpolateAdd(IntensityMap *map, double x, double y, double v)
-{
-    int x_0 = (int)floor(x);
-    int y_0 = (int)floor(y);
-
-    double xp = x - floor(x);
-    double yp = y - floor(y);
-    double xp_1 = 1.00 - xp;
-    double yp_1 = 1.00 - yp;
-
-    map->set(x_0, y_0, map->at(x_0, y_0, true) + v * xp_1 * yp_1);
-    map->set(x_0 + 1, y_0, map->at(x_0 + 1, y_0, true) + v * xp * yp_1);
-    map->set(x_0, y_0 + 1, map->at(x_0, y_0 + 1, true) + v * xp_1 * yp);
-    map->set(x_0 + 1, y_0 + 1, map->at(x_0 + 1, y_0 + 1, true) + v * xp * yp);
-}
-
-/**
- * clamp
- * 
- * Clamps an input value between a low and high value. f(x) -> l <= x <= h
- * 
- * @param int x : The value to clamp.
- * @param int l : The low value.
- * @param int h : The high value.
- * 
- * @returns int : The clamped value.
- */
-static int clamp(int x, int l, int h)
-{
-    return std::min(h, std::max(l, x));
-}
-
-/**
- * gradient
- * 
- * Obtain the direction (x, y) of greatest descent, the -gradient. The value is
- * calculated using linear interpolation to get appropriate heights between
- * pixels.
- * 
- * @param IntensityMap *map : The height map.
- * @param double x : The x position to get
- * @param double y : The y position to get
- * 
- * @returns glm::dvec2 : The direction of greatest descent
- */
-static glm::dvec2 gradient(IntensityMap *map, double x, double y)
-{
-    int x_0 = (int)floor(x);
-    int y_0 = (int)floor(y);
-
-    double xp = x - floor(x);
-    double yp = y - floor(y);
-
-    // Interpolate left/right positions
-    double r = mix(map->at(x_0 + 1, y_0 - 1), map->at(x_0 + 1, y_0 + 1), yp);
-    double l = mix(map->at(x_0 - 1, y_0 - 1), map->at(x_0 - 1, y_0 + 1), yp);
-
-    // Interpolate top/bottom positions
-    double t = mix(map->at(x_0 - 1, y_0 + 1), map->at(x_0 - 1, y_0 + 1), xp);
-    double b = mix(map->at(x_0 - 1, y_0 - 1), map->at(x_0 - 1, y_0 - 1), xp);
-
-    // Get the descent
-    return glm::dvec2( 0.5 * (l - r), 0.5 * (t - b));
-}
+// Milliseconds between checkpoints saved to disk during long simulations
+#define SNAPSHOT_INTERVAL 30000
 
 /**
  * ConverterErosionNode
@@ -225,6 +84,30 @@ void ConverterErosionNode::created()
                          this->_generate();
                      });
 
+    QObject::connect(this->_ui.spin_seed,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_seed = value;
+                         this->_shared_ui.spin_seed->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_ui.spin_steps,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_steps = value;
+                         this->_shared_ui.spin_steps->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_ui.combo_mode,
+                     QOverload<int>::of(&QComboBox::currentIndexChanged),
+                     [this](int index) {
+                         this->_mode = (ConverterErosionNode::Mode)index;
+                         this->_shared_ui.combo_mode->setCurrentIndex(index);
+                         this->_generate();
+                     });
+
     QObject::connect(this->_shared_ui.spin_inertia,
                      QOverload<double>::of(&QDoubleSpinBox::valueChanged),
                      [this](double value) {
@@ -272,6 +155,30 @@ void ConverterErosionNode::created()
                          this->_ui.spin_life->setValue(value);
                          this->_generate();
                      });
+
+    QObject::connect(this->_shared_ui.spin_seed,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_seed = value;
+                         this->_ui.spin_seed->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_steps,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_steps = value;
+                         this->_ui.spin_steps->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.combo_mode,
+                     QOverload<int>::of(&QComboBox::currentIndexChanged),
+                     [this](int index) {
+                         this->_mode = (ConverterErosionNode::Mode)index;
+                         this->_ui.combo_mode->setCurrentIndex(index);
+                         this->_generate();
+                     });
 }
 
 /**
@@ -394,6 +301,7 @@ void ConverterErosionNode::setInData(
     if (node_data && (this->_input = std::dynamic_pointer_cast<IntensityMapData>(node_data)))
     {
         this->_set = true;
+        this->_input_hash.clear();
 
         this->_generate();
     }
@@ -414,6 +322,59 @@ void ConverterErosionNode::inputConnectionDeleted(
     emit this->dataUpdated(0);
 }
 
+/**
+ * outputConnectionCreated @slot
+ * 
+ * Called when an output connection is created. The sediment and erosion maps
+ * are only simulated while they are connected, the first connection to either
+ * regenerates the output.
+ * 
+ * @param QtNodes::Connection const& connection : The connection being created.
+ */
+void ConverterErosionNode::outputConnectionCreated(
+    QtNodes::Connection const &connection)
+{
+    switch (connection.getPortIndex(QtNodes::PortType::Out))
+    {
+    case 1:
+        if (this->_sediment_connections++ == 0)
+            this->_generate();
+        break;
+    case 2:
+        if (this->_erosion_connections++ == 0)
+            this->_generate();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * outputConnectionDeleted @slot
+ * 
+ * Called when an output connection is deleted, stops simulating the sediment
+ * and erosion maps when nothing is connected to them.
+ * 
+ * @param QtNodes::Connection const& connection : The connection being deleted.
+ */
+void ConverterErosionNode::outputConnectionDeleted(
+    QtNodes::Connection const &connection)
+{
+    switch (connection.getPortIndex(QtNodes::PortType::Out))
+    {
+    case 1:
+        this->_sediment_connections =
+            std::max(0, this->_sediment_connections - 1);
+        break;
+    case 2:
+        this->_erosion_connections =
+            std::max(0, this->_erosion_connections - 1);
+        break;
+    default:
+        break;
+    }
+}
+
 /**
  * save
  * 
@@ -427,6 +388,15 @@ QJsonObject ConverterErosionNode::save() const
     qDebug("Saving erosion node");
     QJsonObject data;
     data["name"] = this->name();
+    data["iterations"] = this->_iterations;
+    data["life"] = this->_max_drop_life;
+    data["inertia"] = this->_inertia;
+    data["radius"] = this->_erosion_radius;
+    data["evaporation"] = this->_evaporation_rate;
+    data["smooth"] = this->_smooth_strength;
+    data["seed"] = this->_seed;
+    data["mode"] = (int)this->_mode;
+    data["steps"] = this->_steps;
 
     return data;
 }
@@ -440,8 +410,43 @@ QJsonObject ConverterErosionNode::save() const
  */
 void ConverterErosionNode::restore(QJsonObject const &data)
 {
-    Q_UNUSED(data);
     qDebug("Restoring erosion node");
+    this->_iterations = data["iterations"].toInt(this->_iterations);
+    this->_max_drop_life = data["life"].toInt(this->_max_drop_life);
+    this->_inertia = data["inertia"].toDouble(this->_inertia);
+    this->_erosion_radius = data["radius"].toDouble(this->_erosion_radius);
+    this->_evaporation_rate =
+        data["evaporation"].toDouble(this->_evaporation_rate);
+    this->_smooth_strength = data["smooth"].toDouble(this->_smooth_strength);
+    this->_seed = data["seed"].toInt(this->_seed);
+    this->_mode = (ConverterErosionNode::Mode)data["mode"].toInt(this->_mode);
+    if (this->_mode < ConverterErosionNode::SEQUENTIAL
+        || this->_mode > ConverterErosionNode::MULTIGRID)
+        this->_mode = ConverterErosionNode::SEQUENTIAL;
+    this->_steps = data["steps"].toInt(this->_steps);
+
+    // Update ui
+    this->_ui.spin_iterations->setValue(this->_iterations);
+    this->_ui.spin_life->setValue(this->_max_drop_life);
+    this->_ui.spin_inertia->setValue(this->_inertia);
+    this->_ui.spin_radius->setValue(this->_erosion_radius);
+    this->_ui.spin_evaporation->setValue(this->_evaporation_rate);
+    this->_ui.spin_smooth->setValue(this->_smooth_strength);
+    this->_ui.spin_seed->setValue(this->_seed);
+    this->_ui.combo_mode->setCurrentIndex((int)this->_mode);
+    this->_ui.spin_steps->setValue(this->_steps);
+
+    this->_shared_ui.spin_iterations->setValue(this->_iterations);
+    this->_shared_ui.spin_life->setValue(this->_max_drop_life);
+    this->_shared_ui.spin_inertia->setValue(this->_inertia);
+    this->_shared_ui.spin_radius->setValue(this->_erosion_radius);
+    this->_shared_ui.spin_evaporation->setValue(this->_evaporation_rate);
+    this->_shared_ui.spin_smooth->setValue(this->_smooth_strength);
+    this->_shared_ui.spin_seed->setValue(this->_seed);
+    this->_shared_ui.combo_mode->setCurrentIndex((int)this->_mode);
+    this->_shared_ui.spin_steps->setValue(this->_steps);
+
+    this->_generate();
 }
 
 /**
@@ -474,62 +479,216 @@ ConverterErosionNode::outData(QtNodes::PortIndex port)
 }
 
 /**
- * _smooth
+ * _parameters
+ * 
+ * Collects the simulation constants for the erosion simulation.
+ * 
+ * @returns DropletParameters : The simulation constants.
+ */
+DropletParameters ConverterErosionNode::_parameters() const
+{
+    DropletParameters parameters;
+    parameters.max_drop_life = this->_max_drop_life;
+    parameters.inertia = this->_inertia;
+    parameters.sediment_capacity = this->_sediment_capacity;
+    parameters.min_sediment_capacity = this->_min_sediment_capacity;
+    parameters.deposit_speed = this->_deposit_speed;
+    parameters.erosion_speed = this->_erosion_speed;
+    parameters.erosion_radius = this->_erosion_radius;
+    parameters.g = this->_g;
+    parameters.evaporation_rate = this->_evaporation_rate;
+    parameters.smooth_strength = this->_smooth_strength;
+    parameters.seed = (unsigned int)this->_seed;
+    return parameters;
+}
+
+/**
+ * _pipeParameters
+ * 
+ * Collects the simulation constants for the grid erosion simulation. The
+ * droplet constants that have a counterpart in the grid model are shared.
+ * 
+ * @returns PipeParameters : The simulation constants.
+ */
+PipeParameters ConverterErosionNode::_pipeParameters() const
+{
+    PipeParameters parameters;
+    parameters.sediment_capacity = this->_sediment_capacity;
+    parameters.evaporation_rate = this->_evaporation_rate;
+    return parameters;
+}
+
+/**
+ * _checkpointSettings
+ * 
+ * Collects everything that changes the result of the droplet simulation other
+ * than the number of droplets, used for the checkpoint key.
+ * 
+ * @param bool sediment : Whether the sediment map is tracked.
+ * @param bool erosion : Whether the erosion map is tracked.
+ * 
+ * @returns QJsonObject : The settings.
+ */
+QJsonObject ConverterErosionNode::_checkpointSettings(bool sediment,
+                                                      bool erosion) const
+{
+    DropletParameters parameters = this->_parameters();
+
+    QJsonObject settings;
+    settings["life"] = parameters.max_drop_life;
+    settings["inertia"] = parameters.inertia;
+    settings["capacity"] = parameters.sediment_capacity;
+    settings["min_capacity"] = parameters.min_sediment_capacity;
+    settings["deposit"] = parameters.deposit_speed;
+    settings["erode"] = parameters.erosion_speed;
+    settings["radius"] = parameters.erosion_radius;
+    settings["g"] = parameters.g;
+    settings["evaporation"] = parameters.evaporation_rate;
+    settings["smooth"] = parameters.smooth_strength;
+    settings["seed"] = (qint64)parameters.seed;
+    settings["mode"] = (int)this->_mode;
+    settings["sediment"] = sediment;
+    settings["erosion"] = erosion;
+
+    return settings;
+}
+
+/**
+ * _simulate
  * 
- * Applies a smoothing function (kernel) to a pixel at a specific point.
- * Used during the sediment placement process as there is some heavy
- * artifacting. Interesting side effect of this function the way it is, is the
- * changing of the smooth value effects an intensity of the erosion effect.
+ * Simulates a chunk of droplets with the selected mode. Every chunk uses its
+ * own seed so chunks can be simulated separately (see ErosionCheckpoint).
  * 
- * @param int x : The x pixel to smooth.
- * @param int y : The y pixel to smooth.
+ * @param IntensityMap* height : The height map, eroded in place.
+ * @param IntensityMap* sediment : Accumulated deposits, may be nullptr.
+ * @param IntensityMap* erosion : Accumulated erosion, may be nullptr.
+ * @param int droplets : The number of droplets to simulate.
+ * @param int chunk : The chunk being simulated.
+ */
+void ConverterErosionNode::_simulate(IntensityMap *height,
+                                     IntensityMap *sediment,
+                                     IntensityMap *erosion,
+                                     int droplets,
+                                     int chunk)
+{
+    DropletParameters parameters = this->_parameters();
+    parameters.seed = ErosionCheckpoint::chunkSeed(parameters.seed, chunk);
+
+    HydraulicErosion simulation(parameters);
+
+    switch (this->_mode)
+    {
+    case ConverterErosionNode::SEQUENTIAL:
+        simulation.run(height, sediment, erosion, droplets);
+        break;
+    case ConverterErosionNode::TILED:
+        simulation.runTiled(height, sediment, erosion, droplets);
+        break;
+    case ConverterErosionNode::MULTIGRID:
+        simulation.runMultigrid(height,
+                                sediment,
+                                erosion,
+                                droplets,
+                                SETTINGS->previewResolution());
+        break;
+    default:
+        Q_UNREACHABLE();
+        break;
+    }
+}
+
+/**
+ * _resume
+ * 
+ * Brings the checkpoint up to the last whole chunk of the iterations. When the
+ * input and settings are unchanged the simulation continues from the current
+ * checkpoint, otherwise from a checkpoint saved to disk by an earlier
+ * (interrupted) simulation, or from the start. While simulating, the
+ * checkpoint is saved to disk every SNAPSHOT_INTERVAL, the file is deleted
+ * once the simulation is done and older files are pruned to the cache limit.
+ * 
+ * @param IntensityMap& input : The input height map.
+ * @param bool sediment : Whether to track the sediment map.
+ * @param bool erosion : Whether to track the erosion map.
  */
-void ConverterErosionNode::_smooth(int x, int y)
+void ConverterErosionNode::_resume(IntensityMap &input,
+                                   bool sediment,
+                                   bool erosion)
 {
-    // Simple smoothing kernel
-    static double K[3][3] = {
-        {1.00, 4.00, 1.00},
-        {4.00, this->_smooth_strength + 20.00, 4.00},
-        {1.00, 4.00, 1.00}};
-
-    // Averaging value
-    double div = this->_smooth_strength + 40.00;
-
-    // Compensation for edge values
-    if (x <= 0 || x >= this->_output.width - 1)
-        div -= 6.00;
-
-    if (y <= 0 || y >= this->_output.height - 1)
-        div -= 6.00;
-
-    if ((x <= 0 || x >= this->_output.width - 1)
-        && (y <= 0 || y >= this->_output.height - 1))
-        div += 1.00;
-
-    // Get pixels to smooth with
-    double M[3][3] = {
-        {this->_output.at(x - 1, y - 1),
-         this->_output.at(x, y - 1),
-         this->_output.at(x + 1, y - 1)},
-        {this->_output.at(x - 1, y),
-         this->_output.at(x, y),
-         this->_output.at(x + 1, y)},
-        {this->_output.at(x - 1, y + 1),
-         this->_output.at(x, y + 1),
-         this->_output.at(x + 1, y + 1)}};
-
-    // Apply smoothing
-    double v = M[0][0] * K[0][0] + M[1][0] * K[1][0] + M[2][0] * K[2][0]
-             + M[0][1] * K[0][1] + M[1][1] * K[1][1] + M[2][1] * K[2][1]
-             + M[0][2] * K[0][2] + M[1][2] * K[1][2] + M[2][2] * K[2][2];
-
-    this->_output.set(x, y, v / div);
+    // Hashing the input takes a while on large maps, it is only hashed again
+    // once the input changes
+    if (this->_input_hash.isEmpty())
+        this->_input_hash = ErosionCheckpoint::hashMap(input);
+
+    QByteArray key =
+        ErosionCheckpoint::createKey(this->_input_hash,
+                                     this->_checkpointSettings(sediment,
+                                                               erosion));
+
+    int chunks = this->_iterations / ErosionCheckpoint::CHUNK;
+
+    QDir cache = SETTINGS->cacheDir();
+    QString path = ErosionCheckpoint::path(cache, key);
+
+    ErosionCheckpoint &checkpoint = this->_checkpoint;
+
+    // Input or settings changed, or fewer droplets, start over
+    if (checkpoint.key != key || checkpoint.chunks > chunks)
+    {
+        // Nothing continues the previous simulation any more
+        if (checkpoint.valid() && checkpoint.key != key)
+            QFile::remove(ErosionCheckpoint::path(cache, checkpoint.key));
+
+        ErosionCheckpoint saved;
+        if (chunks > 0 && saved.load(path, key) && saved.chunks <= chunks)
+            checkpoint = saved;
+        else
+            checkpoint = ErosionCheckpoint(key, input);
+    }
+
+    QFuture<void> writing;
+    checkpoint.advance(
+        chunks,
+        sediment,
+        erosion,
+        [this](IntensityMap *height,
+               IntensityMap *deposits,
+               IntensityMap *eroded,
+               int chunk) {
+            this->_simulate(height,
+                            deposits,
+                            eroded,
+                            ErosionCheckpoint::CHUNK,
+                            chunk);
+        },
+        [&checkpoint, &writing, cache, path]() {
+            // Writing a large checkpoint takes seconds, a copy is written in
+            // the background while the simulation continues
+            writing.waitForFinished();
+            writing = QtConcurrent::run([copy = checkpoint, cache, path]()
+                                            mutable {
+                if (copy.save(path))
+                    ErosionCheckpoint::prune(cache,
+                                             ErosionCheckpoint::CACHE_LIMIT,
+                                             path);
+            });
+        },
+        SNAPSHOT_INTERVAL);
+
+    // Done, the checkpoint in memory continues from here
+    writing.waitForFinished();
+    QFile::remove(path);
 }
 
 /**
  * _generate
  * 
- * Generates the output data from the supplied and available data.
+ * Generates the output data from the supplied and available data. The droplet
+ * modes continue from the checkpoint of the whole chunks of droplets and only
+ * simulate the remaining droplets, so adding iterations does not simulate the
+ * earlier droplets again. The multigrid mode runs a whole coarse to fine cycle
+ * over all of the droplets, split into chunks every chunk would run its own
+ * cycle and change the result, so it always simulates from the start.
  * 
  * @signals dataUpdated
  */
@@ -539,158 +698,61 @@ void ConverterErosionNode::_generate()
         return;
 
     Q_CHECK_PTR(this->_input);
-    this->_output = this->_input->intensityMap();
-
-    this->_sediment =
-        IntensityMap(this->_output.width, this->_output.height, 0.00);
-        
-    this->_erosion =
-        IntensityMap(this->_output.width, this->_output.height, 0.00);
-
-    // Generate a random distribution of rain drops
-    std::default_random_engine gen;
+    IntensityMap input = this->_input->intensityMap();
 
-    std::uniform_real_distribution<double>
-        distrib_x(0.00, (double)this->_output.width - 1.00);
+    // Only track the debug maps when something uses them
+    bool track_sediment = this->_sediment_connections > 0;
+    bool track_erosion = this->_erosion_connections > 0;
 
-    std::uniform_real_distribution<double>
-        distrib_y(0.00, (double)this->_output.height - 1.00);
+    IntensityMap *sediment = track_sediment ? &this->_sediment : nullptr;
+    IntensityMap *erosion = track_erosion ? &this->_erosion : nullptr;
 
-    // Erosion radius distance, for rounding erosion distance from point
-    double r = sqrt(2.00 * this->_erosion_radius * this->_erosion_radius);
-
-    // Generate _iterations number of rain drops
-    for (int i = 0; i < this->_iterations; i++)
+    if (this->_mode == ConverterErosionNode::GRID
+        || this->_mode == ConverterErosionNode::MULTIGRID)
     {
-        // Setup default values
-        double dir_x = 0.00;
-        double dir_y = 0.00;
-
-        // Random raindrop location
-        // TODO: Add a rainmap (intensity map) that affects water value
-        double pos_x = distrib_x(gen);
-        double pos_y = distrib_y(gen);
+        // Not checkpointed, release the maps of the droplet simulation
+        this->_checkpoint = ErosionCheckpoint();
 
-        double speed = 1.00;
-        double sediment = 0.00;
-        double water = 1.00;
+        this->_output = input;
+        this->_sediment = IntensityMap(input.width, input.height, 0.00);
+        this->_erosion = IntensityMap(input.width, input.height, 0.00);
 
-        // While the raindrop lives, move, erode, and deposit.
-        for (int l = 0; l < this->_max_drop_life; l++)
+        if (this->_mode == ConverterErosionNode::GRID)
         {
-            // Get the current height
-            double old_height = height(&this->_output, pos_x, pos_y);
-
-            // Get the greatest descent
-            glm::dvec2 grad = gradient(&this->_output, pos_x, pos_y);
-
-            // Update the movement direction with inertia and gradient descent
-            dir_x = dir_x * this->_inertia
-                    - grad.x * (1.00 - this->_inertia);
-
-            dir_y = dir_y * this->_inertia
-                    - grad.y * (1.00 - this->_inertia);
-
-            // Normalize the movement (1 pixel radius distance of movement)
-            double norm = sqrt(dir_x * dir_x + dir_y * dir_y);
-            if (norm != 0.00)
-            {
-                dir_x /= norm;
-                dir_y /= norm;
-            }
-
-            // Update particle position
-            pos_x += dir_x;
-            pos_y += dir_y;
-
-            // Fell off map or stopped moving? Go to next particle
-            if ((dir_x == 0.00 && dir_y == 0.00)
-                || pos_x < 0.00
-                || pos_x > (double)this->_output.width - 1.00
-                || pos_y < 0.00
-                || pos_y > (double)this->_output.height - 1.00)
-                break;
-
-            // Get new position height
-            double new_height = height(&this->_output, pos_x, pos_y);
-
-            // Get the change in height
-            double delta_height = new_height - old_height;
-
-            // Calculate the sediment capacity
-            double sediment_cap =
-                std::max(-delta_height * speed * water
-                         * this->_sediment_capacity,
-                         this->_min_sediment_capacity);
-
-            // If sediment is beyond capacity deposit sediment
-            if (sediment > sediment_cap
-                || delta_height > 0.00
-                || (dir_x == 0.00 && dir_y == 0.00))
-            {
-                // Deposit at most the change in height (prevents holes)
-                double deposit = delta_height > 0.00
-                                 ? std::min(delta_height, sediment)
-                                 : (sediment - sediment_cap)
-                                   * this->_deposit_speed;
-
-                // Update the sediment value
-                sediment -= deposit;
-                    
-                // Place the depositing value onto the map
-                interpolateAdd(&this->_output, pos_x, pos_y, deposit);
-                interpolateAdd(&this->_sediment, pos_x, pos_y, deposit);
-
-                // Smooth particle (apply intensity)
-                this->_smooth((int)round(pos_x), (int)round(pos_y));
-            }
-
-            // Still have capacity for sediment, erode some terrain
-            else
-            {
-                // Get erosion amount
-                double erode = std::min((sediment_cap - sediment)
-                                        * this->_erosion_speed,
-                                        -delta_height);
-
-                // Erode pixels in a radius from position
-                for (double x = -this->_erosion_radius;
-                     x <= this->_erosion_radius;
-                     x += 1.00)
-                {
-                    for (double y = -this->_erosion_radius;
-                         y <= this->_erosion_radius;
-                         y += 1.00)
-                    {
-                        // Reduce erosion the farther away from the point
-                        double strength = std::min(0.001,
-                                            (r - sqrt(x * x + y * y))
-                                            / r * erode);
-
-                        // Update the terrain with erosion
-                        interpolateAdd(&this->_output,
-                                       pos_x + x,
-                                       pos_y + y,
-                                       -strength);
-
-                        interpolateAdd(&this->_erosion,
-                                       pos_x + x,
-                                       pos_y + y,
-                                       -strength);
-                        
-                        // Normally would be 'sediment += strength' however,
-                        // there is an odd problem where sediment is 0,
-                        // strength is some positive number, but sediment
-                        // becomes -strength
-                        sediment = abs(sediment + strength);
-                    }
-                }
-            }
-            // Update the speed of the droplet
-            speed = sqrt(speed * speed + delta_height * this->_g);
-            // Slowly evaporate the water
-            water *= (1.00 - this->_evaporation_rate);
+            PipeErosion grid(this->_pipeParameters());
+            grid.run(&this->_output, sediment, erosion, this->_steps);
         }
+        else
+        {
+            this->_simulate(&this->_output,
+                            sediment,
+                            erosion,
+                            this->_iterations,
+                            0);
+        }
+    }
+    else
+    {
+        this->_resume(input, track_sediment, track_erosion);
+
+        this->_output = this->_checkpoint.height;
+        this->_sediment = this->_checkpoint.sediment;
+        this->_erosion = this->_checkpoint.erosion;
+
+        int remaining = this->_iterations % ErosionCheckpoint::CHUNK;
+        if (remaining > 0)
+            this->_simulate(&this->_output,
+                            sediment,
+                            erosion,
+                            remaining,
+                            this->_checkpoint.chunks);
     }
+
     emit this->dataUpdated(0);
-}
\ No newline at end of file
+
+    if (sediment)
+        emit this->dataUpdated(1);
+
+    if (erosion)
+        emit this->dataUpdated(2);
+}
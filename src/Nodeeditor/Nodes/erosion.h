@@ -21,6 +21,9 @@
 #include "../Datatypes/intensitymap.h"
 #include "../Datatypes/vectormap.h"
 #include "../Datatypes/pixmap.h"
+#include "./Erosion/checkpoint.h"
+#include "./Erosion/hydraulic.h"
+#include "./Erosion/pipe.h"
 #include "node.h"
 
 #include "ui_Erosion.h"
@@ -36,6 +39,15 @@ class ConverterErosionNode : public Node
 {
     Q_OBJECT
 public:
+    // How the erosion is simulated
+    enum Mode
+    {
+        SEQUENTIAL,
+        TILED,
+        GRID,
+        MULTIGRID
+    };
+
     // Create the node
     ConverterErosionNode();
 
@@ -76,9 +88,30 @@ public:
 public slots:
     void inputConnectionDeleted(QtNodes::Connection const &connection);
 
+    // Track whether the sediment and erosion maps are used
+    void outputConnectionCreated(QtNodes::Connection const &connection);
+    void outputConnectionDeleted(QtNodes::Connection const &connection);
+
 private:
     void _generate();
-    void _smooth(int x, int y);
+
+    // Continue the droplet simulation up to the last whole chunk
+    void _resume(IntensityMap &input, bool sediment, bool erosion);
+
+    // Simulate a chunk of droplets with the selected mode
+    void _simulate(IntensityMap *height,
+                   IntensityMap *sediment,
+                   IntensityMap *erosion,
+                   int droplets,
+                   int chunk);
+
+    // Settings that identify a droplet simulation for checkpoints
+    QJsonObject _checkpointSettings(bool sediment, bool erosion) const;
+
+    // Collect the simulation constants
+    DropletParameters _parameters() const;
+    PipeParameters _pipeParameters() const;
+
     IntensityMap _output{1, 1, 1.00};   // Terrain b
     IntensityMap _sediment{1, 1, 0.00}; // Terrain b
     IntensityMap _erosion{1, 1, 0.00}; // Terrain b
@@ -87,6 +120,20 @@ private:
 
     bool _set = false;
 
+    // Droplet simulation state after the last whole chunk of droplets. Kept
+    // in memory so changing the iterations (or the remaining droplets) only
+    // simulates the chunks after it, the file on disk is only for resuming
+    // an interrupted simulation and is deleted once done. The sediment and
+    // erosion maps are fill maps (no pixels) unless they are tracked.
+    ErosionCheckpoint _checkpoint;
+
+    // Hash of the input map for the checkpoint key, cleared on new input
+    QByteArray _input_hash;
+
+    // Connections using the sediment and erosion maps
+    int _sediment_connections = 0;
+    int _erosion_connections = 0;
+
     int _iterations = 10000;
     int _max_drop_life = 200;
 
@@ -100,6 +147,10 @@ private:
     double _evaporation_rate = 0.12;
     double _smooth_strength = 0.10;
 
+    int _seed = 1;
+    int _steps = 200; // Time steps of the grid simulation
+    Mode _mode = ConverterErosionNode::SEQUENTIAL;
+
     Ui::Erosion _ui;
     Ui::Erosion_Scroll _shared_ui;
     QWidget *_widget;
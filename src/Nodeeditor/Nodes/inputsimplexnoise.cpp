@@ -1,5 +1,6 @@
 #include "inputsimplexnoise.h"
 
+#include <atomic>
 #include <math.h>
 
 #include <QColor>
@@ -11,27 +12,103 @@
 #include <glm/vec4.hpp>
 
 #include "../Datatypes/pixmap.h"
+#include "Globals/parallel.h"
 #include "Globals/settings.h"
 
 /******************************************************************************
  *                                 WORKER                                     *
  ******************************************************************************/
 
+// Lacunarity used for each octave, matches the previous SimplexNoise setup
+static const float LACUNARITY = 1.99f;
+
+/**
+ * fractal
+ * 
+ * Fractal simplex noise (fractional brownian motion) with the parameters
+ * provided per call, so each pixel can use its own octives, frequency and
+ * persistence. Matches SimplexNoise::fractal for whole octives, a fractional
+ * octive count blends in the last octave by the fractional amount so that
+ * octives can vary smoothly across a map.
+ * 
+ * @param float octives : The number of octives (levels of detail).
+ * @param float frequency : The frequency of the first octave.
+ * @param float persistence : The amplitude falloff between octaves.
+ * @param float x : The x position.
+ * @param float y : The y position.
+ * @param float z : The z position.
+ * 
+ * @returns float : The noise value in the range [-1, 1].
+ */
+static float fractal(float octives,
+                     float frequency,
+                     float persistence,
+                     float x,
+                     float y,
+                     float z)
+{
+    float output = 0.0f;
+    float denom = 0.0f;
+    float amplitude = 1.0f;
+
+    int whole = (int)floor(octives);
+    float partial = octives - (float)whole;
+
+    for (int i = 0; i <= whole; i++)
+    {
+        float weight = i < whole ? amplitude : amplitude * partial;
+        if (weight <= 0.0f)
+            break;
+
+        output += weight * SimplexNoise::noise(x * frequency,
+                                               y * frequency,
+                                               z * frequency);
+        denom += weight;
+        frequency *= LACUNARITY;
+        amplitude *= persistence;
+    }
+
+    return denom > 0.0f ? output / denom : 0.0f;
+}
+
+/**
+ * sample
+ * 
+ * Samples a parameter map at a pixel of the generated map, the parameter map is
+ * stretched (nearest neighbour) to cover the generated map when the sizes
+ * differ. Solid fill maps return the fill without any lookup.
+ * 
+ * @param IntensityMap& map : The parameter map.
+ * @param int x : The column in the generated map.
+ * @param int y : The row in the generated map.
+ * @param int size : The size of the generated map.
+ * 
+ * @returns float : The parameter value for the pixel.
+ */
+static float sample(IntensityMap &map, int x, int y, int size)
+{
+    if (map.usingFill())
+        return (float)map.at(0, 0);
+
+    return (float)map.at((int)((long long)x * map.width / size),
+                         (int)((long long)y * map.height / size));
+}
+
 /**
  * set
  * 
  * Sets the parameters used by the thread. This should only be set after the
  * worker has been moved to the other thread and the thread started.
  * 
- * @param float octives : The octives parameter.
- * @param float frequency : The frequency parameter.
- * @param float persistence : The persistence parameter.
+ * @param IntensityMap octives : The octives parameter map.
+ * @param IntensityMap frequency : The frequency parameter map.
+ * @param IntensityMap persistence : The persistence parameter map.
  * @param QVector3D offset : The offset parameter.
  * @param IntensityMap* height_map : The height_map parameter.
  */
-void SimplexNoiseWorker::set(float octives,
-                             float frequency,
-                             float persistence,
+void SimplexNoiseWorker::set(IntensityMap octives,
+                             IntensityMap frequency,
+                             IntensityMap persistence,
                              QVector3D offset,
                              IntensityMap *height_map)
 {
@@ -45,7 +122,10 @@ void SimplexNoiseWorker::set(float octives,
 /**
  * generate @slot
  * 
- * Generates the simplex noise in the separate thread.
+ * Generates the simplex noise in the separate thread. Octives, frequency and
+ * persistence are looked up per pixel so connected maps modulate the noise in
+ * the same pass. Rows are split into bands and generated in parallel, each
+ * band writes its own rows of the preallocated height map.
  * 
  * @signals started
  * @signals progress
@@ -55,12 +135,9 @@ void SimplexNoiseWorker::generate()
 {
     emit this->started();
     this->_run = true;
-    SimplexNoise noise(this->_frequency / 1000.0f,
-                       1.0f,
-                       1.99f,
-                       this->_persistence);
     // Create a vector map to house information
     Q_CHECK_PTR(SETTINGS);
+    Q_CHECK_PTR(this->_height_map);
     
     int size;
 
@@ -78,31 +155,52 @@ void SimplexNoiseWorker::generate()
         ratio = render_size / (float)size;
     }
 
-    int i = 0;
-    int total = size * size;
+    *this->_height_map = IntensityMap(size, size);
+    this->_height_map->values.resize((size_t)size * (size_t)size);
+    double *values = this->_height_map->values.data();
 
-    for (int x = 0; x < size; x++)
-    {
-        for (int y = 0; y < size; y++)
+    float offset_x = this->_offset.x() * 25.0f;
+    float offset_y = this->_offset.y() * 25.0f;
+    float offset_z = this->_offset.z() * 25.0f;
+
+    std::atomic<int> rows_done{0};
+    std::atomic<int> last_perc{-1};
+
+    parallelRows(size, [&](int start, int end) {
+        for (int y = start; y < end; y++)
         {
-            // Get a noise value for a specific point
-            float intensity = noise.fractal(
-                this->_octives,
-                (float)x * ratio + this->_offset.x() * 25.0f,
-                (float)y * ratio + this->_offset.y() * 25.0f,
-                this->_offset.z() * 25.0f);
-            // Normalize intensity from [-1, 1] -> [0, 1]
-            intensity = (intensity + 1.0f) / 2.0f;
-            // Save noise in vector map
-            this->_height_map->append(intensity);
-            emit this->progress((int)round(100.0f * (float)i / (float)total));
-            i++;
             if (!this->_run)
-            {
-                emit this->stopped();
                 return;
+
+            double *row = values + (size_t)y * size;
+            for (int x = 0; x < size; x++)
+            {
+                // Noise is sampled with the axes swapped (column major) to
+                // keep the layout of previously generated maps
+                float intensity = fractal(
+                    sample(this->_octives, x, y, size),
+                    sample(this->_frequency, x, y, size) / 1000.0f,
+                    sample(this->_persistence, x, y, size),
+                    (float)y * ratio + offset_x,
+                    (float)x * ratio + offset_y,
+                    offset_z);
+                // Normalize intensity from [-1, 1] -> [0, 1]
+                row[x] = (intensity + 1.0f) / 2.0f;
             }
+
+            // Only report when the percentage changes
+            int perc = (int)round(100.0f * (float)++rows_done / (float)size);
+            int last = last_perc.load();
+            if (perc > last && last_perc.compare_exchange_strong(last, perc))
+                emit this->progress(perc);
         }
+    });
+    this->_height_map->invalidate();
+
+    if (!this->_run)
+    {
+        emit this->stopped();
+        return;
     }
     emit this->done();
 }
@@ -372,27 +470,28 @@ void InputSimplexNoiseNode::_generate()
 {
     qDebug("Generating Noise Map");
 
-    float octives = this->_octives;
-    float frequency = this->_frequency;
-    float persistence = this->_persistence;
+    // Parameters are passed as maps, unconnected inputs use a solid fill
+    IntensityMap octives(1, 1, this->_octives);
+    IntensityMap frequency(1, 1, this->_frequency);
+    IntensityMap persistence(1, 1, this->_persistence);
     QVector3D offset = this->_offset;
 
     if (this->_in_octives_set)
     {
         Q_CHECK_PTR(this->_in_octives);
-        octives = this->_in_octives->intensityMap().at(0, 0);
+        octives = this->_in_octives->intensityMap();
     }
 
     if (this->_in_frequency_set)
     {
         Q_CHECK_PTR(this->_in_frequency);
-        frequency = this->_in_frequency->intensityMap().at(0, 0);
+        frequency = this->_in_frequency->intensityMap();
     }
 
     if (this->_in_persistence_set)
     {
         Q_CHECK_PTR(this->_in_persistence);
-        persistence = this->_in_persistence->intensityMap().at(0, 0);
+        persistence = this->_in_persistence->intensityMap();
     }
 
     if (this->_in_offset_set)
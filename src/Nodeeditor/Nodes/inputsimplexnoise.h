@@ -30,10 +30,11 @@ class SimplexNoiseWorker : public QObject
 {
     Q_OBJECT
 public:
-    // Set any data that is needed, (must be in other thread first)
-    void set(float octives,
-             float frequency,
-             float persistence,
+    // Set any data that is needed, (must be in other thread first). The
+    // parameter maps are sampled per pixel, solid fill maps act as constants
+    void set(IntensityMap octives,
+             IntensityMap frequency,
+             IntensityMap persistence,
              QVector3D offset,
              IntensityMap *height_map);
 
@@ -52,10 +53,10 @@ signals:
     void stopped();
 
 private:
-    // Generation parameters
-    float _octives = 8.0f;
-    float _frequency = 5.0f;
-    float _persistence = 0.5f;
+    // Generation parameters (per pixel)
+    IntensityMap _octives{1, 1, 8.00};
+    IntensityMap _frequency{1, 1, 5.00};
+    IntensityMap _persistence{1, 1, 0.50};
     QVector3D _offset{0.0f, 0.0f, 0.0f};
 
     // Resulting height map
@@ -33,6 +33,7 @@ OutputNode::OutputNode()
     normal.setColor(0, qRgba(128, 128, 255, 255));
     normal.fill(0);
     this->_normal_map = normal;
+    this->_normal_region = normal.rect();
 
     QImage albedo(1, 1, QImage::Format_Indexed8);
     albedo.setColorCount(1);
@@ -45,6 +46,7 @@ OutputNode::OutputNode()
                      [this]()
     {
         this->_normal_map = this->_normal_generator.toImage();
+        this->_normal_region = this->_normal_generator.region();
         emit this->computingFinished();
 
         QPixmap normal_pixmap;
@@ -204,7 +206,7 @@ void OutputNode::setInData(std::shared_ptr<QtNodes::NodeData> node_data,
             {
                 IntensityMap height_map = this->_input->intensityMap();
 
-                this->_height_map = height_map.toImage();
+                this->_height_map = height_map.toHeightImage();
 
                 // Display preview image
                 this->_ui.height_label->setPixmap(
@@ -223,6 +225,7 @@ void OutputNode::setInData(std::shared_ptr<QtNodes::NodeData> node_data,
                 std::dynamic_pointer_cast<VectorMapData>(node_data)))
             {
                 this->_albedo_map = this->_input_albedo->vectorMap().toImage();
+                this->_normal_region = QRect();
                 emit this->computingFinished();
             }
             break;
@@ -263,6 +266,22 @@ QImage OutputNode::getHeightMap()
     return this->_height_map;
 }
 
+/**
+ * getHeightValues
+ * 
+ * Returns the height map values at full precision, a flat map when no height
+ * map is connected.
+ * 
+ * @returns IntensityMap : The height values.
+ */
+IntensityMap OutputNode::getHeightValues()
+{
+    if (this->_input)
+        return this->_input->intensityMap();
+
+    return IntensityMap(1, 1, 0.00);
+}
+
 /**
  * getAlbedoMap
  * 
@@ -275,10 +294,24 @@ QImage OutputNode::getAlbedoMap()
     return this->_albedo_map;
 }
 
+/**
+ * getNormalRegion
+ * 
+ * Returns the area of the normal map that changed with the last update, the
+ * rest of the normal map is the same as before.
+ * 
+ * @returns QRect : The changed area (empty if the normal map did not change).
+ */
+QRect OutputNode::getNormalRegion()
+{
+    return this->_normal_region;
+}
+
 /**
  * _generateNormalMap
  * 
- * Given the height map (intensity map) this will generate the normal map.
+ * Given the height map (intensity map) this will generate the normal map. The
+ * generator only recomputes the area where the height map changed.
  * 
  * @param IntensityMap height_map : The height map.
  * 
@@ -316,6 +349,7 @@ void OutputNode::inputConnectionDeleted(QtNodes::Connection const &connection)
     normal.fill(0);
 
     this->_normal_map = normal;
+    this->_normal_region = normal.rect();
     emit this->computingFinished();
 }
 
@@ -3,6 +3,7 @@
 #include <QLabel>
 #include <QImage>
 #include <QJsonObject>
+#include <QRect>
 
 #include <nodes/NodeDataModel>
 #include <nodes/Connection>
@@ -57,6 +58,12 @@ public:
     QImage getHeightMap();
     QImage getAlbedoMap();
 
+    // Get the height values the height map image was made from
+    IntensityMap getHeightValues();
+
+    // Get the area of the normal map that changed with the last update
+    QRect getNormalRegion();
+
 public slots:
     void inputConnectionDeleted(QtNodes::Connection const &connection);
 
@@ -71,11 +78,12 @@ private:
     // Generator for the normal map
     NormalMapGenerator _normal_generator;
 
-    // Saved height map image
+    // Saved height map image (single channel 16 bit)
     QImage _height_map;
 
     // Houses the generated normal map
     QImage _normal_map;
+    QRect _normal_region;
 
     QImage _albedo_map;
 
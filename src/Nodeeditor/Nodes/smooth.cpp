@@ -1,8 +1,49 @@
 #include "smooth.h"
 
 #include <QDebug>
+#include <QDoubleSpinBox>
 
-#include "Globals/settings.h"
+#include <math.h>
+
+#include "./Convolution/convolution.h"
+
+// Weights of the original 3x3 smoothing kernel (out of 92)
+static const double SMOOTH_CORNER = 5.00;
+static const double SMOOTH_EDGE = 8.00;
+static const double SMOOTH_CENTRE = 40.00;
+
+// Spread of the 3x3 kernel along an axis, sqrt(36 / 92) pixels
+static const double SMOOTH_SIGMA = sqrt(36.00 / 92.00);
+
+/**
+ * smoothKernel
+ *
+ * The original 3x3 smoothing kernel faded in from the pixel on its own, at 0
+ * the map is left as it is and at 1 it is the original kernel.
+ *
+ * @param double strength : How much of the kernel to use (0 to 1).
+ *
+ * @returns IntensityMap : The kernel (adds up to 1).
+ */
+static IntensityMap smoothKernel(double strength)
+{
+    double total = 4.00 * SMOOTH_CORNER + 4.00 * SMOOTH_EDGE + SMOOTH_CENTRE;
+
+    IntensityMap kernel(3, 3);
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            double tap = x == 0 && y == 0   ? SMOOTH_CENTRE
+                         : x == 0 || y == 0 ? SMOOTH_EDGE
+                                            : SMOOTH_CORNER;
+            double identity = x == 0 && y == 0 ? 1.00 : 0.00;
+            kernel.append(strength * tap / total
+                          + (1.00 - strength) * identity);
+        }
+    }
+    return kernel;
+}
 
 /**
  * ConverterSmoothNode
@@ -12,6 +53,34 @@
 ConverterSmoothNode::ConverterSmoothNode()
 {
     qDebug("Creating Smooth Node");
+    this->_widget = new QWidget();
+    this->_shared_widget = new QWidget();
+    this->_ui.setupUi(this->_widget);
+    this->_shared_ui.setupUi(this->_shared_widget);
+}
+
+/**
+ * created
+ * 
+ * Function is called when the node is created so it can connect to listeners.
+ */
+void ConverterSmoothNode::created()
+{
+    QObject::connect(this->_ui.spin_radius,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_radius = value;
+                         this->_shared_ui.spin_radius->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_radius,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_radius = value;
+                         this->_ui.spin_radius->setValue(value);
+                         this->_generate();
+                     });
 }
 
 /**
@@ -42,13 +111,14 @@ QString ConverterSmoothNode::name() const
  * embeddedWidget
  * 
  * Returns a pointer to the widget that gets embedded within the node in the
- * dataflow diagram. (No Widget)
+ * dataflow diagram.
  * 
  * @returns QWidget* : The embedded widget.
  */
 QWidget *ConverterSmoothNode::embeddedWidget()
 {
-    return nullptr;
+    Q_CHECK_PTR(this->_widget);
+    return this->_widget;
 }
 
 /**
@@ -60,7 +130,8 @@ QWidget *ConverterSmoothNode::embeddedWidget()
  */
 QWidget *ConverterSmoothNode::sharedWidget()
 {
-    return nullptr;
+    Q_CHECK_PTR(this->_shared_widget);
+    return this->_shared_widget;
 }
 
 /**
@@ -121,61 +192,30 @@ void ConverterSmoothNode::setInData(std::shared_ptr<QtNodes::NodeData> node_data
 /**
  * _generate
  * 
- * Generates the output data from the supplied and available data.
+ * Generates the output data from the supplied and available data. A radius of
+ * 1 (the default, and saves from before the radius) is the node's original
+ * 3x3 kernel, smaller radii fade it in from the map as it is. Larger radii
+ * blur with a gaussian of the same spread per pixel of radius as the 3x3
+ * kernel. Pixels off the map are ignored, the edges average the pixels within
+ * the map.
  * 
  * @signals dataUpdated
  */
 void ConverterSmoothNode::_generate()
 {
+    if (!this->_set)
+        return;
+
     Q_CHECK_PTR(this->_input);
     IntensityMap map = this->_input->intensityMap();
-    this->_output = IntensityMap(map.width, map.height);
 
-    double cor = this->v;
-    double cen = cor + 3.00;
-    double mid = cen * 5.00;
+    Convolution convolution(Convolution::NORMALIZE);
+    if (this->_radius <= 1.00)
+        this->_output =
+            convolution.direct(map, smoothKernel(qMax(0.00, this->_radius)));
+    else
+        this->_output = convolution.gaussian(map, this->_radius * SMOOTH_SIGMA);
 
-    double K[3][3] = {
-        {cor, cen, cor},
-        {cen, mid, cen},
-        {cor, cen, cor}};
-
-    double line = cen + (2.00 * cor);
-
-    for (int y = 0; y < map.height; y++)
-    {
-        for (int x = 0; x < map.width; x++)
-        {
-            double M[3][3] = {
-                {map.at(x - 1, y - 1), map.at(x, y - 1), map.at(x + 1, y - 1)},
-                {map.at(x - 1, y), map.at(x, y), map.at(x + 1, y)},
-                {map.at(x - 1, y + 1), map.at(x, y + 1), map.at(x + 1, y + 1)}};
-
-            double div = mid + (4.00 * cen) + (4.00 * cor);
-
-            if (x <= 0 || x >= map.width - 1)
-                div -= line;
-
-            if (y <= 0 || y >= map.height - 1)
-                div -= line;
-
-            if ((y <= 0 || y >= map.height - 1)
-                && (x <= 0 || x >= map.width - 1))
-                div += cor;
-
-            double v = (M[0][0] * K[0][0])
-                     + (M[1][0] * K[1][0])
-                     + (M[2][0] * K[2][0])
-                     + (M[0][1] * K[0][1])
-                     + (M[1][1] * K[1][1])
-                     + (M[2][1] * K[2][1])
-                     + (M[0][2] * K[0][2])
-                     + (M[1][2] * K[1][2])
-                     + (M[2][2] * K[2][2]);
-
-            this->_output.append(v / div);
-        }
-    }
     emit this->dataUpdated(0);
 }
 
@@ -206,9 +246,10 @@ void ConverterSmoothNode::inputConnectionDeleted(
  */
 QJsonObject ConverterSmoothNode::save() const
 {
-    qDebug("Saving math node");
+    qDebug("Saving smooth node");
     QJsonObject data;
     data["name"] = this->name();
+    data["radius"] = this->_radius;
 
     return data;
 }
@@ -222,8 +263,12 @@ QJsonObject ConverterSmoothNode::save() const
  */
 void ConverterSmoothNode::restore(QJsonObject const &data)
 {
-    Q_UNUSED(data);
-    qDebug("Restoring math node");
+    qDebug("Restoring smooth node");
+    this->_radius = data["radius"].toDouble(this->_radius);
+
+    // Update ui
+    this->_ui.spin_radius->setValue(this->_radius);
+    this->_shared_ui.spin_radius->setValue(this->_radius);
 }
 
 /**
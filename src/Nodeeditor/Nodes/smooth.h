@@ -10,13 +10,13 @@
 #include "../Datatypes/pixmap.h"
 #include "node.h"
 
-#include "ui_MathNode.h"
+#include "ui_Smooth.h"
 
 /**
  * ConverterSmoothNode
  * 
- * Node that smooths a surface using a smoothing surface of weighted neighbor
- * contributions.
+ * Node that smooths a surface using a gaussian blur of weighted neighbor
+ * contributions within a radius.
  */
 class ConverterSmoothNode : public Node
 {
@@ -28,6 +28,9 @@ public:
     // Create the node
     ConverterSmoothNode();
 
+    // When the node is created attach listeners
+    void created() override;
+
     // Title shown at the top of the node
     QString caption() const override;
 
@@ -71,7 +74,15 @@ private:
 
     bool _set = false;
 
-    double v = 5.00;
+    // Distance (in pixels) that neighbours are blended from, 1 is the original
+    // 3x3 kernel
+    double _radius = 1.00;
 
     IntensityMap _output;
+
+    // UI elements
+    Ui::Smooth _ui;
+    Ui::Smooth _shared_ui;
+    QWidget *_widget;
+    QWidget *_shared_widget;
 };
\ No newline at end of file
@@ -0,0 +1,553 @@
+#include "spectralnoise.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+
+#include <QDebug>
+#include <QDoubleSpinBox>
+#include <QMutexLocker>
+#include <QProgressBar>
+#include <QSpinBox>
+
+#include "Globals/parallel.h"
+#include "Globals/settings.h"
+
+#include "./Convolution/fft.h"
+
+/**
+ * mix
+ *
+ * Scrambles a number (splitmix64 finalizer), used to get a random number for
+ * every frequency that does not depend on the map size.
+ *
+ * @param uint64_t value : The number to scramble.
+ *
+ * @returns uint64_t : The scrambled number.
+ */
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+/**
+ * uniform
+ *
+ * Random number in (0, 1] for a seed and a frequency.
+ *
+ * @param int seed : The noise seed.
+ * @param int fx : The horizontal frequency.
+ * @param int fy : The vertical frequency.
+ * @param int stream : Picks one of the random numbers of the frequency.
+ *
+ * @returns double : The random number.
+ */
+static double uniform(int seed, int fx, int fy, int stream)
+{
+    uint64_t key = mix((uint64_t)(uint32_t)seed);
+    key = mix(key ^ (uint64_t)(uint32_t)fx);
+    key = mix(key ^ (uint64_t)(uint32_t)fy);
+    key = mix(key ^ (uint64_t)stream);
+    return ((key >> 11) + 1) * (1.00 / 9007199254740992.00);
+}
+
+/******************************************************************************
+ *                                 WORKER                                     *
+ ******************************************************************************/
+
+/**
+ * set
+ *
+ * Sets the noise to generate with the next generate call and interrupts a
+ * generation that is still running, as its result would be replaced anyway.
+ * Every set is followed by a (queued) generate.
+ *
+ * @param int size : The width and height of the map.
+ * @param double exponent : How quickly the power falls off.
+ * @param int seed : The seed for the random amplitudes.
+ */
+void SpectralNoiseWorker::set(int size, double exponent, int seed)
+{
+    QMutexLocker lock(&this->_mutex);
+    this->_size = size;
+    this->_exponent = exponent;
+    this->_seed = seed;
+    this->_pending++;
+    this->_run = false;
+}
+
+/**
+ * result
+ *
+ * Returns the noise of the last completed generation.
+ *
+ * @returns IntensityMap : The noise.
+ */
+IntensityMap SpectralNoiseWorker::result()
+{
+    QMutexLocker lock(&this->_mutex);
+    return this->_result;
+}
+
+/**
+ * stop
+ *
+ * Clears the run flag so a running generation stops at its next step.
+ */
+void SpectralNoiseWorker::stop()
+{
+    this->_run = false;
+}
+
+/**
+ * generate @slot
+ *
+ * Generates the noise in the separate thread. When more generations are
+ * queued only the last one runs, and a set while generating stops it.
+ *
+ * @signals started
+ * @signals progress
+ * @signals done
+ */
+void SpectralNoiseWorker::generate()
+{
+    int size;
+    double exponent;
+    int seed;
+    {
+        QMutexLocker lock(&this->_mutex);
+        if (--this->_pending > 0)
+            return;
+
+        size = this->_size;
+        exponent = this->_exponent;
+        seed = this->_seed;
+        this->_run = true;
+    }
+
+    emit this->started();
+
+    IntensityMap map = InputSpectralNoiseNode::noise(
+        size, exponent, seed, [this](double fraction) {
+            emit this->progress((int)round(100.00 * fraction));
+            return this->_run.load();
+        });
+
+    if (!this->_run)
+        return;
+
+    {
+        QMutexLocker lock(&this->_mutex);
+        this->_result = map;
+    }
+    emit this->done();
+}
+
+/******************************************************************************
+ *                                  NODE                                      *
+ ******************************************************************************/
+
+/**
+ * InputSpectralNoiseNode
+ *
+ * Creates the node and creates the UI.
+ */
+InputSpectralNoiseNode::InputSpectralNoiseNode()
+{
+    this->_widget = new QWidget();
+    this->_shared_widget = new QWidget();
+    this->_ui.setupUi(this->_widget);
+    this->_shared_ui.setupUi(this->_shared_widget);
+
+    this->_ui.progress->hide();
+    this->_shared_ui.progress->hide();
+}
+
+/**
+ * ~InputSpectralNoiseNode
+ *
+ * Deletes the node, safely shutting down the worker thread.
+ */
+InputSpectralNoiseNode::~InputSpectralNoiseNode()
+{
+    if (this->_worker)
+        this->_worker->stop();
+    this->_thread.quit();
+    this->_thread.wait();
+    if (this->_worker)
+        delete this->_worker;
+}
+
+/**
+ * created
+ *
+ * Function is called when the node is created so it can connect to listeners.
+ */
+void InputSpectralNoiseNode::created()
+{
+    QObject::connect(this->_ui.spin_exponent,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_exponent = value;
+                         this->_shared_ui.spin_exponent->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_ui.spin_seed,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_seed = value;
+                         this->_shared_ui.spin_seed->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_exponent,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_exponent = value;
+                         this->_ui.spin_exponent->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_seed,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_seed = value;
+                         this->_ui.spin_seed->setValue(value);
+                         this->_generate();
+                     });
+
+    Q_CHECK_PTR(SETTINGS);
+    // Settings listener
+    QObject::connect(SETTINGS,
+                     &Settings::previewResolutionChanged,
+                     this,
+                     &InputSpectralNoiseNode::_generate);
+    QObject::connect(SETTINGS,
+                     &Settings::renderResolutionChanged,
+                     this,
+                     &InputSpectralNoiseNode::_generate);
+    QObject::connect(SETTINGS,
+                     &Settings::renderModeChanged,
+                     this,
+                     &InputSpectralNoiseNode::_generate);
+
+    // Generate values
+    this->_generate();
+}
+
+/**
+ * caption
+ *
+ * Return a string that is displayed on the node and in the properties.
+ *
+ * @returns QString : The caption.
+ */
+QString InputSpectralNoiseNode::caption() const
+{
+    return QString("Spectral Noise");
+}
+
+/**
+ * name
+ *
+ * Return a string that is displayed in the node selection list.
+ *
+ * @returns QString : The name.
+ */
+QString InputSpectralNoiseNode::name() const
+{
+    return QString("Spectral Noise");
+}
+
+/**
+ * embeddedWidget
+ *
+ * Returns a pointer to the widget that gets embedded within the node in the
+ * dataflow diagram.
+ *
+ * @returns QWidget* : The embedded widget.
+ */
+QWidget *InputSpectralNoiseNode::embeddedWidget()
+{
+    Q_CHECK_PTR(this->_widget);
+    return this->_widget;
+}
+
+/**
+ * sharedWidget
+ *
+ * Returns a pointer to the widget that gets displayed in the properties panel.
+ *
+ * @returns QWidget* : The shared widget.
+ */
+QWidget *InputSpectralNoiseNode::sharedWidget()
+{
+    Q_CHECK_PTR(this->_shared_widget);
+    return this->_shared_widget;
+}
+
+/**
+ * nPorts
+ *
+ * Returns the number of ports the node has per type of port.
+ *
+ * @param QtNodes::PortType port_type : The type of port to get the number of
+ *                                      ports. QtNodes::PortType::In (input),
+ *                                      QtNodes::PortType::Out (output)
+ *
+ * @returns unsigned int : The number of ports.
+ */
+unsigned int InputSpectralNoiseNode::nPorts(QtNodes::PortType port_type) const
+{
+    return port_type == QtNodes::PortType::Out ? 1 : 0;
+}
+
+/**
+ * dataType
+ *
+ * Returns the data type for each of the ports.
+ *
+ * @param QtNodes::PortType port_type : The type of port (in or out).
+ * @param QtNodes::PortIndex port_index : The port index on each side.
+ *
+ * @returns QtNodes::NodeDataType : The type of data the port provides/accepts.
+ */
+QtNodes::NodeDataType
+InputSpectralNoiseNode::dataType(QtNodes::PortType port_type,
+                                 QtNodes::PortIndex port_index) const
+{
+    Q_UNUSED(port_type);
+    Q_UNUSED(port_index);
+    return IntensityMapData().type();
+}
+
+/**
+ * save
+ *
+ * Saves the state of the node into a QJsonObject for the system to save to
+ * file.
+ *
+ * @returns QJsonObject : The saved state of the node.
+ */
+QJsonObject InputSpectralNoiseNode::save() const
+{
+    qDebug("Saving spectral noise node");
+    QJsonObject data;
+    data["name"] = this->name();
+    data["exponent"] = this->_exponent;
+    data["seed"] = this->_seed;
+    return data;
+}
+
+/**
+ * restore
+ *
+ * Restores the state of the node from a provided json object.
+ *
+ * @param QJsonObject const& data : The data to restore from.
+ */
+void InputSpectralNoiseNode::restore(QJsonObject const &data)
+{
+    qDebug("Restoring spectral noise node");
+    this->_exponent = data["exponent"].toDouble(this->_exponent);
+    this->_seed = data["seed"].toInt(this->_seed);
+
+    // Update ui
+    this->_ui.spin_exponent->setValue(this->_exponent);
+    this->_ui.spin_seed->setValue(this->_seed);
+
+    this->_shared_ui.spin_exponent->setValue(this->_exponent);
+    this->_shared_ui.spin_seed->setValue(this->_seed);
+
+    this->_generate();
+}
+
+/**
+ * outData
+ *
+ * Returns a shared pointer for transport along a connection to another node.
+ *
+ * @param QtNodes::PortIndex port : The port to get data from.
+ *
+ * @returns std::shared_ptr<QtNodes::NodeData> : The shared output data.
+ */
+std::shared_ptr<QtNodes::NodeData>
+InputSpectralNoiseNode::outData(QtNodes::PortIndex port)
+{
+    Q_UNUSED(port);
+    return std::make_shared<IntensityMapData>(this->_output);
+}
+
+/**
+ * setInData
+ *
+ * Sets the input data on a port. (does nothing)
+ *
+ * @param std::shared_ptr<QtNodes::NodeData> node_data : The shared pointer data
+ *                                                       being inputted.
+ * @param QtNodes::PortIndex port : The port the data is being set on.
+ */
+void InputSpectralNoiseNode::setInData(
+    std::shared_ptr<QtNodes::NodeData> node_data,
+    QtNodes::PortIndex port)
+{
+    Q_UNUSED(node_data);
+    Q_UNUSED(port);
+}
+
+/**
+ * noise
+ *
+ * Creates fractal noise in the frequency domain. Every frequency gets a random
+ * (gaussian) complex amplitude scaled by 1 / f^(exponent / 2), so the power
+ * falls off as 1 / f^exponent, and the spectrum is transformed into the map.
+ * Frequencies are counted in waves across the map and their random numbers
+ * only depend on the seed and the frequency, so a smaller map (the preview)
+ * has the same shapes as a larger one (the render) without the finest detail.
+ * The result is scaled to [0, 1].
+ *
+ * The spectrum rows are filled in parallel. The progress is told after the
+ * spectrum (0.40), the transform (0.90) and the scaling (1.00), and the
+ * generation stops between those steps when it returns false.
+ *
+ * @param int size : The width and height of the map.
+ * @param double exponent : How quickly the power falls off (β), 2 is brownian.
+ * @param int seed : The seed for the random amplitudes.
+ * @param Progress const& progress : Told the fraction done, may be empty.
+ *
+ * @returns IntensityMap : The noise, an empty map when stopped.
+ */
+IntensityMap InputSpectralNoiseNode::noise(int size,
+                                           double exponent,
+                                           int seed,
+                                           Progress const &progress)
+{
+    Q_ASSERT(size > 0);
+    FFT fft(size, size);
+    int half = fft.spectrumWidth();
+    std::vector<FFT::Complex> spectrum((size_t)half * size);
+
+    parallelRows(size, [&](int start, int end) {
+        for (int ky = start; ky < end; ky++)
+        {
+            int fy = ky <= size / 2 ? ky : ky - size;
+            for (int fx = 0; fx < half; fx++)
+            {
+                if (fx == 0 && fy == 0)
+                    continue;
+
+                // The conjugate frequency on the first column has the same
+                // number
+                bool conjugate = fx == 0 && fy < 0;
+                int key_y = conjugate ? -fy : fy;
+
+                double radius = sqrt(-2.00
+                                     * log(uniform(seed, fx, key_y, 0)));
+                double angle = 2.00 * M_PI * uniform(seed, fx, key_y, 1);
+                double amplitude = pow(sqrt((double)(fx * fx + fy * fy)),
+                                       -exponent / 2.00);
+
+                FFT::Complex value = std::polar(radius * amplitude, angle);
+                spectrum[(size_t)ky * half + fx] =
+                    conjugate ? std::conj(value) : value;
+            }
+        }
+    });
+
+    if (progress && !progress(0.40))
+        return IntensityMap();
+
+    IntensityMap map = fft.inverse(spectrum);
+
+    if (progress && !progress(0.90))
+        return IntensityMap();
+
+    auto range = std::minmax_element(map.values.begin(), map.values.end());
+    double min = *range.first;
+    double max = *range.second;
+    if (max > min)
+        for (double &value : map.values)
+            value = (value - min) / (max - min);
+    map.invalidate();
+
+    if (progress && !progress(1.00))
+        return IntensityMap();
+
+    return map;
+}
+
+/**
+ * _generate
+ *
+ * Starts generating the output map at the preview or render resolution in the
+ * worker thread, the transform of a large render map takes too long for the
+ * GUI thread. The output is replaced when the worker is done.
+ */
+void InputSpectralNoiseNode::_generate()
+{
+    Q_CHECK_PTR(SETTINGS);
+    int size = SETTINGS->previewResolution();
+    if (SETTINGS->renderMode())
+        size = SETTINGS->renderResolution();
+
+    if (!this->_worker)
+    {
+        this->_worker = new SpectralNoiseWorker();
+        this->_worker->moveToThread(&this->_thread);
+
+        QObject::connect(this->_worker,
+                         &SpectralNoiseWorker::done,
+                         this,
+                         &InputSpectralNoiseNode::spectralDone);
+
+        QObject::connect(this->_worker,
+                         &SpectralNoiseWorker::started,
+                         this,
+                         [this]() {
+                             Q_CHECK_PTR(SETTINGS);
+                             bool text = SETTINGS->percentProgressText();
+                             this->_ui.progress->setTextVisible(text);
+                             this->_shared_ui.progress->setTextVisible(text);
+                             this->_ui.progress->setValue(0);
+                             this->_shared_ui.progress->setValue(0);
+                             this->_ui.progress->show();
+                             this->_shared_ui.progress->show();
+                         });
+
+        QObject::connect(this->_worker,
+                         &SpectralNoiseWorker::progress,
+                         this->_ui.progress,
+                         &QProgressBar::setValue);
+
+        QObject::connect(this->_worker,
+                         &SpectralNoiseWorker::progress,
+                         this->_shared_ui.progress,
+                         &QProgressBar::setValue);
+
+        this->_thread.start();
+    }
+
+    this->_worker->set(size, this->_exponent, this->_seed);
+    QMetaObject::invokeMethod(this->_worker, "generate", Qt::QueuedConnection);
+}
+
+/**
+ * spectralDone @slot
+ *
+ * Called when the generation of the noise in the other thread is done.
+ *
+ * @signals dataUpdated
+ */
+void InputSpectralNoiseNode::spectralDone()
+{
+    Q_CHECK_PTR(this->_worker);
+    this->_ui.progress->hide();
+    this->_shared_ui.progress->hide();
+
+    this->_output = this->_worker->result();
+    emit this->dataUpdated(0);
+}
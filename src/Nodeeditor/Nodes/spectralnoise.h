@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QWidget>
+
+#include <nodes/NodeDataModel>
+
+#include "../Datatypes/intensitymap.h"
+#include "../Datatypes/pixmap.h"
+#include "node.h"
+
+#include "ui_SpectralNoise.h"
+
+/**
+ * SpectralNoiseWorker
+ *
+ * Worker class for generating the spectral noise in its own dedicated thread.
+ */
+class SpectralNoiseWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Set the noise to generate next, interrupts a running generation
+    void set(int size, double exponent, int seed);
+
+    // The last generated noise
+    IntensityMap result();
+
+    // Stop a running generation (can be called from any thread)
+    void stop();
+
+public slots:
+    // Generate the noise of the last set
+    void generate();
+
+signals:
+    // Progress updates
+    void started();
+    void progress(int perc);
+    void done();
+
+private:
+    QMutex _mutex;
+
+    // Generation parameters
+    int _size = 1;
+    double _exponent = 2.00;
+    int _seed = 1;
+
+    // Number of queued generations, only the last one runs
+    int _pending = 0;
+
+    IntensityMap _result{1, 1, 0.50};
+
+    // Flag for interuption
+    std::atomic<bool> _run{false};
+};
+
+/**
+ * InputSpectralNoiseNode
+ *
+ * Input node that creates fractal (1/f^β) noise by giving every frequency a
+ * random amplitude that falls off with the frequency, then transforming the
+ * spectrum into a height map. The noise tiles seamlessly.
+ */
+class InputSpectralNoiseNode : public Node
+{
+    Q_OBJECT
+    friend class InputSpectralNoiseNode_Test;
+
+public:
+    // Told the fraction done (0 to 1), returning false stops the generation
+    typedef std::function<bool(double)> Progress;
+
+    // Create the node
+    InputSpectralNoiseNode();
+    ~InputSpectralNoiseNode();
+
+    // When the node is created attach listeners
+    void created() override;
+
+    // Title shown at the top of the node
+    QString caption() const override;
+
+    // Title shown in the selection list
+    QString name() const override;
+
+    // The embedded widget shown in the node
+    QWidget *embeddedWidget();
+
+    // The shared widget shown in the properties panel
+    QWidget *sharedWidget();
+
+    // Get the number of ports (1 output, 0 input)
+    unsigned int nPorts(QtNodes::PortType port_type) const override;
+
+    // Get the port datatype (only exports IntensityMapData)
+    QtNodes::NodeDataType
+    dataType(QtNodes::PortType port_type,
+             QtNodes::PortIndex port_index) const override;
+
+    // Save and load the node for project files
+    QJsonObject save() const override;
+    void restore(QJsonObject const &data) override;
+
+    // Get the output data
+    std::shared_ptr<QtNodes::NodeData> outData(QtNodes::PortIndex port);
+
+    // Needed for all nodes, even if there are no inputs
+    void setInData(std::shared_ptr<QtNodes::NodeData> node_data,
+                   QtNodes::PortIndex port);
+
+    // Create size x size noise, the power of a frequency f is 1 / f^exponent
+    // (an empty map when stopped)
+    static IntensityMap noise(int size,
+                              double exponent,
+                              int seed,
+                              Progress const &progress = nullptr);
+
+public slots:
+    // Take the noise generated in the other thread
+    void spectralDone();
+
+private:
+    // Start generating the output map in the worker thread
+    void _generate();
+
+    IntensityMap _output{1, 1, 0.50};
+
+    // Noise settings
+    double _exponent = 2.00;
+    int _seed = 1;
+
+    QThread _thread;
+    SpectralNoiseWorker *_worker = nullptr;
+
+    // UI elements
+    Ui::SpectralNoise _ui;
+    Ui::SpectralNoise _shared_ui;
+    QWidget *_widget;
+    QWidget *_shared_widget;
+};
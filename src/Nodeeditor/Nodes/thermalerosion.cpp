@@ -0,0 +1,290 @@
+#include "thermalerosion.h"
+
+#include <QDebug>
+#include <QDoubleSpinBox>
+#include <QSpinBox>
+
+/**
+ * ConverterThermalErosionNode
+ *
+ * Creates the node and creates the UI.
+ */
+ConverterThermalErosionNode::ConverterThermalErosionNode()
+{
+    this->_widget = new QWidget();
+    this->_shared_widget = new QWidget();
+    this->_ui.setupUi(this->_widget);
+    this->_shared_ui.setupUi(this->_shared_widget);
+}
+
+/**
+ * created
+ *
+ * Function is called when the node is created so it can connect to listeners.
+ */
+void ConverterThermalErosionNode::created()
+{
+    QObject::connect(this->_ui.spin_iterations,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_iterations = value;
+                         this->_shared_ui.spin_iterations->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_ui.spin_angle,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_angle = value;
+                         this->_shared_ui.spin_angle->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_ui.spin_strength,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_strength = value;
+                         this->_shared_ui.spin_strength->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_iterations,
+                     QOverload<int>::of(&QSpinBox::valueChanged),
+                     [this](int value) {
+                         this->_iterations = value;
+                         this->_ui.spin_iterations->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_angle,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_angle = value;
+                         this->_ui.spin_angle->setValue(value);
+                         this->_generate();
+                     });
+
+    QObject::connect(this->_shared_ui.spin_strength,
+                     QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+                     [this](double value) {
+                         this->_strength = value;
+                         this->_ui.spin_strength->setValue(value);
+                         this->_generate();
+                     });
+}
+
+/**
+ * caption
+ *
+ * Return a string that is displayed on the node and in the properties.
+ *
+ * @returns QString : The caption.
+ */
+QString ConverterThermalErosionNode::caption() const
+{
+    return QString("Thermal Erosion");
+}
+
+/**
+ * name
+ *
+ * Return a string that is displayed in the node selection list.
+ *
+ * @returns QString : The name.
+ */
+QString ConverterThermalErosionNode::name() const
+{
+    return QString("Thermal Erosion");
+}
+
+/**
+ * embeddedWidget
+ *
+ * Returns a pointer to the widget that gets embedded within the node in the
+ * dataflow diagram.
+ *
+ * @returns QWidget* : The embedded widget.
+ */
+QWidget *ConverterThermalErosionNode::embeddedWidget()
+{
+    Q_CHECK_PTR(this->_widget);
+    return this->_widget;
+}
+
+/**
+ * sharedWidget
+ *
+ * Returns a pointer to the widget that gets displayed in the properties panel.
+ *
+ * @returns QWidget* : The shared widget.
+ */
+QWidget *ConverterThermalErosionNode::sharedWidget()
+{
+    Q_CHECK_PTR(this->_shared_widget);
+    return this->_shared_widget;
+}
+
+/**
+ * nPorts
+ *
+ * Returns the number of ports the node has per type of port.
+ *
+ * @param QtNodes::PortType port_type : The type of port to get the number of
+ *                                      ports. QtNodes::PortType::In (input),
+ *                                      QtNodes::PortType::Out (output)
+ *
+ * @returns unsigned int : The number of ports.
+ */
+unsigned int
+ConverterThermalErosionNode::nPorts(QtNodes::PortType port_type) const
+{
+    Q_UNUSED(port_type);
+    return 1;
+}
+
+/**
+ * dataType
+ *
+ * Returns the data type for each of the ports.
+ *
+ * @param QtNodes::PortType port_type : The type of port (in or out).
+ * @param QtNodes::PortIndex port_index : The port index on each side.
+ *
+ * @returns QtNodes::NodeDataType : The type of data the port provides/accepts.
+ */
+QtNodes::NodeDataType
+ConverterThermalErosionNode::dataType(QtNodes::PortType port_type,
+                                      QtNodes::PortIndex port_index) const
+{
+    Q_UNUSED(port_index);
+    if (port_type == QtNodes::PortType::In)
+        return IntensityMapData().type();
+
+    return QtNodes::NodeDataType{IntensityMapData().type().id, "Height"};
+}
+
+/**
+ * setInData
+ *
+ * Sets the input data on a port.
+ *
+ * @param std::shared_ptr<QtNodes::NodeData> node_data : The shared pointer data
+ *                                                       being inputted.
+ * @param QtNodes::PortIndex port : The port the data is being set on.
+ */
+void ConverterThermalErosionNode::setInData(
+    std::shared_ptr<QtNodes::NodeData> node_data,
+    QtNodes::PortIndex port)
+{
+    Q_UNUSED(port);
+    if (node_data
+        && (this->_input =
+                std::dynamic_pointer_cast<IntensityMapData>(node_data)))
+    {
+        this->_set = true;
+        this->_generate();
+    }
+}
+
+/**
+ * inputConnectionDeleted @slot
+ *
+ * Called when an input connection is deleted, this usually resets some data and
+ * regenerates the output data.
+ *
+ * @param QtNodes::Connection const& connection : The connection being deleted.
+ *
+ * @signals dataUpdated
+ */
+void ConverterThermalErosionNode::inputConnectionDeleted(
+    QtNodes::Connection const &connection)
+{
+    Q_UNUSED(connection);
+    this->_set = false;
+    this->_output = IntensityMap(1, 1, 1.00);
+    emit this->dataUpdated(0);
+}
+
+/**
+ * save
+ *
+ * Saves the state of the node into a QJsonObject for the system to save to
+ * file.
+ *
+ * @returns QJsonObject : The saved state of the node.
+ */
+QJsonObject ConverterThermalErosionNode::save() const
+{
+    qDebug("Saving thermal erosion node");
+    QJsonObject data;
+    data["name"] = this->name();
+    data["iterations"] = this->_iterations;
+    data["angle"] = this->_angle;
+    data["strength"] = this->_strength;
+    return data;
+}
+
+/**
+ * restore
+ *
+ * Restores the state of the node from a provided json object.
+ *
+ * @param QJsonObject const& data : The data to restore from.
+ */
+void ConverterThermalErosionNode::restore(QJsonObject const &data)
+{
+    qDebug("Restoring thermal erosion node");
+    this->_iterations = data["iterations"].toInt(this->_iterations);
+    this->_angle = data["angle"].toDouble(this->_angle);
+    this->_strength = data["strength"].toDouble(this->_strength);
+
+    // Update ui
+    this->_ui.spin_iterations->setValue(this->_iterations);
+    this->_ui.spin_angle->setValue(this->_angle);
+    this->_ui.spin_strength->setValue(this->_strength);
+
+    this->_shared_ui.spin_iterations->setValue(this->_iterations);
+    this->_shared_ui.spin_angle->setValue(this->_angle);
+    this->_shared_ui.spin_strength->setValue(this->_strength);
+}
+
+/**
+ * outData
+ *
+ * Returns a shared pointer for transport along a connection to another node.
+ *
+ * @param QtNodes::PortIndex port : The port to get data from.
+ *
+ * @returns std::shared_ptr<QtNodes::NodeData> : The shared output data.
+ */
+std::shared_ptr<QtNodes::NodeData>
+ConverterThermalErosionNode::outData(QtNodes::PortIndex port)
+{
+    Q_UNUSED(port);
+    return std::make_shared<IntensityMapData>(this->_output);
+}
+
+/**
+ * _generate
+ *
+ * Generates the output data from the supplied and available data. All the
+ * iterations run inside the simulation, no map is made between them.
+ *
+ * @signals dataUpdated
+ */
+void ConverterThermalErosionNode::_generate()
+{
+    if (!this->_set)
+        return;
+
+    Q_CHECK_PTR(this->_input);
+    this->_output = this->_input->intensityMap();
+
+    ThermalParameters parameters;
+    parameters.angle = this->_angle;
+    parameters.strength = this->_strength;
+
+    ThermalErosion(parameters).run(&this->_output, this->_iterations);
+
+    emit this->dataUpdated(0);
+}
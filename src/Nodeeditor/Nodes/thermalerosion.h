@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QObject>
+#include <QWidget>
+
+#include <nodes/Connection>
+#include <nodes/NodeDataModel>
+
+#include "../Datatypes/intensitymap.h"
+#include "../Datatypes/pixmap.h"
+#include "./Erosion/thermal.h"
+#include "node.h"
+
+#include "ui_ThermalErosion.h"
+
+/**
+ * ConverterThermalErosionNode
+ *
+ * Applies thermal erosion over the provided terrain height map, material on
+ * slopes steeper than the talus angle slides down until the slopes settle.
+ */
+class ConverterThermalErosionNode : public Node
+{
+    Q_OBJECT
+public:
+    // Create the node
+    ConverterThermalErosionNode();
+
+    // When the node is created attach listeners
+    void created() override;
+
+    // Title shown at the top of the node
+    QString caption() const override;
+
+    // Title shown in the selection list
+    QString name() const override;
+
+    // The embedded widget shown in the node
+    QWidget *embeddedWidget();
+
+    // The shared widget shown in the properties panel
+    QWidget *sharedWidget();
+
+    // Get the number of ports (1 output, 1 input)
+    unsigned int nPorts(QtNodes::PortType port_type) const override;
+
+    // Get the port datatype (only imports IntensityMapData)
+    QtNodes::NodeDataType
+    dataType(QtNodes::PortType port_type,
+             QtNodes::PortIndex port_index) const override;
+
+    // Save and load the node for project files
+    QJsonObject save() const override;
+    void restore(QJsonObject const &data) override;
+
+    // Get the output data
+    std::shared_ptr<QtNodes::NodeData> outData(QtNodes::PortIndex port);
+
+    // Set the input intensity map
+    void setInData(std::shared_ptr<QtNodes::NodeData> node_data,
+                   QtNodes::PortIndex port);
+
+public slots:
+    // Reset the output when input removed
+    void inputConnectionDeleted(QtNodes::Connection const &connection);
+
+private:
+    // Generate the output pixmap
+    void _generate();
+
+    IntensityMap _output{1, 1, 1.00};
+
+    std::shared_ptr<IntensityMapData> _input;
+    bool _set = false;
+
+    // Simulation settings
+    int _iterations = 50;
+    double _angle = 35.00;
+    double _strength = 0.50;
+
+    // UI elements
+    Ui::ThermalErosion _ui;
+    Ui::ThermalErosion _shared_ui;
+    QWidget *_widget;
+    QWidget *_shared_widget;
+};
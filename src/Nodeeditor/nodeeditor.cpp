@@ -39,6 +39,7 @@ static std::shared_ptr<QtNodes::DataModelRegistry> registerDataModels()
 
     registry->registerModel<InputTextureNode>("Input");
     registry->registerModel<InputSimplexNoiseNode>("Input");
+    registry->registerModel<InputSpectralNoiseNode>("Input");
     registry->registerModel<InputConstantValueNode>("Input");
     registry->registerModel<InputConstantVectorNode>("Input");
 
@@ -54,6 +55,7 @@ static std::shared_ptr<QtNodes::DataModelRegistry> registerDataModels()
     registry->registerModel<ConverterClampNode>("Converters");
     registry->registerModel<ConverterErosionNode>("Converters");
     registry->registerModel<ConverterSmoothNode>("Converters");
+    registry->registerModel<ConverterThermalErosionNode>("Converters");
 
     // Converters to automatically convert IntensityMap <-> VectorMap data between nodes
     registry->registerTypeConverter(std::make_pair(
@@ -197,6 +199,10 @@ void Nodeeditor::_updatePropertiesNode(QtNodes::NodeDataModel *node, bool swap)
     {
         CAST_NODE(InputConstantVectorNode)
     }
+    else if (name == InputSpectralNoiseNode().name())
+    {
+        CAST_NODE(InputSpectralNoiseNode)
+    }
     else if (name == ConverterBezierCurveNode().name())
     {
         CAST_NODE(ConverterBezierCurveNode)
@@ -209,6 +215,14 @@ void Nodeeditor::_updatePropertiesNode(QtNodes::NodeDataModel *node, bool swap)
     {
         CAST_NODE(ConverterErosionNode)
     }
+    else if (name == ConverterThermalErosionNode().name())
+    {
+        CAST_NODE(ConverterThermalErosionNode)
+    }
+    else if (name == ConverterSmoothNode().name())
+    {
+        CAST_NODE(ConverterSmoothNode)
+    }
     else if (swap)
     {
         this->_properties->layout()->removeWidget(this->_properties_node);
@@ -238,6 +252,7 @@ void Nodeeditor::nodeCreated(QtNodes::Node &node)
         qDebug("Setting active output node");
         // Save pointer to the output node
         this->_active_output = static_cast<OutputNode *>(node.nodeDataModel());
+        this->_output_changed = true;
 
         // Connect to computing listeners of the output node
         QObject::connect(this->_active_output,
@@ -272,6 +287,7 @@ void Nodeeditor::nodeDoubleClicked(QtNodes::Node &node)
 
         // Update the active output node
         this->_active_output = static_cast<OutputNode *>(node.nodeDataModel());
+        this->_output_changed = true;
         // Attach new listeners
         QObject::connect(this->_active_output,
                          &QtNodes::NodeDataModel::computingFinished,
@@ -285,17 +301,27 @@ void Nodeeditor::nodeDoubleClicked(QtNodes::Node &node)
  * outputComputingFinished @slot
  * 
  * When the output node has completed its computation (the sum of the dataflow)
- * we emit changes to be displayed in the opengl widget.
+ * we emit changes to be displayed in the opengl widget. Along with the maps the
+ * area of the normal map that changed is sent so only that part is uploaded.
  * 
  * @signals outputUpdated
  */
 void Nodeeditor::outputComputingFinished()
 {
     qDebug("Output node done computing normal map");
+    QImage normal_map = this->getNormalMap();
+
+    // A different output node replaces the whole normal map
+    QRect normal_region = this->_output_changed
+                          ? normal_map.rect()
+                          : this->getNormalRegion();
+    this->_output_changed = false;
+
     // Inform parents that there are new normal and height maps (main.cpp)
-    emit this->outputUpdated(this->getNormalMap(),
+    emit this->outputUpdated(normal_map,
                              this->getHeightMap(),
-                             this->getAlbedoMap());
+                             this->getAlbedoMap(),
+                             normal_region);
 }
 
 /**
@@ -333,6 +359,27 @@ QImage Nodeeditor::getHeightMap()
     }
 }
 
+/**
+ * getHeightValues
+ * 
+ * Get the height values of the active output node, a flat map if there is no
+ * output node.
+ * 
+ * @returns IntensityMap : The height values.
+ */
+IntensityMap Nodeeditor::getHeightValues()
+{
+    if (this->_active_output)
+    {
+        OutputNode *node = static_cast<OutputNode *>(this->_active_output);
+        return node->getHeightValues();
+    }
+    else
+    {
+        return IntensityMap(1, 1, 0.00);
+    }
+}
+
 /**
  * getNormalMap
  * 
@@ -358,6 +405,27 @@ QImage Nodeeditor::getNormalMap()
     }
 }
 
+/**
+ * getNormalRegion
+ * 
+ * Get the area of the normal map that changed with the last update of the
+ * active output node, the whole map when there is no output node.
+ * 
+ * @returns QRect : The changed area.
+ */
+QRect Nodeeditor::getNormalRegion()
+{
+    if (this->_active_output)
+    {
+        OutputNode *node = static_cast<OutputNode *>(this->_active_output);
+        return node->getNormalRegion();
+    }
+    else
+    {
+        return QRect(0, 0, 1, 1);
+    }
+}
+
 /**
  * getAlbedoMap
  * 
@@ -3,6 +3,7 @@
 #include <QJsonObject>
 #include <QLayout>
 #include <QObject>
+#include <QRect>
 #include <QWidget>
 
 #include <nodes/FlowScene>
@@ -17,6 +18,7 @@
 #include "./Nodes/constantvector.h"
 #include "./Nodes/inputsimplexnoise.h"
 #include "./Nodes/inputtexture.h"
+#include "./Nodes/spectralnoise.h"
 
 // Converter Nodes
 #include "./Nodes/bezier.h"
@@ -31,6 +33,7 @@
 #include "./Nodes/vectormath.h"
 #include "./Nodes/erosion.h"
 #include "./Nodes/smooth.h"
+#include "./Nodes/thermalerosion.h"
 
 /**
  * Nodeeditor
@@ -52,6 +55,12 @@ public:
     QImage getNormalMap();
     QImage getAlbedoMap();
 
+    // Returns the height values of the active output node (full precision)
+    IntensityMap getHeightValues();
+
+    // Returns the area of the normal map that changed with the last update
+    QRect getNormalRegion();
+
     // Save/load the editor nodes, layout, and connections
     QJsonObject save();
     void load(QJsonObject data);
@@ -69,7 +78,10 @@ public slots:
 signals:
     // When the output node has completed rendering the normal map emit a
     // signal with updated normal and height maps
-    void outputUpdated(QImage normal_map, QImage height_map, QImage albedo_map);
+    void outputUpdated(QImage normal_map,
+                       QImage height_map,
+                       QImage albedo_map,
+                       QRect normal_region);
 
 private:
     // Sets the properties widget.
@@ -88,4 +100,7 @@ private:
 
     // Selected output node to obtain normal and height map from.
     OutputNode *_active_output = nullptr;
+
+    // Whether the active output changed since the last output update
+    bool _output_changed = true;
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "gridmesh.h"
+
+#include <deque>
+#include <unordered_set>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+// Setup the cache shared by every grid
+QMutex GridMesh::_cache_mutex;
+std::vector<std::pair<std::pair<int, int>,
+                      std::shared_ptr<const GridMesh::Buffers>>>
+    GridMesh::_cache;
+
+/**
+ * getIndex
+ *
+ * Converts an x and y 2D index to a 1Dimensional index value with the
+ * resolution. Used for the vertices index reference
+ *
+ * @param int row : The row.
+ * @param int col : The col.
+ * @param int resolution : The size of the mesh.
+ *
+ * @returns GLuint : The index of the vertex.
+ */
+static GLuint getIndex(int row, int col, int resolution)
+{
+    Q_ASSERT(resolution > 0);
+    return (GLuint)row * (GLuint)resolution + (GLuint)col;
+}
+
+/**
+ * banded
+ *
+ * The place of a quad in an area of quads ordered in bands of columns, each
+ * band row by row. The bands are as even as possible and at most half the
+ * cache wide, so the row above is still cached when the row below reuses it.
+ *
+ * @param int x : The column of the quad in the area.
+ * @param int row : The row of the quad in the area.
+ * @param int width : The columns of the area.
+ * @param int rows : The rows of the area.
+ *
+ * @returns size_t : The place of the quad.
+ */
+static size_t banded(int x, int row, int width, int rows)
+{
+    int widest = GridMesh::CACHE_VERTICES / 2 - 1;
+    int bands = (width + widest - 1) / widest;
+    int band = (width + bands - 1) / bands;
+
+    // Every band before this one is full width
+    int left = x / band * band;
+    int columns = qMin(band, width - left);
+    return (size_t)left * rows + (size_t)row * columns + (x - left);
+}
+
+/**
+ * GridMesh
+ *
+ * Gets the vertices and indexes of the grid, from the cache if the grid was
+ * built recently, otherwise they are built and cached.
+ *
+ * @param int resolution : The number of vertices along an edge.
+ * @param GridMesh::Order order : The order of the triangles, QUADRANTS needs
+ *                                an even number of quads along an edge.
+ */
+GridMesh::GridMesh(int resolution, Order order) : _resolution(resolution)
+{
+    Q_ASSERT(resolution > 0);
+    Q_ASSERT(order != QUADRANTS || (resolution - 1) % 2 == 0);
+
+    std::pair<int, int> key(resolution, (int)order);
+    {
+        QMutexLocker lock(&GridMesh::_cache_mutex);
+        auto &cache = GridMesh::_cache;
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            if (cache[i].first != key)
+                continue;
+
+            // Move to the front
+            auto entry = cache[i];
+            cache.erase(cache.begin() + i);
+            cache.insert(cache.begin(), entry);
+            this->_buffers = entry.second;
+            return;
+        }
+    }
+
+    this->_buffers = GridMesh::_build(resolution, order);
+
+    QMutexLocker lock(&GridMesh::_cache_mutex);
+    auto &cache = GridMesh::_cache;
+    cache.insert(cache.begin(), std::make_pair(key, this->_buffers));
+    if (cache.size() > (size_t)GridMesh::CACHE_SIZE)
+        cache.resize(GridMesh::CACHE_SIZE);
+}
+
+/**
+ * resolution
+ *
+ * The number of vertices along an edge of the grid.
+ *
+ * @returns int : The resolution.
+ */
+int GridMesh::resolution() const
+{
+    return this->_resolution;
+}
+
+/**
+ * vertices
+ *
+ * The vertex positions, three floats (x, 0, z) per vertex row by row, x and z
+ * go from 0 to 1 and double as texture coordinates.
+ *
+ * @returns std::vector<GLfloat> const& : The positions.
+ */
+std::vector<GLfloat> const &GridMesh::vertices() const
+{
+    return this->_buffers->vertices;
+}
+
+/**
+ * indexes
+ *
+ * The triangle indexes into the vertices, two triangles per grid quad.
+ *
+ * @returns std::vector<GLuint> const& : The indexes.
+ */
+std::vector<GLuint> const &GridMesh::indexes() const
+{
+    return this->_buffers->indexes;
+}
+
+/**
+ * quadrantOffset
+ *
+ * The first index of a quarter of the grid when built in QUADRANTS order.
+ *
+ * @param int quadrant : The quarter, 0 top left, 1 top right, 2 bottom left
+ *                       and 3 bottom right (z increases downwards).
+ *
+ * @returns int : The offset into the indexes.
+ */
+int GridMesh::quadrantOffset(int quadrant) const
+{
+    Q_ASSERT(0 <= quadrant && quadrant < 4);
+    return quadrant * this->quadrantCount();
+}
+
+/**
+ * quadrantCount
+ *
+ * The number of indexes of a quarter of the grid (QUADRANTS order).
+ *
+ * @returns int : The number of indexes.
+ */
+int GridMesh::quadrantCount() const
+{
+    return (int)this->_buffers->indexes.size() / 4;
+}
+
+/**
+ * acmr
+ *
+ * Simulates a first in first out post-transform vertex cache over triangle
+ * indexes and counts the vertices that miss it. Used to measure orderings
+ * offline, GPUs differ but follow the same trend.
+ *
+ * @param std::vector<GLuint> const& indexes : The triangle indexes.
+ * @param int cache : The number of vertices in the cache.
+ *
+ * @returns double : The misses per triangle.
+ */
+double GridMesh::acmr(std::vector<GLuint> const &indexes, int cache)
+{
+    Q_ASSERT(cache > 0);
+    if (indexes.size() < 3)
+        return 0.00;
+
+    std::deque<GLuint> fifo;
+    std::unordered_set<GLuint> cached;
+    size_t misses = 0;
+    for (GLuint index : indexes)
+    {
+        if (cached.count(index))
+            continue;
+
+        misses++;
+        fifo.push_back(index);
+        cached.insert(index);
+        if ((int)fifo.size() > cache)
+        {
+            cached.erase(fifo.front());
+            fifo.pop_front();
+        }
+    }
+    return (double)misses / (double)(indexes.size() / 3);
+}
+
+/**
+ * _build
+ *
+ * Generates the vertices and indexes of a grid. Both buffers are allocated
+ * at their final size and every row writes its own part, so the rows are
+ * split between threads. The place of each quad in the indexes is computed
+ * from the order. The CACHE order walks bands of columns row by row (see
+ * banded), so most vertices are only transformed once instead of twice.
+ *
+ * @param int resolution : The number of vertices along an edge.
+ * @param GridMesh::Order order : The order of the triangles.
+ *
+ * @returns std::shared_ptr<const Buffers> : The buffers.
+ */
+std::shared_ptr<const GridMesh::Buffers> GridMesh::_build(int resolution,
+                                                          Order order)
+{
+    auto buffers = std::make_shared<Buffers>();
+    int quads = resolution - 1;
+    int half = quads / 2;
+    buffers->vertices.resize((size_t)resolution * resolution * 3);
+    buffers->indexes.resize((size_t)quads * quads * 6);
+
+    // A single vertex sits at the origin
+    float step = resolution > 1 ? 1.0f / (float)(resolution - 1) : 0.0f;
+
+    parallelRows(resolution, [&](int start, int end) {
+        for (int z = start; z < end; z++) // row
+        {
+            // Does not include additional uv values as they are encoded in
+            // the x and z components since the terrain is generated as a
+            // range from 0 to 1
+            GLfloat *vertex =
+                buffers->vertices.data() + (size_t)z * resolution * 3;
+            for (int x = 0; x < resolution; x++) // col
+            {
+                vertex[x * 3] = (float)x * step;
+                vertex[x * 3 + 1] = 0.0f;
+                vertex[x * 3 + 2] = (float)z * step;
+            }
+
+            // Generates the indexes for drawing the quads above the row
+            if (z == 0)
+                continue;
+
+            int row = z - 1;
+            for (int x = 0; x < quads; x++)
+            {
+                size_t quad = (size_t)row * quads + x;
+                if (order == CACHE)
+                {
+                    quad = banded(x, row, quads, quads);
+                }
+                else if (order == QUADRANTS)
+                {
+                    int quadrant = (x >= half ? 1 : 0) + (row >= half ? 2 : 0);
+                    quad = (size_t)quadrant * half * half
+                           + banded(x % half, row % half, half, half);
+                }
+
+                // index = row * resolution + col
+                // a   b+-+c
+                // b    |/
+                // c   a+
+                GLuint *index = buffers->indexes.data() + quad * 6;
+                index[0] = getIndex(z, x, resolution);
+                index[1] = getIndex(z - 1, x, resolution);
+                index[2] = getIndex(z - 1, x + 1, resolution);
+
+                // a      +c
+                // d     /|
+                // d   a+-+d
+                index[3] = getIndex(z, x, resolution);
+                index[4] = getIndex(z - 1, x + 1, resolution);
+                index[5] = getIndex(z, x + 1, resolution);
+            }
+        }
+    });
+
+    return buffers;
+}
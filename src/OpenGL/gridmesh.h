@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <QMutex>
+#include <qopengl.h>
+
+/**
+ * GridMesh
+ *
+ * The vertices and triangle indexes of a flat square grid, resolution
+ * vertices along an edge. Built on the CPU without an OpenGL context. The
+ * indexes are 32 bit so any resolution can be drawn in a single call. The
+ * buffers are built in parallel rows and the most recent grids are cached,
+ * grids of the same resolution and order share their buffers.
+ */
+class GridMesh
+{
+public:
+    // Order the triangles are indexed in
+    enum Order
+    {
+        ROWS, // Row by row
+        CACHE, // Column bands narrow enough to reuse the vertex cache
+        QUADRANTS // Each quarter of the grid in turn, CACHE order within it
+    };
+
+    // Build (or reuse) a grid with resolution^2 vertices
+    GridMesh(int resolution, Order order = ROWS);
+
+    // Vertices along an edge
+    int resolution() const;
+
+    // Positions (x, 0, z) from 0 to 1, row by row
+    std::vector<GLfloat> const &vertices() const;
+
+    // Two triangles per quad, for GL_TRIANGLES with GL_UNSIGNED_INT
+    std::vector<GLuint> const &indexes() const;
+
+    // First index and number of indexes of a quarter (QUADRANTS order),
+    // 0 top left, 1 top right, 2 bottom left, 3 bottom right
+    int quadrantOffset(int quadrant) const;
+    int quadrantCount() const;
+
+    // Number of grids kept in the cache
+    static const int CACHE_SIZE = 4;
+
+    // Vertices the CACHE order expects the GPU vertex cache to hold
+    static const int CACHE_VERTICES = 32;
+
+    // Average cache miss ratio of triangle indexes, vertices transformed per
+    // triangle with a first in first out cache (0.5 is ideal for a grid)
+    static double acmr(std::vector<GLuint> const &indexes,
+                       int cache = CACHE_VERTICES);
+
+private:
+    struct Buffers
+    {
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint> indexes;
+    };
+
+    // Generate the buffers of a grid
+    static std::shared_ptr<const Buffers> _build(int resolution, Order order);
+
+    // Most recently used grids first, keyed by resolution and order
+    static QMutex _cache_mutex;
+    static std::vector<std::pair<std::pair<int, int>,
+                                 std::shared_ptr<const Buffers>>> _cache;
+
+    int _resolution;
+    std::shared_ptr<const Buffers> _buffers;
+};
@@ -40,9 +40,14 @@ OpenGL::OpenGL(QWidget *parent) : QOpenGLWidget(parent)
     this->setFormat(fmt);
 
     // Create a terrain object with a set resolution
-    // WARNING: Maxed out at around 256^2 vertices
     this->_terrain = new Terrain(256);
 
+    // Draw again once a quadtree built in the background is ready
+    QObject::connect(this->_terrain->quadtreeWatcher(),
+                     &QFutureWatcherBase::finished,
+                     this,
+                     QOverload<>::of(&QWidget::update));
+
     // Create camera
     this->_camera = new Camera;
 
@@ -140,6 +145,21 @@ void OpenGL::setTerrainDrawLines(bool lines)
     this->update();
 }
 
+/**
+ * setTerrainLevelOfDetail
+ * 
+ * Set whether the terrain is drawn with level of detail patches or the
+ * uniform mesh.
+ * 
+ * @param bool level_of_detail : Whether or not to use level of detail.
+ */
+void OpenGL::setTerrainLevelOfDetail(bool level_of_detail)
+{
+    Q_CHECK_PTR(this->_terrain);
+    this->_terrain->setLevelOfDetail(level_of_detail);
+    this->update();
+}
+
 /**
  * setTerrainColor
  * 
@@ -222,6 +242,19 @@ bool OpenGL::terrainDrawLines()
     return this->_terrain->drawLines();
 }
 
+/**
+ * terrainLevelOfDetail
+ * 
+ * Get whether the terrain is drawn with level of detail.
+ * 
+ * @returns bool : Whether level of detail is used.
+ */
+bool OpenGL::terrainLevelOfDetail()
+{
+    Q_CHECK_PTR(this->_terrain);
+    return this->_terrain->levelOfDetail();
+}
+
 /**
  * terrainColor
  * 
@@ -621,14 +654,20 @@ void OpenGL::camZoom(int value)
  * @param QImage normal_map : The new normal map.
  * @param QImage height_map : The new height map.
  * @param QImage albedo_map : The new albedo map.
+ * @param QRect normal_region : The area of the normal map that changed.
+ * @param IntensityMap heights : The values of the height map.
  */
 void OpenGL::nodeeditorOutputUpdated(QImage normal_map,
                                      QImage height_map,
-                                     QImage albedo_map)
+                                     QImage albedo_map,
+                                     QRect normal_region,
+                                     IntensityMap heights)
 {
     Q_CHECK_PTR(this->_terrain);
-    this->_terrain->setHeightMap(height_map);
-    this->_terrain->setNormalMap(normal_map);
+    this->makeCurrent();
+    this->_terrain->setHeightMap(height_map, heights);
+    this->_terrain->updateNormalMap(normal_map, normal_region);
     this->_terrain->setAlbedoMap(albedo_map);
+    this->doneCurrent();
     this->update();
 }
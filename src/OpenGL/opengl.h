@@ -6,6 +6,7 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLWidget>
 #include <QPoint>
+#include <QRect>
 #include <QSlider>
 #include <QWheelEvent>
 #include <QWidget>
@@ -35,6 +36,7 @@ public:
     void setTerrainColor(QColor color);
     void setTerrainLineColor(QColor color);
     void setTerrainMeshResolution(int resolution);
+    void setTerrainLevelOfDetail(bool level_of_detail);
 
     // Set light values
     void setSkyColor(QColor color);
@@ -42,6 +44,7 @@ public:
 
     // Get values
     bool terrainDrawLines();
+    bool terrainLevelOfDetail();
     QColor terrainColor();
     QColor terrainLineColor();
     QColor skyColor();
@@ -60,7 +63,9 @@ public slots:
     // Called when the nodeeditor has updated normal and height maps
     void nodeeditorOutputUpdated(QImage normal_map,
                                  QImage height_map,
-                                 QImage albedo_map);
+                                 QImage albedo_map,
+                                 QRect normal_region,
+                                 IntensityMap heights);
 
 protected:
     // Initialize gl functions and settings
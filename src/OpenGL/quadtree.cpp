@@ -0,0 +1,330 @@
+#include "quadtree.h"
+
+#include <math.h>
+
+#include <QtGlobal>
+
+#include "Globals/parallel.h"
+
+/**
+ * sample
+ *
+ * Reads the height map at a terrain position with linear interpolation
+ * between the pixel centers, the same as the height texture is read.
+ *
+ * @param IntensityMap& heights : The height map.
+ * @param double u : The x position from 0 to 1.
+ * @param double v : The z position from 0 to 1.
+ *
+ * @returns double : The height.
+ */
+static double sample(IntensityMap &heights, double u, double v)
+{
+    double x = u * heights.width - 0.50;
+    double y = v * heights.height - 0.50;
+    int x_0 = (int)floor(x);
+    int y_0 = (int)floor(y);
+    double t_x = x - x_0;
+    double t_y = y - y_0;
+
+    double top = heights.at(x_0, y_0, true) * (1.00 - t_x)
+                 + heights.at(x_0 + 1, y_0, true) * t_x;
+    double bottom = heights.at(x_0, y_0 + 1, true) * (1.00 - t_x)
+                    + heights.at(x_0 + 1, y_0 + 1, true) * t_x;
+    return top * (1.00 - t_y) + bottom * t_y;
+}
+
+/**
+ * Quadtree
+ *
+ * Creates a tree of a single flat node.
+ */
+Quadtree::Quadtree() : Quadtree(IntensityMap(1, 1, 0.00), PATCH) {}
+
+/**
+ * Quadtree
+ *
+ * Builds the tree over a height map. Nodes are split until a patch covers
+ * about a pixel per quad. The height range of every node comes from the min
+ * max pyramid of the map. The error of a node is how far its patch is from
+ * the patches of its children at the vertices they add (the children refine
+ * the node's triangles so this is the largest difference between the two),
+ * plus the largest error of its children. Leaves are at the map resolution
+ * and have no error.
+ *
+ * @param IntensityMap heights : The height map, stretched over the terrain.
+ * @param int patch : Quads along an edge of a patch (even).
+ */
+Quadtree::Quadtree(IntensityMap heights, int patch) : _patch(patch)
+{
+    Q_ASSERT(patch >= 2 && patch % 2 == 0);
+
+    int size = qMax(heights.width, heights.height);
+    while ((long long)patch << (this->_levels - 1) < size)
+        this->_levels++;
+
+    // Nodes level by level from the root, the children of a node are added
+    // together so each level is a consecutive run
+    std::vector<int> starts{0};
+    this->_nodes.push_back(
+        Node{0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, this->_levels - 1, -1});
+    for (size_t i = 0; i < this->_nodes.size(); i++)
+    {
+        Node parent = this->_nodes[i];
+        if (parent.level == 0)
+            continue;
+
+        if (i == (size_t)starts.back())
+            starts.push_back((int)this->_nodes.size());
+
+        this->_nodes[i].children = (int)this->_nodes.size();
+        float half = parent.size / 2.0f;
+        for (int quadrant = 0; quadrant < 4; quadrant++)
+        {
+            this->_nodes.push_back(Node{parent.x + (quadrant % 2) * half,
+                                        parent.z + (quadrant / 2) * half,
+                                        half,
+                                        0.0f,
+                                        0.0f,
+                                        0.0f,
+                                        parent.level - 1,
+                                        -1});
+        }
+    }
+    starts.push_back((int)this->_nodes.size());
+
+    // Height ranges, the pixels that can be read within the node (one more
+    // on each side for the interpolation). The pyramid is built first as the
+    // nodes query it from several threads
+    heights.buildPyramid();
+    parallelFor((int)this->_nodes.size(), [&](int i) {
+        Node &node = this->_nodes[i];
+        int x_0 = (int)floor(node.x * heights.width) - 1;
+        int y_0 = (int)floor(node.z * heights.height) - 1;
+        int x_1 = (int)ceil((node.x + node.size) * heights.width);
+        int y_1 = (int)ceil((node.z + node.size) * heights.height);
+        node.min = (float)heights.minimum(x_0, y_0, x_1, y_1);
+        node.max = (float)heights.maximum(x_0, y_0, x_1, y_1);
+    });
+
+    // Errors from the level above the leaves up to the root, starts is by
+    // depth from the root
+    int samples = patch * 2 + 1;
+    for (int level = 1; level < this->_levels; level++)
+    {
+        int depth = this->_levels - 1 - level;
+        int start = starts[depth];
+        int count = starts[depth + 1] - start;
+        parallelFor(count, [&](int i) {
+            Node &node = this->_nodes[start + i];
+            Q_ASSERT(node.children >= 0);
+
+            // Heights at the vertices of the children's patches, the even
+            // ones are the node's vertices
+            std::vector<double> h((size_t)samples * samples);
+            double step = node.size / (double)(samples - 1);
+            for (int z = 0; z < samples; z++)
+                for (int x = 0; x < samples; x++)
+                    h[(size_t)z * samples + x] =
+                        sample(heights, node.x + x * step, node.z + z * step);
+
+            // Compare the added vertices with the node's triangles, the
+            // diagonal of a quad goes from (x, z + 1) to (x + 1, z)
+            auto at = [&](int x, int z) { return h[(size_t)z * samples + x]; };
+            double error = 0.00;
+            for (int z = 0; z < samples; z++)
+            {
+                for (int x = z % 2 == 0 ? 1 : 0; x < samples; x += 2)
+                {
+                    double drawn;
+                    if (z % 2 == 0)
+                        drawn = (at(x - 1, z) + at(x + 1, z)) / 2.00;
+                    else if (x % 2 == 0)
+                        drawn = (at(x, z - 1) + at(x, z + 1)) / 2.00;
+                    else
+                        drawn = (at(x - 1, z + 1) + at(x + 1, z - 1)) / 2.00;
+                    error = qMax(error, qAbs(at(x, z) - drawn));
+                }
+            }
+
+            float children = 0.0f;
+            for (int quadrant = 0; quadrant < 4; quadrant++)
+                children = qMax(children,
+                                this->_nodes[node.children + quadrant].error);
+
+            node.error = (float)error + children;
+        });
+    }
+}
+
+/**
+ * select
+ *
+ * Selects the patches to draw for a camera, they cover the terrain once. A
+ * node is drawn at its own level when it is outside the range of the level
+ * below, when its error is within the tolerance, or when it is a leaf.
+ * Otherwise each child is selected in turn, and the quarters of the children
+ * that are outside their own range are drawn at the node's level. Neighbours
+ * are at most a level apart where the ranges decide, so morphing each level
+ * into the next at the end of its range closes the seams. Nodes kept whole
+ * by the tolerance can leave gaps no larger than it.
+ *
+ * @param QVector3D camera : The camera position in terrain space.
+ * @param float detail : The range of a level, in sizes of its nodes.
+ * @param float tolerance : The error allowed without splitting a node.
+ *
+ * @returns std::vector<Quadtree::Patch> : The patches to draw.
+ */
+std::vector<Quadtree::Patch> Quadtree::select(QVector3D camera,
+                                              float detail,
+                                              float tolerance) const
+{
+    std::vector<Patch> patches;
+    this->_select(0, camera, detail, tolerance, &patches);
+    return patches;
+}
+
+/**
+ * range
+ *
+ * The distance from the camera a level is drawn within, detail sizes of its
+ * nodes. Each level doubles the range of the one below.
+ *
+ * @param int level : The level, 0 for the leaves.
+ * @param float detail : The range in node sizes.
+ *
+ * @returns float : The range in terrain space.
+ */
+float Quadtree::range(int level, float detail) const
+{
+    return detail * ldexp(1.0f, level - (this->_levels - 1));
+}
+
+/**
+ * morph
+ *
+ * The distances over which the vertices of a level slide onto the vertices
+ * of the next level, the last third of the level's range. The root has
+ * nothing to morph into.
+ *
+ * @param int level : The level, 0 for the leaves.
+ * @param float detail : The range in node sizes.
+ *
+ * @returns QVector2D : The start and end distances.
+ */
+QVector2D Quadtree::morph(int level, float detail) const
+{
+    if (level >= this->_levels - 1)
+        return QVector2D(0.0f, 0.0f);
+
+    float end = this->range(level, detail);
+    float previous = level > 0 ? this->range(level - 1, detail) : 0.0f;
+    return QVector2D(previous + (end - previous) * 0.66f, end);
+}
+
+/**
+ * patch
+ *
+ * The number of quads along an edge of a patch.
+ *
+ * @returns int : The patch size.
+ */
+int Quadtree::patch() const
+{
+    return this->_patch;
+}
+
+/**
+ * levels
+ *
+ * The number of levels, the root is at levels() - 1.
+ *
+ * @returns int : The number of levels.
+ */
+int Quadtree::levels() const
+{
+    return this->_levels;
+}
+
+/**
+ * nodes
+ *
+ * The nodes of the tree, the root first.
+ *
+ * @returns std::vector<Quadtree::Node> const& : The nodes.
+ */
+std::vector<Quadtree::Node> const &Quadtree::nodes() const
+{
+    return this->_nodes;
+}
+
+/**
+ * _select
+ *
+ * Recursive part of select.
+ *
+ * @param int index : The node.
+ * @param QVector3D camera : The camera position in terrain space.
+ * @param float detail : The range in node sizes.
+ * @param float tolerance : The error allowed without splitting a node.
+ * @param std::vector<Patch>* patches : The selected patches, appended to.
+ *
+ * @returns bool : False if the node is outside its range and was not drawn.
+ */
+bool Quadtree::_select(int index,
+                       QVector3D camera,
+                       float detail,
+                       float tolerance,
+                       std::vector<Patch> *patches) const
+{
+    Q_CHECK_PTR(patches);
+    Node const &node = this->_nodes[index];
+
+    // The root is drawn at any distance
+    if (index != 0
+        && !this->_within(node, camera, this->range(node.level, detail)))
+        return false;
+
+    if (node.children < 0
+        || node.error <= tolerance
+        || !this->_within(node, camera, this->range(node.level - 1, detail)))
+    {
+        patches->push_back(Patch{node.x, node.z, node.size, node.level, -1});
+        return true;
+    }
+
+    for (int quadrant = 0; quadrant < 4; quadrant++)
+    {
+        if (!this->_select(node.children + quadrant,
+                           camera,
+                           detail,
+                           tolerance,
+                           patches))
+        {
+            patches->push_back(
+                Patch{node.x, node.z, node.size, node.level, quadrant});
+        }
+    }
+    return true;
+}
+
+/**
+ * _within
+ *
+ * Whether the closest point of a node's box is within a distance.
+ *
+ * @param Quadtree::Node const& node : The node.
+ * @param QVector3D camera : The camera position in terrain space.
+ * @param float distance : The distance.
+ *
+ * @returns bool : Whether the box is within the distance.
+ */
+bool Quadtree::_within(Node const &node,
+                       QVector3D camera,
+                       float distance) const
+{
+    float x = qBound(node.x, camera.x(), node.x + node.size) - camera.x();
+    float y = qBound(node.min, camera.y(), node.max) - camera.y();
+    float z = qBound(node.z, camera.z(), node.z + node.size) - camera.z();
+    return x * x + y * y + z * z <= distance * distance;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include <QVector2D>
+#include <QVector3D>
+
+#include "Nodeeditor/Datatypes/intensitymap.h"
+
+/**
+ * Quadtree
+ *
+ * Continuous level of detail (CDLOD) selection for the terrain. The unit
+ * square of the terrain is split into a quadtree down to leaves where a patch
+ * of PATCH quads matches the height map pixels. Every node keeps its height
+ * range and an error bound, the furthest the surface drawn with the node's
+ * patch can be from the full detail surface. Selection walks the tree from
+ * the camera, nodes within the range of a finer level are split unless their
+ * error is within the tolerance, so the vertex count follows the view rather
+ * than the map size. Positions are in terrain space, x and z from 0 to 1 and
+ * the height from 0 to 1.
+ */
+class Quadtree
+{
+public:
+    // A node of the tree, the 4 children are consecutive
+    struct Node
+    {
+        float x;
+        float z;
+        float size;
+        float min; // Height range
+        float max;
+        float error; // Bound on the distance to the full detail surface
+        int level; // 0 for the leaves
+        int children; // Index of the first child, -1 for the leaves
+    };
+
+    // An area to draw with a patch of the node's level
+    struct Patch
+    {
+        float x; // Node area
+        float z;
+        float size;
+        int level;
+        int quadrant; // The quarter of the node to draw, -1 for all of it
+    };
+
+    // Quads along an edge of a patch
+    static const int PATCH = 32;
+
+    // Range of a level in node sizes, and the error drawn without splitting
+    static constexpr float DETAIL = 2.00f;
+    static constexpr float TOLERANCE = 0.001f;
+
+    // A single flat node
+    Quadtree();
+
+    // Build the tree over a height map
+    Quadtree(IntensityMap heights, int patch = PATCH);
+
+    // Select the patches to draw from a camera position (terrain space)
+    std::vector<Patch> select(QVector3D camera,
+                              float detail = DETAIL,
+                              float tolerance = TOLERANCE) const;
+
+    // Distance within which a level is drawn
+    float range(int level, float detail = DETAIL) const;
+
+    // Distances over which a level morphs into the next (start, end), no
+    // morphing if end is not past start
+    QVector2D morph(int level, float detail = DETAIL) const;
+
+    int patch() const;
+    int levels() const;
+    std::vector<Node> const &nodes() const;
+
+private:
+    // Select a node or its children, false if the node is out of its range
+    bool _select(int index,
+                 QVector3D camera,
+                 float detail,
+                 float tolerance,
+                 std::vector<Patch> *patches) const;
+
+    // Whether any of the node's box is within a distance of the camera
+    bool _within(Node const &node, QVector3D camera, float distance) const;
+
+    int _patch;
+    int _levels = 1;
+    std::vector<Node> _nodes;
+};
@@ -4,7 +4,11 @@
 #include <QDir>
 #include <QFile>
 #include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLPixelTransferOptions>
 #include <QOpenGLShader>
+#include <QVector4D>
+#include <QtConcurrent>
 
 #include <GL/gl.h>
 
@@ -14,16 +18,15 @@
  * Terrain
  * 
  * Create the terrain handler class with the set resolution of vertices along
- * an edge. Total vertices are resolution squared.
+ * an edge. Total vertices are resolution squared, the mesh is generated when
+ * created.
  * 
  * @param int resolution : The size of the vertices along a single edge.
  */
-Terrain::Terrain(int resolution)
+Terrain::Terrain(int resolution) : _mesh(resolution, GridMesh::CACHE)
 {
     Q_ASSERT(resolution > 0);
     qDebug("Setting up terrain");
-    // When created set the supplied resolution
-    this->setResolution(resolution);
 
     // Translate the plane over to center it to (0, 0, 0)
     this->_transform.scale(2.0f);
@@ -44,14 +47,9 @@ void Terrain::initializeGL()
     ", and Attaching buffers");
     int res = 1;
 
-    QImage height(res, res, QImage::Format_Indexed8);
-    height.setColorCount(1);
-    height.setColor(0, qRgba(0, 0, 0, 255));
+    QImage height(res, res, QImage::Format_Grayscale16);
     height.fill(0);
-
-    this->_height = new QOpenGLTexture(height.mirrored());
-    this->_height->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-    this->_height->setMagnificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    this->setHeightMap(height, IntensityMap(res, res, 0.00));
 
     // Once transforms are applied in fragment shader the color (128, 128, 255)
     // or (0.5, 0.5, 1.0) becomes (0, 1, 0) normal vector
@@ -61,6 +59,7 @@ void Terrain::initializeGL()
     normal.fill(0);
 
     this->_normal = new QOpenGLTexture(normal.mirrored());
+    this->_normal_size = normal.size();
     this->_normal->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
     this->_normal->setMagnificationFilter(QOpenGLTexture::LinearMipMapLinear);
 
@@ -101,12 +100,15 @@ void Terrain::initializeGL()
     this->_vao.create();
     this->_vao.bind();
 
-    // Create, bind, and allocate vertex buffer data
+    // Create and bind the vertex and index buffers, the index buffer binding
+    // is kept by the vertex array object
     this->_vertex_buffer.create();
     this->_vertex_buffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     this->_vertex_buffer.bind();
-    this->_vertex_buffer.allocate(this->_vertices.constData(),
-                                  this->_vertices.size() * sizeof(GLfloat));
+    this->_index_buffer.create();
+    this->_index_buffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    this->_index_buffer.bind();
+    this->_uploadMesh();
 
     // Set vertex buffer data on the shader
     this->_program.enableAttributeArray("vertex");
@@ -130,6 +132,23 @@ void Terrain::setDrawLines(bool lines)
     this->_draw_lines = lines;
 }
 
+/**
+ * setLevelOfDetail
+ * 
+ * Set whether to draw the terrain with quadtree patches, more vertices near
+ * the camera and fewer far away, instead of the uniform grid.
+ * 
+ * @param bool level_of_detail : Whether or not to use level of detail.
+ */
+void Terrain::setLevelOfDetail(bool level_of_detail)
+{
+    this->_level_of_detail = level_of_detail;
+    this->_mesh_changed = true;
+
+    if (level_of_detail && this->_quadtree_changed)
+        this->_buildQuadtree();
+}
+
 /**
  * setTerrainColor
  * 
@@ -168,6 +187,18 @@ bool Terrain::drawLines()
     return this->_draw_lines;
 }
 
+/**
+ * levelOfDetail
+ * 
+ * Get whether the terrain is drawn with level of detail.
+ * 
+ * @returns bool : Whether or not level of detail is used.
+ */
+bool Terrain::levelOfDetail()
+{
+    return this->_level_of_detail;
+}
+
 /**
  * terrainColor
  * 
@@ -194,6 +225,19 @@ QColor Terrain::lineColor()
                             this->_line_color.z());
 }
 
+/**
+ * quadtreeWatcher
+ * 
+ * The watcher of the quadtree built in the background, finished when a new
+ * quadtree is ready to be swapped in at the next paint.
+ * 
+ * @returns QFutureWatcherBase* : The watcher.
+ */
+QFutureWatcherBase *Terrain::quadtreeWatcher()
+{
+    return &this->_quadtree_watcher;
+}
+
 /**
  * paintGl
  * 
@@ -216,6 +260,22 @@ void Terrain::paintGL(QOpenGLFunctions *f,
                       QVector3D ambient)
 {
     Q_CHECK_PTR(f);
+
+    // Select the patches once for both passes, the camera is moved into
+    // terrain space (0 to 1). Until a new quadtree is built the last one is
+    // used
+    if (this->_level_of_detail)
+    {
+        if (this->_quadtree_building
+            && this->_quadtree_watcher.future().isFinished())
+        {
+            this->_quadtree = this->_quadtree_watcher.future().result();
+            this->_quadtree_building = false;
+        }
+        QVector3D camera = this->_transform.inverted().map(camera_pos);
+        this->_patches = this->_quadtree.select(camera);
+    }
+
     // Draw the terrain
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     this->_paintGL(f,
@@ -269,11 +329,12 @@ void Terrain::_paintGL(QOpenGLFunctions *f,
                        bool lines_mode)
 {
     Q_CHECK_PTR(f);
-    // Bind the buffers
+    // Bind the buffers, the mesh is only uploaded when it changed
     this->_vao.bind();
     this->_vertex_buffer.bind();
-    this->_vertex_buffer.allocate(this->_vertices.constData(),
-                                  this->_vertices.size() * sizeof(GLfloat));
+    this->_index_buffer.bind();
+    if (this->_mesh_changed)
+        this->_uploadMesh();
 
     // Bind the shader
     this->_program.bind();
@@ -300,6 +361,9 @@ void Terrain::_paintGL(QOpenGLFunctions *f,
     this->_program.setUniformValue("ambient_color", ambient);
     // Set lines mode toggle
     this->_program.setUniformValue("lines", lines_mode);
+    // Camera in terrain space for morphing the level of detail
+    this->_program.setUniformValue(
+        "lod_camera", this->_transform.inverted().map(camera_pos));
 
     // Attach textures
     f->glActiveTexture(GL_TEXTURE0);
@@ -368,11 +432,8 @@ void Terrain::_paintGL(QOpenGLFunctions *f,
     this->_program.setUniformValue("normal_map", GL_TEXTURE1 - GL_TEXTURE0);
     this->_program.setUniformValue("albedo_map", GL_TEXTURE2 - GL_TEXTURE0);
 
-    // Draw the terrain
-    f->glDrawElements(GL_TRIANGLES,
-                      this->_indexes.size(),
-                      GL_UNSIGNED_SHORT,
-                      this->_indexes.constData());
+    // Draw the terrain from the bound index buffer
+    this->_draw(f);
 
     // Release the textures
     this->_height->release();
@@ -382,94 +443,167 @@ void Terrain::_paintGL(QOpenGLFunctions *f,
     this->_program.release();
 
     // Release the buffers
-    this->_vertex_buffer.release();
     this->_vao.release();
+    this->_vertex_buffer.release();
+    this->_index_buffer.release();
 }
 
 /**
- * getIndex
- * 
- * Converts an x and y 2D index to a 1Dimensional index value with the
- * resolution. Used for the vertices index reference
- * 
- * @param int row : The row.
- * @param int col : The col.
- * @param int resolution : The size of the mesh.
+ * _draw
+ *
+ * Draws the uniform grid, or every selected patch with its area and the
+ * distances its level morphs over. Patches covering a quarter of their node
+ * only draw the indexes of that quarter.
+ *
+ * @param QOpenGLFunctions* f : The valid opengl functions.
  */
-static int getIndex(int row, int col, int resolution)
+void Terrain::_draw(QOpenGLFunctions *f)
 {
-    Q_ASSERT(resolution > 0);
-    return row * resolution + col;
+    Q_CHECK_PTR(f);
+    if (!this->_level_of_detail)
+    {
+        int quads = qMax(this->_mesh.resolution() - 1, 1);
+        this->_program.setUniformValue("patch_area",
+                                       QVector4D(0.0f, 0.0f, 1.0f, quads));
+        this->_program.setUniformValue("morph", QVector2D(0.0f, 0.0f));
+        f->glDrawElements(GL_TRIANGLES,
+                          (GLsizei)this->_mesh.indexes().size(),
+                          GL_UNSIGNED_INT,
+                          nullptr);
+        return;
+    }
+
+    int quads = this->_patch_mesh.resolution() - 1;
+    for (Quadtree::Patch const &patch : this->_patches)
+    {
+        this->_program.setUniformValue(
+            "patch_area", QVector4D(patch.x, patch.z, patch.size, quads));
+        this->_program.setUniformValue("morph",
+                                       this->_quadtree.morph(patch.level));
+
+        size_t offset = 0;
+        GLsizei count = (GLsizei)this->_patch_mesh.indexes().size();
+        if (patch.quadrant >= 0)
+        {
+            offset = this->_patch_mesh.quadrantOffset(patch.quadrant);
+            count = this->_patch_mesh.quadrantCount();
+        }
+
+        f->glDrawElements(GL_TRIANGLES,
+                          count,
+                          GL_UNSIGNED_INT,
+                          (void *)(offset * sizeof(GLuint)));
+    }
+}
+
+/**
+ * _buildQuadtree
+ *
+ * Builds the quadtree of the latest heights on a pool thread, paintGL swaps
+ * it in once it is done. A build still running for older heights is left to
+ * finish and its quadtree dropped.
+ */
+void Terrain::_buildQuadtree()
+{
+    IntensityMap heights = std::move(this->_quadtree_heights);
+    this->_quadtree_heights = IntensityMap();
+    this->_quadtree_changed = false;
+    this->_quadtree_building = true;
+
+    this->_quadtree_watcher.setFuture(QtConcurrent::run(
+        [heights]() { return Quadtree(heights); }));
+}
+
+/**
+ * _uploadMesh
+ *
+ * Copies the mesh (the grid or the patch) into the bound vertex and index
+ * buffers.
+ */
+void Terrain::_uploadMesh()
+{
+    GridMesh const &mesh =
+        this->_level_of_detail ? this->_patch_mesh : this->_mesh;
+    std::vector<GLfloat> const &vertices = mesh.vertices();
+    std::vector<GLuint> const &indexes = mesh.indexes();
+    this->_vertex_buffer.allocate(vertices.data(),
+                                  (int)(vertices.size() * sizeof(GLfloat)));
+    this->_index_buffer.allocate(indexes.data(),
+                                 (int)(indexes.size() * sizeof(GLuint)));
+    this->_mesh_changed = false;
 }
 
 /**
  * setResolution
  * 
- * Sets the resolution of the mesh along an edge.
+ * Sets the resolution of the mesh along an edge. Recently used meshes come
+ * from the GridMesh cache, the mesh is uploaded the next time the terrain is
+ * drawn.
  * 
  * @param int resolution : The new resolution of the mesh.
  */
 void Terrain::setResolution(int resolution)
 {
-    qDebug("Generating terrain mesh: (%dx%d), %d vertices",
+    if (resolution == this->_mesh.resolution())
+        return;
+
+    qDebug("Setting terrain mesh: (%dx%d), %d vertices",
            resolution,
            resolution,
            resolution * resolution);
 
-    // Clear existing vertex data
-    this->_vertices.clear();
-    this->_indexes.clear();
-
-    // Generate terrain
-    for (int z = 0; z < resolution; z++) // row
-    {
-        for (int x = 0; x < resolution; x++) // col
-        {
-            // Does not include additional uv values as they are encoded in the
-            // x and z components since the terrain is generated as a range from
-            // 0 to 1
-            this->_vertices
-                << (float)x / (float)(resolution - 1)
-                << 0.0f
-                << (float)z / (float)(resolution - 1);
-
-            // Generates the indexes for drawing triangles
-            if (x < resolution - 1 && z > 0)
-            {
-                // index = row * resolution + col
-                // a   b+-+c
-                // b    |/
-                // c   a+
-                this->_indexes << getIndex(z, x, resolution);
-                this->_indexes << getIndex(z - 1, x, resolution);
-                this->_indexes << getIndex(z - 1, x + 1, resolution);
-
-                // a      +c
-                // d     /|
-                // d   a+-+d
-                this->_indexes << getIndex(z, x, resolution);
-                this->_indexes << getIndex(z - 1, x + 1, resolution);
-                this->_indexes << getIndex(z, x + 1, resolution);
-            }
-        }
-    }
+    this->_mesh = GridMesh(resolution, GridMesh::CACHE);
+    this->_mesh_changed = true;
 }
 
 /**
  * setHeightMap
  * 
- * Set the height map image.
+ * Set the height map image. The texture is a single 16 bit channel, the
+ * image is uploaded as is when it is already single channel 16 bit. A height
+ * map of the same size is written into the existing texture storage, only a
+ * new size allocates a new texture. The quadtree for the level of detail is
+ * built from the heights in the background, or kept for when the level of
+ * detail is turned on.
  * 
  * @param QImage height_map : The height map image.
+ * @param IntensityMap heights : The values of the height map.
  */
-void Terrain::setHeightMap(QImage height_map)
+void Terrain::setHeightMap(QImage height_map, IntensityMap heights)
 {
-    Q_CHECK_PTR(this->_height);
     qDebug("Updating Height Map");
-    delete this->_height;
-    this->_height = new QOpenGLTexture(height_map);
-    this->_height->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-    this->_height->setMagnificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    this->_quadtree_heights = std::move(heights);
+    this->_quadtree_changed = true;
+    if (this->_level_of_detail)
+        this->_buildQuadtree();
+
+    if (height_map.format() != QImage::Format_Grayscale16)
+        height_map = height_map.convertToFormat(QImage::Format_Grayscale16);
+
+    if (!this->_height || height_map.size() != this->_height_size)
+    {
+        delete this->_height;
+        this->_height = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        this->_height->setSize(height_map.width(), height_map.height());
+        this->_height->setFormat(QOpenGLTexture::R16_UNorm);
+        this->_height->setMipLevels(this->_height->maximumMipLevels());
+        this->_height->setAutoMipMapGenerationEnabled(false);
+        this->_height->allocateStorage(QOpenGLTexture::Red,
+                                       QOpenGLTexture::UInt16);
+        this->_height->setMinificationFilter(
+            QOpenGLTexture::LinearMipMapLinear);
+        this->_height->setMagnificationFilter(QOpenGLTexture::Linear);
+        this->_height_size = height_map.size();
+    }
+
+    // Rows of the image are 4 byte aligned
+    QOpenGLPixelTransferOptions options;
+    options.setAlignment(4);
+    this->_height->setData(QOpenGLTexture::Red,
+                           QOpenGLTexture::UInt16,
+                           height_map.constBits(),
+                           &options);
+    this->_height->generateMipMaps();
 }
 
 /**
@@ -487,6 +621,53 @@ void Terrain::setNormalMap(QImage normal_map)
     this->_normal = new QOpenGLTexture(normal_map);
     this->_normal->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
     this->_normal->setMagnificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    this->_normal_size = normal_map.size();
+}
+
+/**
+ * updateNormalMap
+ * 
+ * Updates the normal map texture where the normal map changed. Only the
+ * changed area is uploaded when the texture already has the size of the
+ * normal map, otherwise the whole texture is replaced.
+ * 
+ * @param QImage normal_map : The normal map image.
+ * @param QRect region : The area of the normal map that changed.
+ */
+void Terrain::updateNormalMap(QImage normal_map, QRect region)
+{
+    Q_CHECK_PTR(this->_normal);
+    if (normal_map.size() != this->_normal_size
+        || region.contains(normal_map.rect()))
+    {
+        this->setNormalMap(normal_map);
+        return;
+    }
+
+    region = region.intersected(normal_map.rect());
+    if (region.isEmpty())
+        return;
+
+    qDebug("Updating Normal Map region");
+
+    // Rows of the image are uploaded as is (same as QOpenGLTexture)
+    QImage patch =
+        normal_map.copy(region).convertToFormat(QImage::Format_RGBA8888);
+
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    this->_normal->bind();
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    f->glTexSubImage2D(GL_TEXTURE_2D,
+                       0,
+                       region.x(),
+                       region.y(),
+                       region.width(),
+                       region.height(),
+                       GL_RGBA,
+                       GL_UNSIGNED_BYTE,
+                       patch.constBits());
+    this->_normal->generateMipMaps();
+    this->_normal->release();
 }
 
 /**
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QFutureWatcher>
 #include <QImage>
 #include <QMatrix4x4>
 #include <QOpenGLBuffer>
@@ -7,6 +8,8 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
 #include <QOpenGLVertexArrayObject>
+#include <QRect>
+#include <QSize>
 #include <QVector> // Used here as QT replacement for std::vector
 #include <QVector2D>
 #include <QVector3D>
@@ -14,6 +17,10 @@
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
+#include "Nodeeditor/Datatypes/intensitymap.h"
+#include "gridmesh.h"
+#include "quadtree.h"
+
 /**
  * Terrain
  * 
@@ -39,22 +46,40 @@ public:
                  float light_intensity,
                  QVector3D ambient);
 
-    // Update the existing height/normal map textures
-    void setHeightMap(QImage height_map);
+    // Update the existing height/normal map textures, the heights (the
+    // values of the height map) are what the quadtree is built from
+    void setHeightMap(QImage height_map, IntensityMap heights);
     void setNormalMap(QImage normal_map);
+
+    // Upload only the changed area of the normal map
+    void updateNormalMap(QImage normal_map, QRect region);
     void setAlbedoMap(QImage albedo_map);
 
     // Set adjustable values
     void setDrawLines(bool lines);
+    void setLevelOfDetail(bool level_of_detail);
     void setTerrainColor(QColor color);
     void setLineColor(QColor color);
 
     // Get adjustable values
     bool drawLines();
+    bool levelOfDetail();
     QColor terrainColor();
     QColor lineColor();
 
+    // Reports when a quadtree built in the background is ready to swap in
+    QFutureWatcherBase *quadtreeWatcher();
+
 private:
+    // Upload the mesh to the vertex and index buffers
+    void _uploadMesh();
+
+    // Draw the uniform grid or the selected patches
+    void _draw(QOpenGLFunctions *f);
+
+    // Start building the quadtree of the latest heights in the background
+    void _buildQuadtree();
+
     // Draws the terrain
     void _paintGL(QOpenGLFunctions *f,
                   QMatrix4x4 camera_matrix,
@@ -71,22 +96,39 @@ private:
     QVector3D _line_color{1.0f, 1.0f, 1.0f};
     // Plane transform (translate -0.5, 0, -0.5)
     QMatrix4x4 _transform;
-    // Plane vertices
-    QVector<GLfloat> _vertices;
-    // Indexes for drawing plane with GL_TRIANGLES
-    QVector<GLushort> _indexes;
+    // Plane vertices and indexes for drawing with GL_TRIANGLES (in vertex
+    // cache order)
+    GridMesh _mesh;
+    // Whether the mesh changed since it was last uploaded
+    bool _mesh_changed = true;
+
+    // Level of detail, a patch drawn for every area the quadtree selects
+    bool _level_of_detail = false;
+    GridMesh _patch_mesh{Quadtree::PATCH + 1, GridMesh::QUADRANTS};
+    Quadtree _quadtree;
+    // Heights the quadtree is built from, kept until it is next needed
+    IntensityMap _quadtree_heights;
+    bool _quadtree_changed = false;
+    // The quadtree being built, swapped in once done
+    QFutureWatcher<Quadtree> _quadtree_watcher;
+    bool _quadtree_building = false;
+    std::vector<Quadtree::Patch> _patches;
 
     // Vertex array object
     QOpenGLVertexArrayObject _vao;
     // Vertex buffer data
     QOpenGLBuffer _vertex_buffer{QOpenGLBuffer::VertexBuffer};
+    // Index buffer data
+    QOpenGLBuffer _index_buffer{QOpenGLBuffer::IndexBuffer};
     // Shader program
     QOpenGLShaderProgram _program;
 
-    // Height map texture
-    QOpenGLTexture *_height;
+    // Height map texture (single 16 bit channel)
+    QOpenGLTexture *_height = nullptr;
+    QSize _height_size;
     // Normal map texture
     QOpenGLTexture *_normal;
+    QSize _normal_size;
     // Albedo map texture
     QOpenGLTexture *_albedo;
 };
\ No newline at end of file
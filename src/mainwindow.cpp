@@ -10,6 +10,7 @@
 #include <QComboBox>
 #include <QDebug>
 #include <QDialogButtonBox>
+#include <QDoubleSpinBox>
 #include <QDir>
 #include <QFile>
 #include <QFileDevice>
@@ -22,9 +23,11 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QList>
+#include <QMessageBox>
 #include <QObject>
 #include <QPushButton>
 #include <QRegExp>
+#include <QSpinBox>
 #include <QSplitter>
 #include <QTabWidget>
 #include <QTextBrowser>
@@ -38,6 +41,8 @@
 #include <nodes/FlowViewStyle>
 #include <nodes/NodeStyle>
 
+#include "Export/exportjob.h"
+#include "Export/meshexport.h"
 #include "Globals/drawing.h"
 #include "Globals/settings.h"
 #include "Globals/stencillist.h"
@@ -100,6 +105,17 @@ void MainWindow::setup(Ui::MainWindow *ui)
     this->_render_progress = new QDialog();
     this->_render_progress_ui.setupUi(this->_render_progress);
 
+    QObject::connect(this->_render_progress_ui.cancel,
+                     &QPushButton::clicked,
+                     [this]() {
+                         if (this->_export_job != nullptr)
+                         {
+                             this->_export_job->cancel();
+                             return;
+                         }
+                         this->_finishRender();
+                     });
+
     QObject::connect(this->_render_ui.directory_select,
                      &QPushButton::clicked,
                      [this]() {
@@ -131,31 +147,33 @@ void MainWindow::setup(Ui::MainWindow *ui)
                          SETTINGS->setRenderMode(true);
                      });
 
-    // Listen for editor to signal the dataflow diagram has updated the output
+    // Listen for editor to signal the dataflow diagram has updated the output,
+    // the changed region of the normal map is relative to the last output so
+    // after a render (which the view does not see) the whole map is uploaded
     QObject::connect(this->_editor,
                      &Nodeeditor::outputUpdated,
                      [this](QImage normal_map,
                             QImage height_map,
-                            QImage albedo_map) {
+                            QImage albedo_map,
+                            QRect normal_region) {
                          Q_CHECK_PTR(SETTINGS);
                          if (SETTINGS->runRender())
                          {
-                             normal_map.save(
-                                 QDir::cleanPath(
-                                     this->_render_directory + QString("/normalmap.png")));
-                             this->_render_progress_ui.progress->setValue(50);
-                             height_map.save(
-                                 QDir::cleanPath(
-                                     this->_render_directory + QString("/heightmap.png")));
-                             this->_render_progress_ui.progress->setValue(100);
-                             this->_render_progress->hide();
+                             this->_export(normal_map, albedo_map);
+                             this->_normal_stale = true;
                          }
                          else
                          {
+                             if (this->_normal_stale)
+                                 normal_region = normal_map.rect();
+                             this->_normal_stale = false;
+
                              this->_open_gl->nodeeditorOutputUpdated(
                                  normal_map,
                                  height_map,
-                                 albedo_map);
+                                 albedo_map,
+                                 normal_region,
+                                 this->_editor->getHeightValues());
                          }
                      });
 
@@ -201,6 +219,13 @@ void MainWindow::setup(Ui::MainWindow *ui)
         Q_CHECK_PTR(this->_open_gl);
         this->_open_gl->setTerrainDrawLines(state == 2);
     });
+    QObject::connect(this->_main_ui->level_of_detail,
+                     &QCheckBox::stateChanged,
+                     [this](int state)
+    {
+        Q_CHECK_PTR(this->_open_gl);
+        this->_open_gl->setTerrainLevelOfDetail(state == 2);
+    });
     QObject::connect(this->_main_ui->terrain_color,
                      &QPushButton::clicked,
                      [this]()
@@ -240,7 +265,7 @@ void MainWindow::setup(Ui::MainWindow *ui)
                      [this](int index)
     {
         Q_CHECK_PTR(this->_open_gl);
-        Q_BETWEEN(0, index, 4);
+        Q_BETWEEN(0, index, 7);
         SETTINGS->setMeshResolution((int)pow(2, index + 4));
         this->_open_gl->setTerrainMeshResolution((int)pow(2, index + 4));
     });
@@ -607,4 +632,115 @@ void MainWindow::load()
     this->_editor->load(document["nodes"].toObject());
 
     qDebug("Loading save file complete");
-}
\ No newline at end of file
+}
+
+/**
+ * _export
+ *
+ * Writes the rendered maps, and the mesh when selected, to the render
+ * directory in the background. The files are written at the same time and the
+ * progress dialogue shows the progress of all of them. A newer output replaces
+ * a job that is still running, the old job is cancelled and left to stop on
+ * its own threads. Every job deletes itself once finished, so the interface
+ * never waits for one. The heights are written from the height values in the
+ * selected format rather than from an image.
+ *
+ * @param QImage normal_map : The rendered normal map.
+ * @param QImage albedo_map : The rendered albedo map.
+ */
+void MainWindow::_export(QImage normal_map, QImage albedo_map)
+{
+    if (this->_export_job != nullptr)
+    {
+        QObject::disconnect(this->_export_job, nullptr, this, nullptr);
+        this->_export_job->cancel();
+    }
+
+    ExportJob *job = new ExportJob();
+    this->_export_job = job;
+
+    QDir directory(this->_render_directory);
+    job->addImage(directory.filePath("normalmap.png"), normal_map);
+    HeightExport::Format height_format =
+        (HeightExport::Format)this->_render_ui.height_format->currentIndex();
+    int compression = this->_render_ui.height_compression->value();
+    // The height and mesh tasks share the one copy of the heights
+    std::shared_ptr<IntensityMap const> heights =
+        std::make_shared<IntensityMap const>(
+            this->_editor->getHeightValues());
+
+    // Tiles are 2^k + 1 samples, from 129 up
+    int tiles = this->_render_ui.height_tiles->currentIndex();
+    if (tiles > 0)
+        job->addHeightTiles(directory.path(),
+                            "heightmap",
+                            height_format,
+                            heights,
+                            compression,
+                            (1 << (tiles + 6)) + 1);
+    else
+        job->addHeights(
+            directory.filePath(
+                "heightmap."
+                + HeightExport::extension(height_format, compression)),
+            height_format,
+            heights,
+            compression);
+    if (!albedo_map.isNull())
+        job->addImage(directory.filePath("albedomap.png"), albedo_map);
+
+    int mesh_format = this->_render_ui.mesh_format->currentIndex();
+    if (mesh_format > 0)
+    {
+        MeshExport::Format format = (MeshExport::Format)(mesh_format - 1);
+        job->addMesh(
+            directory.filePath("terrain." + MeshExport::extension(format)),
+            format,
+            heights,
+            this->_render_ui.mesh_tolerance->value());
+    }
+
+    // Signals arrive from the job's threads, queued to this (the UI) thread
+    QObject::connect(job,
+                     &ExportJob::progress,
+                     this,
+                     [this](int perc) {
+                         this->_render_progress_ui.progress->setValue(perc);
+                     });
+    QObject::connect(job,
+                     &ExportJob::finished,
+                     this,
+                     [this, job](bool success) {
+                         if (job != this->_export_job)
+                             return;
+
+                         if (!success && !job->cancelled())
+                             QMessageBox::warning(
+                                 this,
+                                 tr("Render"),
+                                 tr("Unable to write:\n")
+                                     + job->failed().join("\n"));
+
+                         this->_export_job = nullptr;
+                         this->_finishRender();
+                     });
+
+    // After the window's handler, which still reads the job
+    QObject::connect(job, &ExportJob::finished, job, &QObject::deleteLater);
+
+    job->start();
+}
+
+/**
+ * _finishRender
+ *
+ * Ends a render, the editor goes back to the preview (or render) mode the
+ * user selected and the progress dialogue is closed.
+ */
+void MainWindow::_finishRender()
+{
+    Q_CHECK_PTR(SETTINGS);
+    SETTINGS->setRunRender(false);
+    SETTINGS->setRenderMode(this->_main_ui->use_render->isChecked());
+    this->_render_progress->hide();
+}
@@ -5,6 +5,7 @@
 #include <QDockWidget>
 #include <QMainWindow>
 
+#include "Export/exportjob.h"
 #include "Nodeeditor/nodeeditor.h"
 #include "OpenGL/opengl.h"
 
@@ -49,6 +50,12 @@ private slots:
     void _saveAsTogglePack(bool checked);
 
 private:
+    // Write the rendered maps (and mesh) in the background
+    void _export(QImage normal_map, QImage albedo_map);
+
+    // Leave the render mode and close the progress dialogue
+    void _finishRender();
+
     // Information for saving/loading a project file
     QString _save_as_filename = "";
     QString _save_as_directory = QDir::homePath();
@@ -71,4 +78,10 @@ private:
     QDialog *_help;
     QDialog *_render;
     QDialog *_render_progress;
+
+    // Files of the current render being written, null when idle
+    ExportJob *_export_job = nullptr;
+
+    // The view's normal texture missed the outputs of a render
+    bool _normal_stale = false;
 };
\ No newline at end of file
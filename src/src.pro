@@ -24,7 +24,7 @@ DEFINES += QUAZIP_STATIC
 QMAKE_CXXFLAGS += -std=c++17
 
 # The QT libraries to be included
-QT += core gui opengl widgets help
+QT += core gui opengl widgets help concurrent
 
 # Include third party libraries (nodeeditor)
 INCLUDEPATH += $$PWD/../lib/nodeeditor/include
@@ -55,6 +55,9 @@ win32 {
     INCLUDEPATH += -LC:\MinGW\include
 }
 
+# (zlib, compressed height map exports)
+LIBS += -lz
+
 # (simplex noise)
 SOURCES += $$PWD/../lib/SimplexNoise/src/SimplexNoise.cpp
 HEADERS += $$PWD/../lib/SimplexNoise/src/SimplexNoise.h
@@ -6,8 +6,13 @@
 #include "./tests/vectormap_test.h"
 #include "./tests/pixmap_test.h"
 #include "./tests/converters_test.h"
+#include "./tests/bezier_test.h"
+#include "./tests/convolution_test.h"
+#include "./tests/fft_test.h"
 #include "./tests/normal_test.h"
+#include "./tests/erosion_test.h"
 #include "./tests/inputsimplexnoise_test.h"
+#include "./tests/spectralnoise_test.h"
 #include "./tests/inputtexture_test.h"
 #include "./tests/colorsplit_test.h"
 #include "./tests/colorcombine_test.h"
@@ -19,6 +24,12 @@
 #include "./tests/math_test.h"
 #include "./tests/vectormath_test.h"
 #include "./tests/settings_test.h"
+#include "./tests/gridmesh_test.h"
+#include "./tests/quadtree_test.h"
+#include "./tests/meshexport_test.h"
+#include "./tests/heightexport_test.h"
+#include "./tests/exportjob_test.h"
+#include "./tests/texturelist_test.h"
 
 int main(int argc, char *argv[])
 {
@@ -40,9 +51,14 @@ int main(int argc, char *argv[])
     ASSERT_TEST(new IntensityToVectorMapConverter_Test());
     ASSERT_TEST(new VectorToIntensityMapConverter_Test());
 
+    ASSERT_TEST(new BezierLookup_Test());
+    ASSERT_TEST(new Convolution_Test());
+    ASSERT_TEST(new FFT_Test());
     ASSERT_TEST(new NormalMapGenerator_Test());
+    ASSERT_TEST(new HydraulicErosion_Test());
 
     ASSERT_TEST(new InputSimplexNoiseNode_Test());
+    ASSERT_TEST(new InputSpectralNoiseNode_Test());
     ASSERT_TEST(new InputTextureNode_Test());
     ASSERT_TEST(new InputConstantValueNode_Test());
     ASSERT_TEST(new InputConstantVectorNode_Test());
@@ -57,6 +73,13 @@ int main(int argc, char *argv[])
     ASSERT_TEST(new ConverterVectorMathNode_Test());
 
     ASSERT_TEST(new Settings_Test());
+    ASSERT_TEST(new GridMesh_Test());
+    ASSERT_TEST(new Quadtree_Test());
+
+    ASSERT_TEST(new MeshExport_Test());
+    ASSERT_TEST(new HeightExport_Test());
+    ASSERT_TEST(new ExportJob_Test());
+    ASSERT_TEST(new TextureList_Test());
 
     return 0;
 }
\ No newline at end of file
@@ -5,7 +5,7 @@ CONFIG += console testcase
 QMAKE_CXXFLAGS += -std=c++17
 
 # The QT libraries to be included
-QT += core gui opengl widgets testlib
+QT += core gui opengl widgets testlib concurrent
 
 DEFINES += NODE_EDITOR_STATIC
 
@@ -13,6 +13,9 @@ DEFINES += NODE_EDITOR_STATIC
 INCLUDEPATH += $$PWD/../lib/nodeeditor/include
 LIBS += -L$$PWD/../lib/nodeeditor/build/lib -lnodes
 
+# (zlib, compressed height map exports)
+LIBS += -lz
+
 # (simplex noise)
 SOURCES += $$PWD/../lib/SimplexNoise/src/SimplexNoise.cpp
 HEADERS += $$PWD/../lib/SimplexNoise/src/SimplexNoise.h
@@ -30,10 +33,12 @@ UI_DIR = ../src/UI
 SOURCES += $$files("../src/Nodeeditor/*.cpp", true)
 SOURCES += $$files("../src/Globals/*.cpp", true)
 SOURCES += $$files("../src/OpenGL/*.cpp", true)
+SOURCES += $$files("../src/Export/*.cpp", true)
 
 HEADERS += $$files("../src/Nodeeditor/*.h", true)
 HEADERS += $$files("../src/Globals/*.h", true)
 HEADERS += $$files("../src/OpenGL/*.h", true)
+HEADERS += $$files("../src/Export/*.h", true)
 
 INCLUDEPATH += ../src
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include <QtTest>
+#include <QPointF>
+
+#include "../src/Nodeeditor/Nodes/BezierCurveWidget/bezierlookup.h"
+
+class BezierLookup_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void identity()
+    {
+        BezierLookup lookup;
+        QCOMPARE(lookup.value(0.00), 0.00);
+        QCOMPARE(lookup.value(0.25), 0.25);
+        QCOMPARE(lookup.value(1.00), 1.00);
+
+        // Clamped
+        QCOMPARE(lookup.value(-1.00), 0.00);
+        QCOMPARE(lookup.value(2.00), 1.00);
+    };
+
+    void line()
+    {
+        // Evenly spaced control points make a straight line
+        std::vector<QPointF> points{QPointF(0.00, 0.00),
+                                    QPointF(100.00 / 3.00, 100.00 / 3.00),
+                                    QPointF(200.00 / 3.00, 200.00 / 3.00),
+                                    QPointF(100.00, 100.00)};
+        BezierLookup lookup(points);
+        for (int i = 0; i <= 100; i++)
+            QVERIFY(qAbs(lookup.value(i / 100.00) - i / 100.00) < 1e-6);
+    };
+
+    void curve()
+    {
+        // Two beziers that do not cover the whole range
+        std::vector<QPointF> points{QPointF(10.00, 20.00),
+                                    QPointF(20.00, -10.00),
+                                    QPointF(30.00, 120.00),
+                                    QPointF(40.00, 50.00),
+                                    QPointF(45.00, 50.00),
+                                    QPointF(60.00, 0.00),
+                                    QPointF(80.00, 90.00)};
+        BezierLookup lookup(points);
+
+        // Flat before the first and after the last end point
+        QCOMPARE(lookup.value(0.00), 0.20);
+        QCOMPARE(lookup.value(0.05), 0.20);
+        QCOMPARE(lookup.value(0.90), 0.90);
+        QCOMPARE(lookup.value(1.00), 0.90);
+
+        // Passes through the shared end point
+        QVERIFY(qAbs(lookup.value(0.40) - 0.50) < 1e-3);
+
+        // The middle of the first bezier (t = 0.5)
+        double y = (20.00 + 3.00 * -10.00 + 3.00 * 120.00 + 50.00) / 8.00;
+        QVERIFY(qAbs(lookup.value(0.25) - y / 100.00) < 1e-4);
+    };
+};
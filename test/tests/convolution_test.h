@@ -0,0 +1,206 @@
+#pragma once
+
+#include <vector>
+
+#include <QtTest>
+
+#include "../src/Nodeeditor/Nodes/Convolution/convolution.h"
+
+#include "../src/Nodeeditor/Datatypes/intensitymap.h"
+
+class Convolution_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void separable()
+    {
+        // 0 0 0
+        // 0 1 0
+        // 0 0 0
+        std::vector<double> data{0.00, 0.00, 0.00,
+                                 0.00, 1.00, 0.00,
+                                 0.00, 0.00, 0.00};
+        IntensityMap map(3, 3, data);
+        std::vector<double> kernel_x{1.00, 2.00, 3.00};
+        std::vector<double> kernel_y{4.00, 5.00, 6.00};
+
+        // The impulse spreads into the (flipped) kernel
+        IntensityMap result =
+            Convolution(Convolution::FILL).separable(map, kernel_x, kernel_y);
+        QCOMPARE(result.at(0, 0), 3.00 * 6.00);
+        QCOMPARE(result.at(2, 0), 1.00 * 6.00);
+        QCOMPARE(result.at(1, 1), 2.00 * 5.00);
+        QCOMPARE(result.at(0, 2), 3.00 * 4.00);
+        QCOMPARE(result.at(2, 2), 1.00 * 4.00);
+    };
+
+    void borders()
+    {
+        // 1 2 3 4
+        std::vector<double> data{1.00, 2.00, 3.00, 4.00};
+        IntensityMap map(4, 1, data);
+        std::vector<double> kernel{1.00, 1.00, 1.00};
+        std::vector<double> single{1.00};
+
+        IntensityMap clamp =
+            Convolution(Convolution::CLAMP).separable(map, kernel, single);
+        QCOMPARE(clamp.at(0, 0), 1.00 + 1.00 + 2.00);
+        QCOMPARE(clamp.at(3, 0), 3.00 + 4.00 + 4.00);
+
+        IntensityMap mirror =
+            Convolution(Convolution::MIRROR).separable(map, kernel, single);
+        QCOMPARE(mirror.at(0, 0), 2.00 + 1.00 + 2.00);
+        QCOMPARE(mirror.at(3, 0), 3.00 + 4.00 + 3.00);
+
+        IntensityMap wrap =
+            Convolution(Convolution::WRAP).separable(map, kernel, single);
+        QCOMPARE(wrap.at(0, 0), 4.00 + 1.00 + 2.00);
+        QCOMPARE(wrap.at(3, 0), 3.00 + 4.00 + 1.00);
+
+        // Kernel rescaled to the 2 taps on the map
+        IntensityMap normalize =
+            Convolution(Convolution::NORMALIZE).separable(map, kernel, single);
+        QCOMPARE(normalize.at(0, 0), (1.00 + 2.00) * 3.00 / 2.00);
+        QCOMPARE(normalize.at(1, 0), 1.00 + 2.00 + 3.00);
+    };
+
+    void box()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 40 * 30; i++)
+            data.push_back((i * 7919 % 101) / 100.00);
+        IntensityMap map(40, 30, data);
+
+        // Same as the kernel of the box
+        for (int radius : {1, 4, 35})
+        {
+            std::vector<double> kernel(2 * radius + 1,
+                                       1.00 / (2 * radius + 1));
+            Convolution convolution(Convolution::MIRROR);
+            IntensityMap box = convolution.box(map, radius);
+            IntensityMap slow = convolution.separable(map, kernel, kernel);
+            for (int y = 0; y < map.height; y++)
+                for (int x = 0; x < map.width; x++)
+                    QVERIFY(qAbs(box.at(x, y) - slow.at(x, y)) < 1e-9);
+        }
+    };
+
+    void spectral()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 37 * 23; i++)
+            data.push_back((i * 7919 % 101) / 100.00);
+        IntensityMap map(37, 23, data);
+
+        std::vector<double> kernel_x{0.10, 0.50, 1.00, 0.30, 0.20};
+        std::vector<double> kernel_y{0.20, 0.60, 0.20};
+        IntensityMap kernel(5, 3);
+        for (double tap_y : kernel_y)
+            for (double tap_x : kernel_x)
+                kernel.append(tap_x * tap_y);
+
+        // Same as the direct passes for every border
+        for (int border = Convolution::CLAMP;
+             border <= Convolution::NORMALIZE;
+             border++)
+        {
+            Convolution convolution((Convolution::Border)border);
+            IntensityMap direct =
+                convolution.separable(map, kernel_x, kernel_y);
+            IntensityMap spectral = convolution.spectral(map, kernel);
+            IntensityMap taps = convolution.direct(map, kernel);
+            for (int y = 0; y < map.height; y++)
+            {
+                for (int x = 0; x < map.width; x++)
+                {
+                    QVERIFY(qAbs(direct.at(x, y) - spectral.at(x, y)) < 1e-9);
+                    QVERIFY(qAbs(direct.at(x, y) - taps.at(x, y)) < 1e-9);
+                }
+            }
+        }
+
+        // Large separable kernels go through the frequency domain
+        std::vector<double> large(101, 1.00 / 101.00);
+        Convolution convolution(Convolution::WRAP);
+        IntensityMap spectral = convolution.separable(map, large, large);
+        IntensityMap box = convolution.box(map, 50);
+        for (int y = 0; y < map.height; y++)
+            for (int x = 0; x < map.width; x++)
+                QVERIFY(qAbs(spectral.at(x, y) - box.at(x, y)) < 1e-9);
+    };
+
+    void smooth()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 9 * 7; i++)
+            data.push_back((i * 7919 % 101) / 100.00);
+        IntensityMap map(9, 7, data);
+
+        // The Smooth node's original 3x3 kernel, the edges divided by the
+        // weights of the taps on the map
+        double corner = 5.00;
+        double edge = 8.00;
+        double centre = 40.00;
+        double total = 4.00 * corner + 4.00 * edge + centre;
+        IntensityMap kernel(3, 3);
+        for (int j = -1; j <= 1; j++)
+            for (int i = -1; i <= 1; i++)
+                kernel.append((i == 0 && j == 0   ? centre
+                               : i == 0 || j == 0 ? edge
+                                                  : corner)
+                              / total);
+        IntensityMap result =
+            Convolution(Convolution::NORMALIZE).direct(map, kernel);
+
+        for (int y = 0; y < map.height; y++)
+        {
+            for (int x = 0; x < map.width; x++)
+            {
+                double sum = 0.00;
+                double weight = 0.00;
+                for (int j = -1; j <= 1; j++)
+                {
+                    for (int i = -1; i <= 1; i++)
+                    {
+                        if (x + i < 0 || x + i >= map.width
+                            || y + j < 0 || y + j >= map.height)
+                            continue;
+
+                        double tap = i == 0 && j == 0 ? centre
+                                     : i == 0 || j == 0 ? edge
+                                                        : corner;
+                        sum += tap * map.at(x + i, y + j);
+                        weight += tap;
+                    }
+                }
+                QVERIFY(qAbs(result.at(x, y) - sum / weight) < 1e-12);
+            }
+        }
+    };
+
+    void gaussian()
+    {
+        // A flat map stays flat
+        IntensityMap flat(64, 48, 0.30);
+        IntensityMap result = Convolution().gaussian(flat, 8.00);
+        for (int y = 0; y < flat.height; y++)
+            for (int x = 0; x < flat.width; x++)
+                QVERIFY(qAbs(result.at(x, y) - 0.30) < 1e-9);
+
+        // The boxes have the variance of the gaussian
+        double sigma = 10.00;
+        double variance = 0.00;
+        for (int radius : Convolution::gaussianBoxes(sigma))
+            variance += ((2 * radius + 1) * (2 * radius + 1) - 1) / 12.00;
+        QVERIFY(qAbs(sqrt(variance) - sigma) < 0.50);
+
+        // Kernel adds to 1 and peaks in the middle
+        std::vector<double> kernel = Convolution::gaussianKernel(1.50);
+        QCOMPARE((int)kernel.size(), 11);
+        double total = 0.00;
+        for (double tap : kernel)
+            total += tap;
+        QVERIFY(qAbs(total - 1.00) < 1e-9);
+        QVERIFY(kernel[5] > kernel[4] && kernel[5] > kernel[6]);
+    };
+};
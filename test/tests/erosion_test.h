@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QtTest>
+
+#include "../src/Nodeeditor/Nodes/Erosion/checkpoint.h"
+#include "../src/Nodeeditor/Nodes/Erosion/hydraulic.h"
+#include "../src/Nodeeditor/Nodes/Erosion/pipe.h"
+#include "../src/Nodeeditor/Nodes/Erosion/thermal.h"
+
+#include "../src/Nodeeditor/Datatypes/intensitymap.h"
+
+/**
+ * Sloped height map with some variation for the droplets to run down.
+ */
+static IntensityMap erosionTestMap(int size)
+{
+    std::vector<double> values;
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            values.push_back(0.5 + 0.25 * sin(x * 0.05) * cos(y * 0.07));
+    return IntensityMap(size, size, values);
+}
+
+/**
+ * Sum of the absolute difference between two maps.
+ */
+static double erosionTestChange(IntensityMap &a, IntensityMap &b)
+{
+    double change = 0.00;
+    for (int y = 0; y < a.height; y++)
+        for (int x = 0; x < a.width; x++)
+            change += fabs(a.at(x, y) - b.at(x, y));
+    return change;
+}
+
+class HydraulicErosion_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void sequential()
+    {
+        DropletParameters parameters;
+        parameters.erosion_radius = 2.00;
+
+        IntensityMap input = erosionTestMap(128);
+        IntensityMap a = input;
+        IntensityMap b = input;
+
+        IntensityMap sediment(128, 128, 0.00);
+        IntensityMap erosion(128, 128, 0.00);
+
+        HydraulicErosion(parameters).run(&a, nullptr, nullptr, 2000);
+        HydraulicErosion(parameters).run(&b, &sediment, &erosion, 2000);
+
+        // Tracking the debug maps does not change the terrain
+        QVERIFY(erosionTestChange(a, input) > 0.00);
+        QCOMPARE(erosionTestChange(a, b), 0.00);
+        QVERIFY(!sediment.usingFill());
+        QVERIFY(!erosion.usingFill());
+    };
+
+    void tiled()
+    {
+        DropletParameters parameters;
+        parameters.erosion_radius = 2.00;
+
+        IntensityMap input = erosionTestMap(256);
+        IntensityMap sequential = input;
+        IntensityMap a = input;
+        IntensityMap b = input;
+        IntensityMap sediment(256, 256, 0.00);
+
+        HydraulicErosion(parameters).run(&sequential, nullptr, nullptr, 5000);
+        HydraulicErosion(parameters).runTiled(&a, &sediment, nullptr, 5000);
+        HydraulicErosion(parameters).runTiled(&b, nullptr, nullptr, 5000);
+
+        // Deterministic for a seed
+        QCOMPARE(erosionTestChange(a, b), 0.00);
+
+        // Droplets moving between tiles keep eroding, the total change is
+        // close to simulating the droplets one after another
+        double tiled_change = erosionTestChange(a, input);
+        double sequential_change = erosionTestChange(sequential, input);
+        QVERIFY(tiled_change > 0.75 * sequential_change);
+        QVERIFY(tiled_change < 1.25 * sequential_change);
+
+        QVERIFY(!sediment.usingFill());
+    };
+
+    void tiledThreads()
+    {
+        DropletParameters parameters;
+        parameters.erosion_radius = 2.00;
+
+        IntensityMap input = erosionTestMap(512);
+
+        // The tiles and their droplets do not depend on the thread count, the
+        // result is the same on any machine
+        QThreadPool *pool = QThreadPool::globalInstance();
+        int threads = pool->maxThreadCount();
+
+        std::vector<IntensityMap> maps;
+        for (int count : {1, 2, 4, 8})
+        {
+            IntensityMap map = input;
+            pool->setMaxThreadCount(count);
+            HydraulicErosion(parameters).runTiled(&map, nullptr, nullptr, 5000);
+            maps.push_back(map);
+        }
+        pool->setMaxThreadCount(threads);
+
+        QVERIFY(erosionTestChange(maps[0], input) > 0.00);
+        for (size_t i = 1; i < maps.size(); i++)
+            QCOMPARE(erosionTestChange(maps[i], maps[0]), 0.00);
+    };
+
+    void pipe()
+    {
+        IntensityMap input = erosionTestMap(128);
+        IntensityMap a = input;
+        IntensityMap b = input;
+        IntensityMap sediment(128, 128, 0.00);
+        IntensityMap erosion(128, 128, 0.00);
+
+        PipeErosion(PipeParameters()).run(&a, &sediment, &erosion, 200);
+        PipeErosion(PipeParameters()).run(&b, nullptr, nullptr, 200);
+
+        QVERIFY(erosionTestChange(a, input) > 0.00);
+        QCOMPARE(erosionTestChange(a, b), 0.00);
+
+        // Material is only moved, what is eroded is deposited elsewhere
+        double before = 0.00;
+        double after = 0.00;
+        double deposited = 0.00;
+        double eroded = 0.00;
+        for (int y = 0; y < 128; y++)
+        {
+            for (int x = 0; x < 128; x++)
+            {
+                before += input.at(x, y);
+                after += a.at(x, y);
+                deposited += sediment.at(x, y);
+                eroded += erosion.at(x, y);
+            }
+        }
+        QVERIFY(fabs(after - before) < 1e-6);
+        QVERIFY(deposited > 0.00);
+        QVERIFY(eroded < 0.00);
+        QVERIFY(fabs(deposited + eroded) < 1e-6);
+
+        // A fill map comes out as a map of its pixels
+        IntensityMap flat(64, 64, 0.25);
+        PipeErosion(PipeParameters()).run(&flat, nullptr, nullptr, 10);
+        QVERIFY(!flat.usingFill());
+        QVERIFY(fabs(flat.at(10, 10) - 0.25) < 1e-9);
+    };
+
+    void thermal()
+    {
+        // Single spike on flat ground collapses into a cone
+        IntensityMap input(64, 64, std::vector<double>(64 * 64, 0.00));
+        input.set(32, 32, 1.00);
+
+        ThermalParameters parameters;
+        IntensityMap a = input;
+        ThermalErosion(parameters).run(&a, 300);
+
+        QVERIFY(a.at(32, 32) < 1.00);
+        QVERIFY(a.at(33, 32) > 0.00);
+
+        // Material is only moved
+        double before = 0.00;
+        double after = 0.00;
+        double steepest = 0.00;
+        for (int y = 0; y < 64; y++)
+        {
+            for (int x = 0; x < 64; x++)
+            {
+                before += input.at(x, y);
+                after += a.at(x, y);
+                if (x < 63)
+                    steepest = std::max(steepest,
+                                        fabs(a.at(x, y) - a.at(x + 1, y)));
+            }
+        }
+        QVERIFY(fabs(after - before) < 1e-9);
+
+        // Slopes settle close to the talus angle
+        double talus = tan(parameters.angle * M_PI / 180.00)
+                       / parameters.height_scale;
+        QVERIFY(steepest < talus * 1.05);
+
+        // Gentle slopes are left alone
+        IntensityMap gentle = erosionTestMap(64);
+        IntensityMap b = gentle;
+        parameters.angle = 80.00;
+        ThermalErosion(parameters).run(&b, 10);
+        QVERIFY(erosionTestChange(b, gentle) < 1e-9);
+
+        // A fill map comes out as a map of its pixels
+        IntensityMap flat(64, 64, 0.25);
+        ThermalErosion(parameters).run(&flat, 10);
+        QVERIFY(!flat.usingFill());
+        QCOMPARE(flat.at(10, 10), 0.25);
+    };
+
+    void checkpoint()
+    {
+        IntensityMap input = erosionTestMap(64);
+        QJsonObject settings;
+        settings["seed"] = 1;
+
+        QByteArray key = ErosionCheckpoint::createKey(input, settings);
+
+        // Same input and settings give the same key, also from a kept hash
+        QCOMPARE(ErosionCheckpoint::createKey(input, settings), key);
+        QCOMPARE(ErosionCheckpoint::createKey(
+                     ErosionCheckpoint::hashMap(input), settings),
+                 key);
+
+        settings["seed"] = 2;
+        QVERIFY(ErosionCheckpoint::createKey(input, settings) != key);
+
+        ErosionCheckpoint checkpoint(key, input);
+        HydraulicErosion(DropletParameters()).run(&checkpoint.height,
+                                                  &checkpoint.sediment,
+                                                  &checkpoint.erosion,
+                                                  500);
+        checkpoint.chunks = 1;
+
+        QTemporaryDir dir;
+        QString path = dir.filePath("erosion.checkpoint");
+        QVERIFY(checkpoint.save(path));
+
+        // Only loads for the same simulation
+        ErosionCheckpoint other;
+        QVERIFY(!other.load(path, QByteArray("other")));
+        QVERIFY(!other.valid());
+
+        ErosionCheckpoint loaded;
+        QVERIFY(loaded.load(path, key));
+        QVERIFY(loaded.valid());
+        QCOMPARE(loaded.chunks, 1);
+        QCOMPARE(erosionTestChange(loaded.height, checkpoint.height), 0.00);
+        QCOMPARE(erosionTestChange(loaded.sediment, checkpoint.sediment), 0.00);
+        QCOMPARE(erosionTestChange(loaded.erosion, checkpoint.erosion), 0.00);
+
+        // Chunks after the first use their own seed
+        QCOMPARE(ErosionCheckpoint::chunkSeed(7, 0), 7u);
+        QVERIFY(ErosionCheckpoint::chunkSeed(7, 1) != 7u);
+
+        // Maps that are not tracked are saved as their fill value
+        ErosionCheckpoint untracked(key, input);
+        QVERIFY(untracked.save(path));
+        QVERIFY(QFileInfo(path).size() < 64 * 64 * 8 + 1024);
+        QVERIFY(loaded.load(path, key));
+        QVERIFY(loaded.sediment.usingFill());
+        QCOMPARE(loaded.sediment.width, 64);
+    };
+
+    void chunks()
+    {
+        DropletParameters parameters;
+        parameters.erosion_radius = 2.00;
+
+        IntensityMap input = erosionTestMap(64);
+        QByteArray key = ErosionCheckpoint::createKey(input, QJsonObject());
+        auto simulate = [&parameters](IntensityMap *height,
+                                      IntensityMap *sediment,
+                                      IntensityMap *erosion,
+                                      int chunk) {
+            DropletParameters chunk_parameters = parameters;
+            chunk_parameters.seed =
+                ErosionCheckpoint::chunkSeed(parameters.seed, chunk);
+            HydraulicErosion(chunk_parameters)
+                .runTiled(height, sediment, erosion, 300);
+        };
+
+        // Every chunk at once
+        ErosionCheckpoint straight(key, input);
+        int snapshots = 0;
+        straight.advance(4, true, true, simulate, [&snapshots]() {
+            snapshots++;
+        });
+        QCOMPARE(straight.chunks, 4);
+        QCOMPARE(snapshots, 3);
+
+        // Continued in memory with more chunks
+        ErosionCheckpoint continued(key, input);
+        continued.advance(1, true, true, simulate);
+        continued.advance(4, true, true, simulate);
+
+        // Interrupted after two chunks and resumed from disk
+        QTemporaryDir dir;
+        QString path = ErosionCheckpoint::path(QDir(dir.path()), key);
+        ErosionCheckpoint interrupted(key, input);
+        interrupted.advance(2, true, true, simulate);
+        QVERIFY(interrupted.save(path));
+        ErosionCheckpoint resumed;
+        QVERIFY(resumed.load(path, key));
+        resumed.advance(4, true, true, simulate);
+
+        // All give the same maps, bit for bit
+        for (ErosionCheckpoint *checkpoint : {&continued, &resumed})
+        {
+            QCOMPARE(checkpoint->chunks, 4);
+            QVERIFY(checkpoint->height.values == straight.height.values);
+            QVERIFY(checkpoint->sediment.values == straight.sediment.values);
+            QVERIFY(checkpoint->erosion.values == straight.erosion.values);
+        }
+        QVERIFY(erosionTestChange(straight.height, input) > 0.00);
+    };
+
+    void prune()
+    {
+        QTemporaryDir dir;
+        QDir cache(dir.path());
+        QDateTime now = QDateTime::currentDateTime();
+
+        // Four files of 1000 bytes, oldest first
+        QStringList paths;
+        for (int i = 0; i < 4; i++)
+        {
+            QString path = ErosionCheckpoint::path(cache, QByteArray::number(i));
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(QByteArray(1000, 'x'));
+            file.flush();
+            file.setFileTime(now.addSecs(i - 10),
+                             QFileDevice::FileModificationTime);
+            file.close();
+            paths.append(path);
+        }
+        QFile other(cache.filePath("other.bin"));
+        QVERIFY(other.open(QIODevice::WriteOnly));
+        other.write(QByteArray(5000, 'x'));
+        other.close();
+
+        // The oldest go first, the kept file and other files stay
+        ErosionCheckpoint::prune(cache, 2500, paths[0]);
+        QVERIFY(QFile::exists(paths[0]));
+        QVERIFY(!QFile::exists(paths[1]));
+        QVERIFY(!QFile::exists(paths[2]));
+        QVERIFY(QFile::exists(paths[3]));
+        QVERIFY(QFile::exists(cache.filePath("other.bin")));
+
+        ErosionCheckpoint::prune(cache, 0);
+        QVERIFY(!QFile::exists(paths[0]));
+        QVERIFY(!QFile::exists(paths[3]));
+    };
+
+    void multigrid()
+    {
+        DropletParameters parameters;
+        parameters.erosion_radius = 2.00;
+
+        // Fits the base, a single level that matches the tiled simulation
+        IntensityMap small = erosionTestMap(128);
+        IntensityMap tiled = small;
+        HydraulicErosion(parameters).runMultigrid(&small,
+                                                  nullptr,
+                                                  nullptr,
+                                                  2000,
+                                                  128);
+        HydraulicErosion(parameters).runTiled(&tiled, nullptr, nullptr, 2000);
+        QCOMPARE(erosionTestChange(small, tiled), 0.00);
+
+        // Three levels (128, 256, 512)
+        IntensityMap input = erosionTestMap(512);
+        IntensityMap a = input;
+        IntensityMap b = input;
+        IntensityMap sediment(512, 512, 0.00);
+
+        HydraulicErosion(parameters).runMultigrid(&a,
+                                                  &sediment,
+                                                  nullptr,
+                                                  4000,
+                                                  128);
+        HydraulicErosion(parameters).runMultigrid(&b,
+                                                  nullptr,
+                                                  nullptr,
+                                                  4000,
+                                                  128);
+
+        QCOMPARE(a.width, 512);
+        QCOMPARE(a.height, 512);
+        QVERIFY(erosionTestChange(a, input) > 0.00);
+        QCOMPARE(erosionTestChange(a, b), 0.00);
+        QVERIFY(!sediment.usingFill());
+    };
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "../src/Export/exportjob.h"
+
+class ExportJob_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void write()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QImage image(64, 32, QImage::Format_Grayscale16);
+        image.fill(Qt::gray);
+
+        ExportJob job;
+        QSignalSpy spy(&job, &ExportJob::progress);
+        job.addImage(dir.filePath("height.png"), image);
+        job.addMesh(dir.filePath("terrain.ply"),
+                    MeshExport::PLY,
+                    std::make_shared<IntensityMap const>(33, 33, 0.50),
+                    0.01);
+        job.add(dir.filePath("text.txt"),
+                1.00,
+                [](QIODevice *device, ExportJob::Progress const &progress) {
+                    return device->write("terrain") == 7 && progress(1.00);
+                });
+        job.start();
+        QVERIFY(job.wait());
+        QVERIFY(!job.running());
+        QVERIFY(job.failed().isEmpty());
+
+        // Every file is written whole
+        QImage read(dir.filePath("height.png"));
+        QCOMPARE(read.size(), image.size());
+        QVERIFY(QFile::exists(dir.filePath("terrain.ply")));
+        QFile text(dir.filePath("text.txt"));
+        QVERIFY(text.open(QIODevice::ReadOnly));
+        QCOMPARE(text.readAll(), QByteArray("terrain"));
+
+        // Progress is reported in order up to the end
+        QVERIFY(spy.count() >= 2);
+        int last = -1;
+        for (QList<QVariant> const &args : spy)
+        {
+            QVERIFY(args.at(0).toInt() > last);
+            last = args.at(0).toInt();
+        }
+        QCOMPARE(last, 100);
+    };
+
+    void tiles()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        // 2 x 3 tiles named by column and row
+        std::shared_ptr<IntensityMap const> heights =
+            std::make_shared<IntensityMap const>(200, 300, 0.50);
+        ExportJob job;
+        job.addHeightTiles(dir.path(),
+                           "heights",
+                           HeightExport::R16,
+                           heights,
+                           0,
+                           129);
+        job.start();
+        QVERIFY(job.wait());
+
+        QStringList files = QDir(dir.path()).entryList(QDir::Files);
+        QCOMPARE(files.size(), 6);
+        QVERIFY(files.contains("heights_x1_y2.r16"));
+        QFile tile(dir.filePath("heights_x1_y2.r16"));
+        QCOMPARE(tile.size(), (qint64)129 * 129 * 2);
+    };
+
+    void fail()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        // A failed writer leaves no file and is reported
+        ExportJob job;
+        job.add(dir.filePath("fail.txt"),
+                1.00,
+                [](QIODevice *device, ExportJob::Progress const &) {
+                    device->write("partial");
+                    return false;
+                });
+        job.start();
+        QVERIFY(!job.wait());
+        QCOMPARE(job.failed(), QStringList{dir.filePath("fail.txt")});
+        QVERIFY(!QFile::exists(dir.filePath("fail.txt")));
+    };
+
+    void cancel()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        // A writer stops at the progress report after the cancel
+        ExportJob job;
+        std::atomic<bool> writing{false};
+        job.add(dir.filePath("cancel.txt"),
+                1.00,
+                [&writing](QIODevice *device,
+                           ExportJob::Progress const &progress) {
+                    writing = true;
+                    while (progress(0.50))
+                        device->write("partial");
+                    return false;
+                });
+        job.start();
+        while (!writing)
+            QThread::yieldCurrentThread();
+        job.cancel();
+
+        QVERIFY(!job.wait());
+        QVERIFY(job.cancelled());
+        QVERIFY(job.failed().isEmpty());
+        QVERIFY(!QFile::exists(dir.filePath("cancel.txt")));
+    };
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include <QtTest>
+
+#include "../src/Nodeeditor/Nodes/Convolution/fft.h"
+
+#include "../src/Nodeeditor/Datatypes/intensitymap.h"
+
+class FFT_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void forward()
+    {
+        // Power of two, mixed radix and prime sizes
+        int sizes[][2] = {{8, 8}, {12, 10}, {7, 13}};
+        for (auto &size : sizes)
+        {
+            int width = size[0];
+            int height = size[1];
+            std::vector<double> data;
+            for (int i = 0; i < width * height; i++)
+                data.push_back((i * 37 % 11) / 10.00);
+
+            FFT fft(width, height);
+            std::vector<FFT::Complex> spectrum =
+                fft.forward(IntensityMap(width, height, data));
+            QCOMPARE(fft.spectrumWidth(), width / 2 + 1);
+
+            // Same as the direct transform
+            int half = fft.spectrumWidth();
+            for (int ky = 0; ky < height; ky++)
+            {
+                for (int kx = 0; kx < half; kx++)
+                {
+                    FFT::Complex sum = 0.00;
+                    for (int y = 0; y < height; y++)
+                        for (int x = 0; x < width; x++)
+                            sum += data[y * width + x]
+                                   * std::polar(1.00,
+                                                -2.00 * M_PI
+                                                    * ((double)kx * x / width
+                                                       + (double)ky * y
+                                                             / height));
+
+                    QVERIFY(std::abs(sum - spectrum[ky * half + kx]) < 1e-9);
+                }
+            }
+        }
+    };
+
+    void inverse()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 30 * 18; i++)
+            data.push_back((i * 7919 % 101) / 100.00);
+
+        FFT fft(30, 18);
+        IntensityMap map = fft.inverse(fft.forward(IntensityMap(30, 18, data)));
+        for (int i = 0; i < 30 * 18; i++)
+            QVERIFY(qAbs(map.values[i] - data[i]) < 1e-12);
+    };
+
+    void fastSize()
+    {
+        QCOMPARE(FFT::fastSize(1), 1);
+        QCOMPARE(FFT::fastSize(97), 100);
+        QCOMPARE(FFT::fastSize(121), 125);
+        QCOMPARE(FFT::fastSize(1024), 1024);
+    };
+};
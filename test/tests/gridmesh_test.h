@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <QtTest>
+
+#include "../src/OpenGL/gridmesh.h"
+
+class GridMesh_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void small()
+    {
+        GridMesh mesh(3);
+        QCOMPARE(mesh.resolution(), 3);
+
+        std::vector<GLfloat> const &vertices = mesh.vertices();
+        QCOMPARE((int)vertices.size(), 3 * 3 * 3);
+        QCOMPARE(vertices[0], 0.0f);
+        QCOMPARE(vertices[3], 0.5f);
+        QCOMPARE(vertices[6], 1.0f);
+        QCOMPARE(vertices[6 * 3 + 2], 1.0f);
+
+        // Two triangles per quad
+        std::vector<GLuint> const &indexes = mesh.indexes();
+        QCOMPARE((int)indexes.size(), 2 * 2 * 6);
+        std::vector<GLuint> first{3, 0, 1, 3, 1, 4};
+        for (size_t i = 0; i < first.size(); i++)
+            QCOMPARE(indexes[i], first[i]);
+
+        // A single vertex has no triangles
+        GridMesh point(1);
+        QCOMPARE((int)point.vertices().size(), 3);
+        QCOMPARE((int)point.indexes().size(), 0);
+    };
+
+    void large()
+    {
+        // More vertices than 16 bit indexes can address
+        int resolution = 1024;
+        GridMesh mesh(resolution);
+        QCOMPARE((int)mesh.vertices().size(), resolution * resolution * 3);
+
+        std::vector<GLuint> const &indexes = mesh.indexes();
+        size_t quads = (size_t)(resolution - 1) * (resolution - 1);
+        QCOMPARE(indexes.size(), quads * 6);
+
+        GLuint last = (GLuint)(resolution * resolution - 1);
+        GLuint max = 0;
+        for (GLuint index : indexes)
+            max = qMax(max, index);
+        QCOMPARE(max, last);
+        QCOMPARE(indexes[indexes.size() - 1], last);
+    };
+
+    void quadrants()
+    {
+        GridMesh rows(9);
+        GridMesh quadrants(9, GridMesh::QUADRANTS);
+
+        // The same triangles in another order
+        std::vector<GLuint> const &indexes = quadrants.indexes();
+        QCOMPARE(indexes.size(), rows.indexes().size());
+        QCOMPARE(quadrants.quadrantCount(), 4 * 4 * 6);
+
+        // Each quarter only uses the vertices of its quarter
+        for (int quadrant = 0; quadrant < 4; quadrant++)
+        {
+            int left = (quadrant % 2) * 4;
+            int top = (quadrant / 2) * 4;
+            int offset = quadrants.quadrantOffset(quadrant);
+            for (int i = offset; i < offset + quadrants.quadrantCount(); i++)
+            {
+                int x = (int)indexes[i] % 9;
+                int z = (int)indexes[i] / 9;
+                QVERIFY(left <= x && x <= left + 4);
+                QVERIFY(top <= z && z <= top + 4);
+            }
+        }
+
+        std::vector<GLuint> sorted_rows = rows.indexes();
+        std::vector<GLuint> sorted_quadrants = indexes;
+        std::sort(sorted_rows.begin(), sorted_rows.end());
+        std::sort(sorted_quadrants.begin(), sorted_quadrants.end());
+        QVERIFY(sorted_rows == sorted_quadrants);
+    };
+
+    void cached()
+    {
+        // The same resolution shares its buffers
+        GridMesh first(64);
+        GridMesh second(64);
+        QCOMPARE(first.vertices().data(), second.vertices().data());
+        QCOMPARE(first.indexes().data(), second.indexes().data());
+
+        // But not with another order
+        GridMesh quadrants(65, GridMesh::QUADRANTS);
+        GridMesh rows(65);
+        QVERIFY(quadrants.indexes().data() != rows.indexes().data());
+
+        // Old grids leave the cache, copies keep their buffers
+        for (int i = 0; i < GridMesh::CACHE_SIZE; i++)
+            GridMesh other(8 + i);
+        GridMesh third(64);
+        QVERIFY(third.vertices().data() != first.vertices().data());
+        QVERIFY(third.indexes() == first.indexes());
+    };
+
+    void cacheOrder()
+    {
+        GridMesh rows(257);
+        GridMesh cache(257, GridMesh::CACHE);
+
+        // The same triangles
+        std::vector<GLuint> sorted_rows = rows.indexes();
+        std::vector<GLuint> sorted_cache = cache.indexes();
+        std::sort(sorted_rows.begin(), sorted_rows.end());
+        std::sort(sorted_cache.begin(), sorted_cache.end());
+        QVERIFY(sorted_rows == sorted_cache);
+
+        // Rows transform about every vertex twice, bands close to once
+        double rows_acmr = GridMesh::acmr(rows.indexes());
+        double cache_acmr = GridMesh::acmr(cache.indexes());
+        QVERIFY(rows_acmr > 0.95);
+        QVERIFY(cache_acmr < 0.60);
+
+        // Narrow grids fit the cache either way
+        QVERIFY(GridMesh::acmr(GridMesh(9).indexes()) < 0.70);
+
+        // Quarters are banded too
+        GridMesh patch(33, GridMesh::QUADRANTS);
+        QVERIFY(GridMesh::acmr(patch.indexes()) < 0.65);
+    };
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string.h>
+#include <memory>
+#include <vector>
+#include <zlib.h>
+
+#include <QBuffer>
+#include <QImage>
+#include <QtEndian>
+#include <QtTest>
+
+#include "../src/Export/heightexport.h"
+
+class HeightExport_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void raw()
+    {
+        // Taller than a band so rows come from several bands
+        IntensityMap map = this->_map(37, 150);
+
+        QByteArray r16 = this->_write(map, HeightExport::R16, 0);
+        QCOMPARE(r16.size(), 37 * 150 * 2);
+        uchar const *bytes = (uchar const *)r16.constData();
+        QCOMPARE(qFromLittleEndian<quint16>(bytes), (quint16)0);
+        QCOMPARE(qFromLittleEndian<quint16>(bytes + (40 * 37 + 5) * 2),
+                 (quint16)qRound(map.at(5, 40) * 65535.00));
+        QCOMPARE(qFromLittleEndian<quint16>(bytes + (149 * 37 + 5) * 2),
+                 (quint16)65535);
+
+        QByteArray r32 = this->_write(map, HeightExport::R32F, 0);
+        QCOMPARE(r32.size(), 37 * 150 * 4);
+        quint32 bits =
+            qFromLittleEndian<quint32>(r32.constData() + (80 * 37 + 20) * 4);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        QCOMPARE(value, (float)map.at(20, 80));
+
+        // PFM stores the bottom row first after its header
+        QByteArray pfm = this->_write(map, HeightExport::PFM, 0);
+        QVERIFY(pfm.startsWith("Pf\n37 150\n-1.0\n"));
+        QByteArray rows = pfm.mid(pfm.size() - 37 * 150 * 4);
+        QCOMPARE(rows.mid(0, 37 * 4), r32.mid(149 * 37 * 4, 37 * 4));
+
+        // Compressed files are gzip streams of the same bytes
+        QCOMPARE(this->_gunzip(this->_write(map, HeightExport::R16, 6)), r16);
+        QCOMPARE(this->_gunzip(this->_write(map, HeightExport::PFM, 1)), pfm);
+        QCOMPARE(HeightExport::extension(HeightExport::R32F, 6),
+                 QString("r32.gz"));
+    };
+
+    void png()
+    {
+        IntensityMap map = this->_map(70, 130);
+        for (int compression : {0, 9})
+        {
+            QByteArray data = this->_write(map, HeightExport::PNG, compression);
+            QImage image;
+            QVERIFY(image.loadFromData(data, "PNG"));
+            QCOMPARE(image.size(), QSize(70, 130));
+            QCOMPARE(image.format(), QImage::Format_Grayscale16);
+
+            bool same = true;
+            for (int y = 0; y < 130; y++)
+            {
+                quint16 const *line = (quint16 const *)image.constScanLine(y);
+                for (int x = 0; x < 70; x++)
+                    same = same
+                           && line[x]
+                                  == (quint16)qRound(qBound(0.00,
+                                                            map.at(x, y),
+                                                            1.00)
+                                                     * 65535.00);
+            }
+            QVERIFY(same);
+        }
+    };
+
+    void tiles()
+    {
+        // 3 x 2 tiles of 129 cover 300 x 200, stepping by 128
+        QCOMPARE(HeightExport::tileGrid(300, 200, 129), QSize(3, 2));
+        QCOMPARE(HeightExport::tileGrid(257, 257, 129), QSize(2, 2));
+        QCOMPARE(HeightExport::tileGrid(100, 1, 129), QSize(1, 1));
+        QCOMPARE(HeightExport::tileRegion(2, 1, 129),
+                 QRect(256, 128, 129, 129));
+
+        std::shared_ptr<IntensityMap> map =
+            std::make_shared<IntensityMap>(this->_map(300, 200));
+        auto tile = [&](int column, int row) {
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            HeightExport heights(map,
+                                 HeightExport::tileRegion(column, row, 129));
+            heights.write(&buffer, HeightExport::R32F);
+            return buffer.data();
+        };
+        auto sample = [](QByteArray const &data, int x, int y) {
+            char const *bytes = data.constData() + (y * 129 + x) * 4;
+            quint32 bits = qFromLittleEndian<quint32>(bytes);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        };
+
+        // Every tile is whole, neighbours share the edge samples
+        QByteArray first = tile(0, 0);
+        QByteArray right = tile(1, 0);
+        QByteArray last = tile(2, 1);
+        QCOMPARE(first.size(), 129 * 129 * 4);
+        QCOMPARE(last.size(), 129 * 129 * 4);
+        bool shared = true;
+        for (int y = 0; y < 129; y++)
+            shared = shared && sample(first, 128, y) == sample(right, 0, y);
+        QVERIFY(shared);
+        QCOMPARE(sample(right, 5, 7), (float)map->at(133, 7));
+
+        // Past the map the last row and column repeat
+        QCOMPARE(sample(last, 43, 71), (float)map->at(299, 199));
+        QCOMPARE(sample(last, 128, 128), (float)map->at(299, 199));
+        QCOMPARE(sample(last, 10, 128), (float)map->at(266, 199));
+    };
+
+    void progress()
+    {
+        IntensityMap map = this->_map(16, 300);
+        HeightExport heights(map, 1);
+
+        double last = 0.00;
+        bool rising = true;
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(heights.write(&buffer, HeightExport::PNG, [&](double done) {
+            rising = rising && done >= last;
+            last = done;
+            return true;
+        }));
+        QVERIFY(rising);
+        QCOMPARE(last, 1.00);
+
+        QBuffer stopped;
+        stopped.open(QIODevice::WriteOnly);
+        QVERIFY(!heights.write(&stopped, HeightExport::R16, [](double) {
+            return false;
+        }));
+    };
+
+private:
+    // A smooth slope with values outside 0 to 1 at the far corner
+    IntensityMap _map(int width, int height)
+    {
+        std::vector<double> values(width * height);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                values[y * width + x] = (x + y) / 100.00 + 0.001 * (x % 3);
+        return IntensityMap(width, height, values);
+    }
+
+    QByteArray _write(IntensityMap map,
+                      HeightExport::Format format,
+                      int compression)
+    {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        HeightExport heights(map, compression);
+        if (!heights.write(&buffer, format))
+            return QByteArray();
+        return buffer.data();
+    }
+
+    // Inflate a gzip stream, checking its crc32 and size
+    QByteArray _gunzip(QByteArray data)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, 16 + 15) != Z_OK)
+            return QByteArray();
+
+        QByteArray out(1 << 20, 0);
+        stream.next_in = (Bytef *)data.constData();
+        stream.avail_in = data.size();
+        stream.next_out = (Bytef *)out.data();
+        stream.avail_out = out.size();
+        int status = inflate(&stream, Z_FINISH);
+        out.resize(status == Z_STREAM_END ? (int)stream.total_out : 0);
+        inflateEnd(&stream);
+
+        return out;
+    }
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <QtTest>
 #include <QJsonObject>
 #include <QJsonValue>
@@ -179,6 +181,44 @@ private slots:
         QCOMPARE(this->node._shared_ui.spin_z->value(), 0.50);
     };
 
+    void perPixelParameters()
+    {
+        IntensityMap result;
+        SimplexNoiseWorker worker;
+
+        worker.set(IntensityMap(1, 1, 8.00),
+                   IntensityMap(1, 1, 5.00),
+                   IntensityMap(1, 1, 0.50),
+                   QVector3D(0.0f, 0.0f, 0.0f),
+                   &result);
+        worker.generate();
+        IntensityMap constant = result;
+
+        // Per pixel maps with the same value everywhere match the constants
+        worker.set(IntensityMap(2, 2, std::vector<double>(4, 8.00)),
+                   IntensityMap(2, 2, std::vector<double>(4, 5.00)),
+                   IntensityMap(2, 2, std::vector<double>(4, 0.50)),
+                   QVector3D(0.0f, 0.0f, 0.0f),
+                   &result);
+        worker.generate();
+        QCOMPARE(result.width, constant.width);
+        QVERIFY(result.values == constant.values);
+
+        // Only the left half uses fewer octives
+        std::vector<double> split{1.00, 8.00, 1.00, 8.00};
+        worker.set(IntensityMap(2, 2, split),
+                   IntensityMap(1, 1, 5.00),
+                   IntensityMap(1, 1, 0.50),
+                   QVector3D(0.0f, 0.0f, 0.0f),
+                   &result);
+        worker.generate();
+
+        int size = result.width;
+        QVERIFY(result.at(size / 4, size / 4) != constant.at(size / 4, size / 4));
+        QCOMPARE(result.at(3 * size / 4, size / 4),
+                 constant.at(3 * size / 4, size / 4));
+    };
+
 private:
     InputSimplexNoiseNode node;
 };
@@ -94,6 +94,37 @@ private slots:
         QCOMPARE(map.at(1, 1), 1.00);
     };
 
+    void heightImage()
+    {
+        // Odd width so the rows are padded
+        std::vector<double> values{0.00, 0.50, 1.00, 1.50, -1.00, 0.25};
+        IntensityMap map(3, 2, values);
+        QImage image = map.toHeightImage();
+        QCOMPARE(image.format(), QImage::Format_Grayscale16);
+        QCOMPARE(image.size(), QSize(3, 2));
+
+        quint16 const *top =
+            reinterpret_cast<quint16 const *>(image.constScanLine(0));
+        quint16 const *bottom =
+            reinterpret_cast<quint16 const *>(image.constScanLine(1));
+        QCOMPARE(top[0], (quint16)0);
+        QCOMPARE(top[1], (quint16)32768);
+        QCOMPARE(top[2], (quint16)65535);
+        QCOMPARE(bottom[0], (quint16)65535);
+        QCOMPARE(bottom[1], (quint16)0);
+        QCOMPARE(bottom[2], (quint16)16384);
+
+        // Reading the image back keeps 16 bits of precision
+        IntensityMap read(image, IntensityMap::RED);
+        QVERIFY(qAbs(read.at(1, 0) - 0.50) < 1.00 / 65535.00);
+        QVERIFY(qAbs(read.at(2, 1) - 0.25) < 1.00 / 65535.00);
+
+        // Fill maps
+        image = IntensityMap(4, 4, 0.75).toHeightImage();
+        QCOMPARE(reinterpret_cast<quint16 const *>(image.constScanLine(3))[3],
+                 (quint16)49151);
+    };
+
     void at()
     {
         std::vector<double> values{1.00, 2.00, 3.00, 4.00};
@@ -148,4 +179,103 @@ private slots:
         QCOMPARE(map.at(0, 1), 2.00);
         QCOMPARE(map.at(1, 1), 3.00);
     };
+
+    void regions()
+    {
+        std::vector<double> values;
+        for (int i = 0; i < 23 * 17; i++)
+            values.push_back((i * 7919 % 113) / 112.00);
+        IntensityMap map(23, 17, values);
+
+        // Every query against a scan of the region
+        int regions[][4] = {{0, 0, 22, 16},
+                            {3, 2, 3, 2},
+                            {5, 1, 18, 9},
+                            {-4, -4, 7, 30},
+                            {11, 8, 22, 16},
+                            {20, 3, 40, 5}};
+        for (auto const &r : regions)
+        {
+            double sum = 0.00;
+            double squares = 0.00;
+            double min = 1.00;
+            double max = 0.00;
+            int count = 0;
+            for (int y = qMax(r[1], 0); y <= qMin(r[3], 16); y++)
+            {
+                for (int x = qMax(r[0], 0); x <= qMin(r[2], 22); x++)
+                {
+                    double value = map.at(x, y);
+                    sum += value;
+                    squares += value * value;
+                    min = qMin(min, value);
+                    max = qMax(max, value);
+                    count++;
+                }
+            }
+            double mean = sum / count;
+            double variance = squares / count - mean * mean;
+
+            QVERIFY(qAbs(map.sum(r[0], r[1], r[2], r[3]) - sum) < 1e-9);
+            QVERIFY(qAbs(map.average(r[0], r[1], r[2], r[3]) - mean) < 1e-9);
+            QVERIFY(qAbs(map.variance(r[0], r[1], r[2], r[3]) - variance)
+                    < 1e-9);
+            QCOMPARE(map.minimum(r[0], r[1], r[2], r[3]), min);
+            QCOMPARE(map.maximum(r[0], r[1], r[2], r[3]), max);
+        }
+
+        // Empty regions
+        QCOMPARE(map.sum(5, 5, 4, 5), 0.00);
+        QCOMPARE(map.minimum(30, 0, 40, 5), 0.00);
+
+        // Setting a pixel drops the cached tables
+        QCOMPARE(map.minimum(), 0.00);
+        QCOMPARE(map.maximum(), 1.00);
+        map.set(4, 4, 5.00);
+        QCOMPARE(map.maximum(), 5.00);
+        QCOMPARE(map.maximum(0, 0, 3, 3) < 5.00, true);
+
+        // Writing values directly needs an invalidate
+        double sum = map.sum(0, 0, 22, 16);
+        map.values[0] += 1.00;
+        map.invalidate();
+        QVERIFY(qAbs(map.sum(0, 0, 22, 16) - (sum + 1.00)) < 1e-9);
+
+        // Fill maps
+        IntensityMap fill(8, 4, 0.25);
+        QCOMPARE(fill.sum(0, 0, 7, 3), 8.00);
+        QCOMPARE(fill.average(2, 1, 5, 2), 0.25);
+        QCOMPARE(fill.variance(2, 1, 5, 2), 0.00);
+        QCOMPARE(fill.minimum(), 0.25);
+        QCOMPARE(fill.maximum(1, 1, 2, 2), 0.25);
+    };
+
+    void copyRegions()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 8 * 8; i++)
+            data.push_back((i % 5) * 0.25);
+        IntensityMap map(8, 8, data);
+        double sum = map.sum(0, 0, 7, 7);
+        double min = map.minimum(0, 0, 7, 7);
+
+        // A copy does not answer from the tables of its source, even when
+        // it is written to before its first query
+        IntensityMap copy = map;
+        for (double &value : copy.values)
+            value -= 1.00;
+        QVERIFY(qAbs(copy.sum(0, 0, 7, 7) - (sum - 64.00)) < 1e-9);
+        QCOMPARE(copy.minimum(0, 0, 7, 7), min - 1.00);
+
+        // Assigned copies neither
+        IntensityMap assigned(2, 2, 0.00);
+        assigned.sum(0, 0, 1, 1);
+        assigned = map;
+        assigned.values[0] = -5.00;
+        QCOMPARE(assigned.minimum(0, 0, 7, 7), -5.00);
+
+        // The source is unchanged
+        QCOMPARE(map.sum(0, 0, 7, 7), sum);
+        QCOMPARE(map.minimum(0, 0, 7, 7), min);
+    };
 };
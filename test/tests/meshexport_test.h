@@ -0,0 +1,233 @@
+#pragma once
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include <QBuffer>
+#include <QtEndian>
+#include <QtTest>
+
+#include "../src/Export/meshexport.h"
+#include "../src/OpenGL/gridmesh.h"
+
+class MeshExport_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void flat()
+    {
+        // A flat map needs only the two corner triangles
+        MeshExport mesh(IntensityMap(100, 60, 0.25), 0.00);
+        QCOMPARE(mesh.gridSize(), 129);
+        QCOMPARE(mesh.vertexCount(), 4);
+        QCOMPARE(mesh.triangleCount(), 2);
+        QCOMPARE(mesh.height(64, 64), 0.25f);
+
+        // A map of the grid size is read as is
+        MeshExport exact(IntensityMap(65, 65, 0.50), 0.00);
+        QCOMPARE(exact.gridSize(), 65);
+    };
+
+    void tolerance()
+    {
+        int width = 65;
+        std::vector<double> values(width * width);
+        for (int y = 0; y < width; y++)
+            for (int x = 0; x < width; x++)
+                values[y * width + x] = 0.50
+                                        + 0.25 * sin(x * 0.11) * cos(y * 0.07)
+                                        + 0.002 * ((x * 7 + y * 13) % 3);
+        IntensityMap map(width, width, values);
+
+        // No tolerance keeps every vertex of the grid
+        MeshExport full(map, -1.00);
+        QCOMPARE(full.vertexCount(), width * width);
+        QCOMPARE(full.triangleCount(), (width - 1) * (width - 1) * 2);
+
+        int previous = full.triangleCount();
+        for (double tolerance : {0.005, 0.02, 0.10})
+        {
+            MeshExport mesh(map, tolerance);
+            QVERIFY(mesh.triangleCount() < previous);
+            previous = mesh.triangleCount();
+
+            int size = mesh.gridSize();
+            std::vector<bool> used(size * size, false);
+            std::vector<int> indexes;
+            mesh.triangles([&](int a, int b, int c) {
+                indexes.insert(indexes.end(), {a, b, c});
+                used[a] = used[b] = used[c] = true;
+            });
+            QCOMPARE((int)indexes.size(), mesh.triangleCount() * 3);
+            QCOMPARE((int)std::count(used.begin(), used.end(), true),
+                     mesh.vertexCount());
+
+            double error = 0.00;
+            bool cracks = false;
+            bool clockwise = false;
+            for (size_t i = 0; i < indexes.size(); i += 3)
+            {
+                int a_x = indexes[i] % size, a_y = indexes[i] / size;
+                int b_x = indexes[i + 1] % size, b_y = indexes[i + 1] / size;
+                int c_x = indexes[i + 2] % size, c_y = indexes[i + 2] / size;
+
+                // Counter clockwise seen from above
+                int area = (b_y - a_y) * (c_x - a_x)
+                           - (b_x - a_x) * (c_y - a_y);
+                clockwise = clockwise || area <= 0;
+
+                // Every sample within the triangle is within the tolerance
+                for (int y = qMin(a_y, qMin(b_y, c_y));
+                     y <= qMax(a_y, qMax(b_y, c_y));
+                     y++)
+                {
+                    for (int x = qMin(a_x, qMin(b_x, c_x));
+                         x <= qMax(a_x, qMax(b_x, c_x));
+                         x++)
+                    {
+                        int w_a = (b_y - y) * (c_x - x) - (b_x - x) * (c_y - y);
+                        int w_b = (c_y - y) * (a_x - x) - (c_x - x) * (a_y - y);
+                        int w_c = area - w_a - w_b;
+                        if (w_a < 0 || w_b < 0 || w_c < 0)
+                            continue;
+
+                        double plane = (mesh.height(a_x, a_y) * w_a
+                                        + mesh.height(b_x, b_y) * w_b
+                                        + mesh.height(c_x, c_y) * w_c)
+                                       / area;
+                        error = qMax(error, fabs(plane - mesh.height(x, y)));
+                    }
+                }
+
+                // No vertex is on an edge of another triangle (T junction)
+                int corners[] = {a_x, a_y, b_x, b_y, c_x, c_y, a_x, a_y};
+                for (int e = 0; e < 3; e++)
+                {
+                    int x_0 = corners[e * 2], y_0 = corners[e * 2 + 1];
+                    int x_1 = corners[e * 2 + 2], y_1 = corners[e * 2 + 3];
+                    int steps = qMax(abs(x_1 - x_0), abs(y_1 - y_0));
+                    for (int s = 1; s < steps; s++)
+                    {
+                        int x = x_0 + (x_1 - x_0) / steps * s;
+                        int y = y_0 + (y_1 - y_0) / steps * s;
+                        cracks = cracks || used[y * size + x];
+                    }
+                }
+            }
+            QVERIFY(error <= tolerance + 0.000001);
+            QVERIFY(!cracks);
+            QVERIFY(!clockwise);
+
+            // Neighbouring triangles share vertices in the split order
+            std::vector<GLuint> order(indexes.begin(), indexes.end());
+            QVERIFY(GridMesh::acmr(order) < 0.85);
+        }
+    };
+
+    void formats()
+    {
+        int width = 33;
+        std::vector<double> values(width * width);
+        for (int i = 0; i < width * width; i++)
+            values[i] = (i % width) * (i / width) / 1024.00;
+        MeshExport mesh(IntensityMap(width, width, values), 0.01);
+        int vertices = mesh.vertexCount();
+        int triangles = mesh.triangleCount();
+
+        // Wavefront, one line for every vertex and triangle
+        QBuffer obj;
+        obj.open(QIODevice::WriteOnly);
+        QVERIFY(mesh.write(&obj, MeshExport::OBJ));
+        QList<QByteArray> lines = obj.data().split('\n');
+        int v = 0;
+        int f = 0;
+        for (QByteArray const &line : lines)
+        {
+            v += line.startsWith("v ");
+            f += line.startsWith("f ");
+        }
+        QCOMPARE(v, vertices);
+        QCOMPARE(f, triangles);
+        QVERIFY(lines.contains("v 0 0 0"));
+        QVERIFY(lines.contains("v 1 1 1"));
+
+        // PLY, binary vertices (3 floats) and faces (count and 3 indexes)
+        QBuffer ply;
+        ply.open(QIODevice::WriteOnly);
+        QVERIFY(mesh.write(&ply, MeshExport::PLY));
+        QByteArray data = ply.data();
+        int header = data.indexOf("end_header\n") + 11;
+        QVERIFY(data.contains("element vertex "
+                              + QByteArray::number(vertices) + "\n"));
+        QVERIFY(data.contains("element face "
+                              + QByteArray::number(triangles) + "\n"));
+        QCOMPARE(data.size() - header, vertices * 12 + triangles * 13);
+
+        // Binary glTF, the header, JSON and BIN chunk lengths add up
+        QBuffer glb;
+        glb.open(QIODevice::WriteOnly);
+        QVERIFY(mesh.write(&glb, MeshExport::GLB));
+        data = glb.data();
+        uchar const *bytes = (uchar const *)data.constData();
+        QCOMPARE(qFromLittleEndian<quint32>(bytes), (quint32)0x46546C67);
+        QCOMPARE(qFromLittleEndian<quint32>(bytes + 4), (quint32)2);
+        QCOMPARE(qFromLittleEndian<quint32>(bytes + 8), (quint32)data.size());
+        quint32 json = qFromLittleEndian<quint32>(bytes + 12);
+        QCOMPARE(json % 4, (quint32)0);
+        quint32 binary = qFromLittleEndian<quint32>(bytes + 20 + json);
+        QCOMPARE(binary, (quint32)(vertices * 12 + triangles * 12));
+        QCOMPARE((quint32)data.size(), 28 + json + binary);
+
+        // Progress rises to the end, returning false stops the write
+        double last = 0.00;
+        bool rising = true;
+        QBuffer progress;
+        progress.open(QIODevice::WriteOnly);
+        QVERIFY(mesh.write(&progress, MeshExport::PLY, [&](double fraction) {
+            rising = rising && fraction >= last;
+            last = fraction;
+            return true;
+        }));
+        QVERIFY(rising);
+        QCOMPARE(last, 1.00);
+
+        QBuffer stopped;
+        stopped.open(QIODevice::WriteOnly);
+        QVERIFY(!mesh.write(&stopped, MeshExport::OBJ, [](double fraction) {
+            return fraction < 0.25;
+        }));
+    };
+
+    void build()
+    {
+        IntensityMap map(129, 129, 0.50);
+
+        // The build reports the levels done, up to the whole build
+        double last = 0.00;
+        bool rising = true;
+        MeshExport mesh(map, 0.00, [&](double fraction) {
+            rising = rising && fraction >= last;
+            last = fraction;
+            return true;
+        });
+        QVERIFY(mesh.built());
+        QVERIFY(rising);
+        QCOMPARE(last, 1.00);
+
+        // Returning false stops the build, the mesh can not be written
+        int reports = 0;
+        MeshExport stopped(map, 0.00, [&](double fraction) {
+            reports++;
+            return fraction < 0.25;
+        });
+        QVERIFY(!stopped.built());
+        QVERIFY(reports < 7);
+
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(!stopped.write(&buffer, MeshExport::OBJ));
+        QVERIFY(buffer.data().isEmpty());
+    };
+};
@@ -4,6 +4,8 @@
 
 #include <QtTest>
 #include <QImage>
+#include <QRect>
+#include <QSignalSpy>
 
 #include "../src/Nodeeditor/Nodes/Normal/normal.h"
 
@@ -49,6 +51,62 @@ private slots:
         QCOMPARE(color.alpha(), 255);
     };
 
+    void incremental()
+    {
+        std::vector<double> data;
+        for (int i = 0; i < 64 * 48; i++)
+            data.push_back((i % 7) * 0.01);
+
+        NormalWorker worker;
+        QSignalSpy spy(&worker, &NormalWorker::done);
+
+        worker.set(IntensityMap(64, 48, data));
+        worker.generate();
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.at(0).at(1).toRect(), QRect(0, 0, 64, 48));
+
+        // Only the changed pixel and its neighbours are generated again
+        data[20 * 64 + 10] += 0.05;
+        worker.set(IntensityMap(64, 48, data));
+        worker.generate();
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(spy.at(1).at(1).toRect(), QRect(9, 19, 3, 3));
+        QImage patched = spy.at(1).at(0).value<QImage>();
+
+        // Same as generating the whole map
+        NormalWorker fresh;
+        QSignalSpy fresh_spy(&fresh, &NormalWorker::done);
+        fresh.set(IntensityMap(64, 48, data));
+        fresh.generate();
+        QCOMPARE(patched, fresh_spy.at(0).at(0).value<QImage>());
+
+        // Nothing changed
+        worker.generate();
+        QCOMPARE(spy.count(), 3);
+        QVERIFY(spy.at(2).at(1).toRect().isEmpty());
+    };
+
+    void fill()
+    {
+        // A cliff on the right, the normal in the middle is out of the
+        // colour range and gets the fill colour
+        std::vector<double> data{0.00, 0.00, 1.00,
+                                 0.00, 0.00, 1.00,
+                                 0.00, 0.00, 1.00};
+
+        NormalWorker worker;
+        QSignalSpy spy(&worker, &NormalWorker::done);
+        worker.set(IntensityMap(3, 3, data));
+        worker.generate();
+        QCOMPARE(spy.count(), 1);
+
+        QColor color = spy.at(0).at(0).value<QImage>().pixelColor(1, 1);
+        QCOMPARE(color.red(), 0);
+        QCOMPARE(color.green(), 0);
+        QCOMPARE(color.blue(), 255);
+        QCOMPARE(color.alpha(), 255);
+    };
+
     // void benchmark()
     // {
     //     std::vector<double> data;
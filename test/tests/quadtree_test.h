@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include <QtTest>
+#include <QVector3D>
+
+#include "../src/OpenGL/quadtree.h"
+
+#include "../src/Nodeeditor/Datatypes/intensitymap.h"
+
+class Quadtree_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void flat()
+    {
+        Quadtree tree(IntensityMap(256, 256, 0.50));
+        QCOMPARE(tree.levels(), 4);
+        QCOMPARE((int)tree.nodes().size(), 1 + 4 + 16 + 64);
+
+        for (Quadtree::Node const &node : tree.nodes())
+        {
+            QCOMPARE(node.error, 0.0f);
+            QCOMPARE(node.min, 0.5f);
+            QCOMPARE(node.max, 0.5f);
+        }
+
+        // Nothing to refine, the root covers everything
+        std::vector<Quadtree::Patch> patches =
+            tree.select(QVector3D(0.0f, 0.5f, 0.0f));
+        QCOMPARE((int)patches.size(), 1);
+        QCOMPARE(patches[0].level, 3);
+        QCOMPARE(patches[0].quadrant, -1);
+    };
+
+    void bounds()
+    {
+        std::vector<double> values;
+        for (int i = 0; i < 256 * 256; i++)
+            values.push_back((i * 7919 % 1009) / 1008.00);
+        Quadtree tree(IntensityMap(256, 256, values));
+
+        std::vector<Quadtree::Node> const &nodes = tree.nodes();
+        QCOMPARE(nodes[0].min, 0.0f);
+        QCOMPARE(nodes[0].max, 1.0f);
+
+        // Errors include the children, heights contain the children
+        for (Quadtree::Node const &node : nodes)
+        {
+            if (node.children < 0)
+            {
+                QCOMPARE(node.level, 0);
+                QCOMPARE(node.error, 0.0f);
+                continue;
+            }
+
+            QVERIFY(node.error > 0.0f);
+            for (int quadrant = 0; quadrant < 4; quadrant++)
+            {
+                Quadtree::Node const &child = nodes[node.children + quadrant];
+                QCOMPARE(child.level, node.level - 1);
+                QCOMPARE(child.size, node.size / 2.0f);
+                QVERIFY(child.error <= node.error);
+                QVERIFY(child.min >= node.min);
+                QVERIFY(child.max <= node.max);
+            }
+        }
+
+        // Morphing ends with the range, the root does not morph
+        QCOMPARE(tree.morph(0).y(), tree.range(0));
+        QVERIFY(tree.morph(0).x() < tree.morph(0).y());
+        QCOMPARE(tree.morph(tree.levels() - 1).y(), 0.0f);
+    };
+
+    void select()
+    {
+        std::vector<double> values;
+        for (int i = 0; i < 256 * 256; i++)
+            values.push_back((i * 7919 % 1009) / 1008.00);
+        Quadtree tree(IntensityMap(256, 256, values));
+
+        QVector3D camera(0.0f, 0.5f, 0.0f);
+        std::vector<Quadtree::Patch> patches = tree.select(camera);
+
+        // The patches cover the terrain once
+        double area = 0.00;
+        for (Quadtree::Patch const &patch : patches)
+        {
+            double size = patch.size;
+            area += patch.quadrant < 0 ? size * size : size * size / 4.00;
+        }
+        QVERIFY(qAbs(area - 1.00) < 1e-6);
+
+        // Full detail under the camera, less far away
+        int near = -1;
+        int far = -1;
+        for (Quadtree::Patch const &patch : patches)
+        {
+            float x = patch.x;
+            float z = patch.z;
+            float size = patch.quadrant < 0 ? patch.size : patch.size / 2.0f;
+            if (patch.quadrant >= 0)
+            {
+                x += (patch.quadrant % 2) * size;
+                z += (patch.quadrant / 2) * size;
+            }
+
+            if (x == 0.0f && z == 0.0f)
+                near = patch.level;
+            if (x + size == 1.0f && z + size == 1.0f)
+                far = patch.level;
+        }
+        QCOMPARE(near, 0);
+        QVERIFY(far > near);
+
+        // Fewer vertices than the uniform grid of the same detail
+        int vertices = (int)patches.size() * (tree.patch() + 1)
+                       * (tree.patch() + 1);
+        QVERIFY(vertices < 256 * 256);
+    };
+};
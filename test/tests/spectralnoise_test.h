@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <QtTest>
+
+#include "../src/Nodeeditor/Nodes/spectralnoise.h"
+
+#include "../src/Nodeeditor/Datatypes/intensitymap.h"
+
+class InputSpectralNoiseNode_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void noise()
+    {
+        IntensityMap map = InputSpectralNoiseNode::noise(64, 2.00, 1);
+        QCOMPARE(map.width, 64);
+        QCOMPARE(map.height, 64);
+        QCOMPARE((int)map.values.size(), 64 * 64);
+
+        // Scaled to [0, 1]
+        double min = 1.00;
+        double max = 0.00;
+        for (double value : map.values)
+        {
+            min = qMin(min, value);
+            max = qMax(max, value);
+        }
+        QVERIFY(qAbs(min) < 1e-9);
+        QVERIFY(qAbs(max - 1.00) < 1e-9);
+
+        // Same seed same noise, other seeds differ
+        IntensityMap same = InputSpectralNoiseNode::noise(64, 2.00, 1);
+        IntensityMap other = InputSpectralNoiseNode::noise(64, 2.00, 2);
+        QVERIFY(map.values == same.values);
+        QVERIFY(map.values != other.values);
+    };
+
+    void progress()
+    {
+        // The progress ends at 1 and does not change the noise
+        std::vector<double> fractions;
+        IntensityMap map = InputSpectralNoiseNode::noise(
+            64, 2.00, 1, [&](double fraction) {
+                fractions.push_back(fraction);
+                return true;
+            });
+        QVERIFY(!fractions.empty());
+        QVERIFY(std::is_sorted(fractions.begin(), fractions.end()));
+        QCOMPARE(fractions.back(), 1.00);
+        QVERIFY(map.values
+                == InputSpectralNoiseNode::noise(64, 2.00, 1).values);
+
+        // Stopping gives an empty map
+        IntensityMap stopped = InputSpectralNoiseNode::noise(
+            64, 2.00, 1, [](double fraction) { return fraction < 0.50; });
+        QVERIFY(stopped.values.empty());
+    };
+
+    void worker()
+    {
+        // Only the last of the queued generations runs
+        SpectralNoiseWorker worker;
+        worker.set(32, 2.00, 3);
+        worker.set(64, 2.00, 1);
+        worker.generate();
+        QCOMPARE(worker.result().width, 1);
+        worker.generate();
+        QVERIFY(worker.result().values
+                == InputSpectralNoiseNode::noise(64, 2.00, 1).values);
+    };
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QColor>
+#include <QImage>
+#include <QPixmap>
+#include <QtTest>
+
+#include "../src/Globals/texturelist.h"
+
+class TextureList_Test : public QObject
+{
+    Q_OBJECT
+private slots:
+    void vectorMap()
+    {
+        Texture texture;
+        texture.replace(this->_checker(16, 16));
+
+        // The pixmap size is the checkerboard as it is
+        VectorMap full = texture.vectorMap();
+        QCOMPARE(full.width, 16);
+        QCOMPARE(full.height, 16);
+        QCOMPARE(full.at(0, 0).r, 0.00);
+        QCOMPARE(full.at(1, 0).r, 1.00);
+        QCOMPARE(full.at(1, 0).a, 1.00);
+
+        // Smaller maps average the squares instead of picking one
+        for (int scale : {8, 5, 1})
+        {
+            VectorMap map = texture.vectorMap(scale);
+            QCOMPARE(map.width, scale);
+            bool grey = true;
+            for (int y = 0; y < scale; y++)
+                for (int x = 0; x < scale; x++)
+                    grey = grey && qAbs(map.at(x, y).r - 0.50) < 0.02;
+            QVERIFY(grey);
+        }
+
+        // Larger maps are interpolated between the pixels
+        VectorMap large = texture.vectorMap(64);
+        QCOMPARE(large.width, 64);
+        QVERIFY(large.at(4, 0).r > 0.00 && large.at(4, 0).r < 1.00);
+    };
+
+    void cache()
+    {
+        Texture texture;
+        texture.replace(this->_checker(32, 32));
+
+        VectorMap first = texture.vectorMap(8);
+        IntensityMap intensity = texture.intensityMap(IntensityMap::RED, 8);
+        QCOMPARE(texture.vectorMap(8).at(3, 5).r, first.at(3, 5).r);
+        QCOMPARE(texture.intensityMap(IntensityMap::RED, 8).at(3, 5),
+                 intensity.at(3, 5));
+        QCOMPARE(intensity.at(3, 5), first.at(3, 5).r);
+
+        // Only the last few sizes are kept, a dropped size is made again the
+        // same
+        for (int scale : {4, 2, 16, 32})
+            texture.vectorMap(scale);
+        QCOMPARE(texture.vectorMap(8).at(3, 5).r, first.at(3, 5).r);
+        QCOMPARE(texture.vectorMap(32).at(3, 4).r, 1.00);
+
+        // Replacing the pixmap drops the cached maps
+        QPixmap black(32, 32);
+        black.fill(Qt::black);
+        texture.replace(black);
+        QCOMPARE(texture.vectorMap(8).at(3, 5).r, 0.00);
+        QCOMPARE(texture.intensityMap(IntensityMap::RED, 8).at(3, 5), 0.00);
+    };
+
+    void transparent()
+    {
+        // Transparent pixels do not darken their neighbours
+        QImage image(2, 2, QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+        image.setPixelColor(0, 0, Qt::red);
+
+        Texture texture;
+        texture.replace(QPixmap::fromImage(image));
+        VectorMap map = texture.vectorMap(1);
+        QVERIFY(qAbs(map.at(0, 0).r - 1.00) < 0.001);
+        QVERIFY(qAbs(map.at(0, 0).a - 0.25) < 0.001);
+    };
+
+private:
+    // Black and white squares of a pixel
+    QPixmap _checker(int width, int height)
+    {
+        QImage image(width, height, QImage::Format_ARGB32);
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                image.setPixelColor(x, y, (x + y) % 2 ? Qt::white : Qt::black);
+        return QPixmap::fromImage(image);
+    }
+};